@@ -0,0 +1,1142 @@
+#include <gst/gst.h>
+#include <glib.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <libzrtpcpp/ZrtpCWrapper.h>
+
+#include <gstSrtpCWrapper.h>
+#include <gstzrtpcrc.h>
+#include <gstzrtpaes.h>
+#include <gstzrtpmeta.h>
+#include <gstzrtpfilter.h>
+#include <gstzrtptimer.h>
+#include <gstzrtpearly.h>
+#include <gstzrtpssrctable.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+/*
+ * Micro benchmark of the SRTP/SRTCP wrapper functions.
+ *
+ * The benchmark drives zsrtp_protect, zsrtp_unprotect, zsrtp_protectCtrl and
+ * zsrtp_unprotectCtrl directly, without a pipeline and without ZRTP. It runs
+ * a matrix of ciphers, authentication algorithms, tag lengths and payload
+ * sizes and reports packets/s, ns/packet and heap allocations/packet for each
+ * function. The packets are protected in batches and then unprotected by a
+ * second context with the same keys, the benchmark checks that the round
+ * trip restores the original packet byte by byte. Before the measurements
+ * it checks RTP packets with CSRCs, header extensions and padding the same
+ * way, that SRTP changes neither the header nor the expected size, that
+ * the NULL cipher leaves the payload in the clear and that both sides
+ * attach the expected GstZrtpSrtpMeta. A reordering check unprotects
+ * packets in reverse order across a ROC wrap with a large and with the
+ * default replay window. A timer check cancels timers while their callbacks
+ * run and re-arm them. An early media check holds received clear and SRTP
+ * packets until the receive context is ready and expects the SRTP ones
+ * delivered in order and the clear ones dropped.
+ * It also checks that the precomputed HMAC-SHA1 state and the AES-CM
+ * kernels compute the same packets as the CryptoContext functions, one side
+ * of the round trip uses each. Run with --no-fast-hmac or --no-fast-cipher
+ * to measure without them, --batch measures the batch functions.
+ *
+ * Buffers have enough tailroom for the SRTP trailer, like buffers that an
+ * upstream element allocates after the ALLOCATION query of the zrtpfilter.
+ *
+ * A second table compares the ZRTP packet CRC-32c of the filter, the CPU
+ * specific and the table implementation, with the libzrtpcpp checksum
+ * functions for sizes of ZRTP Hello, Commit and DHPart packets. All must
+ * compute the same value.
+ *
+ * At last it prints the heap memory of a zrtpfilter element that is not yet
+ * initialized, the per-element figure for servers with many call legs. It
+ * creates ELEMENTS filters with and without the slim property and divides
+ * the growth of the malloc heap by their number, thus the figure includes
+ * the pads but no class data. With glibc only.
+ *
+ * Usage: srtpBench [-n packets] [-s payload-size] [-c cipher] [-b]
+ *                  [--no-fast-hmac] [--no-fast-cipher]
+ *
+ * Build the benchmark with -DBUILD_BENCH=ON, once with the default standalone
+ * crypto module and once with -DCRYPTO_STANDALONE=OFF to compare the
+ * openSSL backend.
+ */
+
+#define BATCH       256
+#define RTP_HEADER  12
+#define RTCP_HEADER 8
+#define ELEMENTS    1000
+
+/*
+ * Count heap allocations. The benchmark interposes the glibc allocator
+ * functions, the wrapper, GStreamer and the C++ runtime call these.
+ */
+#ifdef __GLIBC__
+#define COUNT_ALLOCS 1
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t align, size_t size);
+
+static gsize allocCount;
+
+void* malloc(size_t size)
+{
+    allocCount++;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size)
+{
+    allocCount++;
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    allocCount++;
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void** ptr, size_t align, size_t size)
+{
+    allocCount++;
+    *ptr = __libc_memalign(align, size);
+    return *ptr == NULL ? 12 /* ENOMEM */ : 0;
+}
+#else
+static gsize allocCount;
+#endif
+
+typedef struct {
+    const gchar* name;
+    gint32 cipher;
+    gint32 auth;
+    gint32 keyLength;
+    gint32 authKeyLength;
+    gint32 tagLength;
+} BenchAlgo;
+
+static const BenchAlgo algos[] = {
+    { "AES-CM-128/SHA1-80",    SrtpEncryptionAESCM,  SrtpAuthenticationSha1Hmac,  16, 20, 10 },
+    { "AES-CM-128/SHA1-32",    SrtpEncryptionAESCM,  SrtpAuthenticationSha1Hmac,  16, 20, 4 },
+    { "AES-CM-256/SHA1-80",    SrtpEncryptionAESCM,  SrtpAuthenticationSha1Hmac,  32, 20, 10 },
+    { "AES-CM-256/SKEIN-64",   SrtpEncryptionAESCM,  SrtpAuthenticationSkeinHmac, 32, 32, 8 },
+    { "AES-CM-128/SKEIN-32",   SrtpEncryptionAESCM,  SrtpAuthenticationSkeinHmac, 16, 32, 4 },
+    { "TWO-CM-128/SHA1-80",    SrtpEncryptionTWOCM,  SrtpAuthenticationSha1Hmac,  16, 20, 10 },
+    { "TWO-CM-256/SKEIN-64",   SrtpEncryptionTWOCM,  SrtpAuthenticationSkeinHmac, 32, 32, 8 },
+    { "AES-GCM-128",           SrtpEncryptionAESGCM, SrtpAuthenticationNull,      16, 0,  ZSRTP_AEAD_TAG_LENGTH },
+    { "AES-GCM-256",           SrtpEncryptionAESGCM, SrtpAuthenticationNull,      32, 0,  ZSRTP_AEAD_TAG_LENGTH },
+    { "NULL-128/SHA1-80",      SrtpEncryptionNull,   SrtpAuthenticationSha1Hmac,  16, 20, 10 },
+    { "NULL-128/SHA1-32",      SrtpEncryptionNull,   SrtpAuthenticationSha1Hmac,  16, 20, 4 },
+};
+
+static const gint payloadSizes[] = { 20, 160, 320, 640, 1000, 1400 };
+
+/* Hello, Commit, DHPart (DH2k, DH3k, EC) and a large ZRTP packet */
+static const gint zrtpSizes[] = { 100, 128, 200, 340, 468, 1024 };
+
+static guint8 masterKey[32];
+static guint8 masterSalt[14];
+
+static guint64
+now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (guint64)ts.tv_sec * G_GUINT64_CONSTANT(1000000000) + ts.tv_nsec;
+}
+
+static GstBuffer*
+new_packet(gint size, gsize tailroom)
+{
+    GstAllocationParams params;
+
+    gst_allocation_params_init(&params);
+    params.padding = tailroom;
+    return gst_buffer_new_allocate(NULL, size, &params);
+}
+
+static void
+fill_rtp(GstBuffer* buf, guint16 seq, gint payload)
+{
+    GstMapInfo map;
+    gint i;
+
+    gst_buffer_map(buf, &map, GST_MAP_WRITE);
+    map.data[0] = 0x80;
+    map.data[1] = 0x00;
+    map.data[2] = seq >> 8;
+    map.data[3] = seq & 0xff;
+    map.data[4] = map.data[5] = map.data[6] = map.data[7] = 0;
+    map.data[8] = 0x01; map.data[9] = 0x02; map.data[10] = 0x03; map.data[11] = 0x04;
+    for (i = 0; i < payload; i++)
+        map.data[RTP_HEADER + i] = (guint8)(seq + i);
+    gst_buffer_unmap(buf, &map);
+}
+
+static void
+fill_rtcp(GstBuffer* buf, guint16 seq, gint payload)
+{
+    GstMapInfo map;
+    gint i, words = (RTCP_HEADER + payload) / 4 - 1;
+
+    gst_buffer_map(buf, &map, GST_MAP_WRITE);
+    map.data[0] = 0x80;
+    map.data[1] = 200;                    /* SR */
+    map.data[2] = words >> 8;
+    map.data[3] = words & 0xff;
+    map.data[4] = 0x01; map.data[5] = 0x02; map.data[6] = 0x03; map.data[7] = 0x04;
+    for (i = 0; i < payload; i++)
+        map.data[RTCP_HEADER + i] = (guint8)(seq + i);
+    gst_buffer_unmap(buf, &map);
+}
+
+static gboolean
+check_packet(GstBuffer* buf, GstBuffer* ref)
+{
+    GstMapInfo a, b;
+    gboolean ok;
+
+    gst_buffer_map(buf, &a, GST_MAP_READ);
+    gst_buffer_map(ref, &b, GST_MAP_READ);
+    ok = a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+    gst_buffer_unmap(ref, &b);
+    gst_buffer_unmap(buf, &a);
+    return ok;
+}
+
+/*
+ * RTP header layouts for the parser check: CSRC count, extension words and
+ * padding bytes. The protect and unprotect functions parse the header from
+ * the mapped data, SRTP must leave the header untouched and unprotect must
+ * restore the packet byte by byte, including its size.
+ */
+typedef struct {
+    gint csrcs;
+    gint extWords;              /* -1: no extension */
+    gint padding;
+} RtpLayout;
+
+static const RtpLayout layouts[] = {
+    { 0, -1, 0 },
+    { 2, -1, 0 },
+    { 0, 0, 0 },
+    { 0, 3, 0 },
+    { 15, 2, 0 },
+    { 1, 1, 4 },
+};
+
+static gint
+layout_header_len(const RtpLayout* l)
+{
+    return RTP_HEADER + l->csrcs * 4 + (l->extWords >= 0 ? 4 + l->extWords * 4 : 0);
+}
+
+static GstBuffer*
+new_rtp_layout(const RtpLayout* l, guint16 seq, gint payload)
+{
+    gint header = layout_header_len(l);
+    gint size = header + payload + l->padding;
+    GstBuffer* buf = new_packet(size, ZSRTP_MAX_SRTP_TAIL);
+    GstMapInfo map;
+    gint i;
+
+    gst_buffer_map(buf, &map, GST_MAP_WRITE);
+    for (i = 0; i < size; i++)
+        map.data[i] = (guint8)(seq * 7 + i);
+    map.data[0] = 0x80 | (l->padding > 0 ? 0x20 : 0) | (l->extWords >= 0 ? 0x10 : 0) | l->csrcs;
+    map.data[1] = 0x00;
+    map.data[2] = seq >> 8;
+    map.data[3] = seq & 0xff;
+    map.data[8] = 0x01; map.data[9] = 0x02; map.data[10] = 0x03; map.data[11] = 0x04;
+    if (l->extWords >= 0) {
+        guint8* ext = map.data + RTP_HEADER + l->csrcs * 4;
+        ext[2] = l->extWords >> 8;
+        ext[3] = l->extWords & 0xff;
+    }
+    if (l->padding > 0)
+        map.data[size - 1] = l->padding;
+    gst_buffer_unmap(buf, &map);
+    return buf;
+}
+
+/* Check the meta of a processed packet against the layout and the index */
+static gboolean
+check_meta(GstBuffer* buf, const RtpLayout* l, guint64 index)
+{
+    GstZrtpSrtpMeta* meta = gst_buffer_get_zrtp_srtp_meta(buf);
+
+    return meta != NULL && meta->ssrc == 0x01020304 && meta->seq == (guint16)index &&
+        meta->headerLength == (guint)layout_header_len(l) && meta->index == index;
+}
+
+/* Check the SRTP header parsing, trimming and the meta for all layouts */
+static gboolean
+check_rtp_layouts(const BenchAlgo* algo)
+{
+    ZsrtpContext* send;
+    ZsrtpContext* recv;
+    gboolean ok = TRUE;
+    guint16 seq = 0xfff0;               /* crosses the ROC wrap */
+    guint64 index = seq;
+    guint i, n;
+
+    send = zsrtp_CreateWrapper(0x01020304, 0, 0L, algo->cipher, algo->auth, masterKey, algo->keyLength,
+                               masterSalt, sizeof(masterSalt), algo->keyLength, algo->authKeyLength,
+                               sizeof(masterSalt), algo->tagLength);
+    recv = zsrtp_CreateWrapper(0x01020304, 0, 0L, algo->cipher, algo->auth, masterKey, algo->keyLength,
+                               masterSalt, sizeof(masterSalt), algo->keyLength, algo->authKeyLength,
+                               sizeof(masterSalt), algo->tagLength);
+    if (send == NULL || recv == NULL) {
+        zsrtp_DestroyWrapper(send);
+        zsrtp_DestroyWrapper(recv);
+        return TRUE;
+    }
+    zsrtp_deriveSrtpKeys(send, 0L);
+    zsrtp_deriveSrtpKeys(recv, 0L);
+    send->meta = 1;
+    recv->meta = 1;
+
+    for (n = 0; n < 4; n++) {
+        for (i = 0; i < G_N_ELEMENTS(layouts); i++, seq++, index++) {
+            GstBuffer* buf = new_rtp_layout(&layouts[i], seq, 20 + 40 * n);
+            GstBuffer* ref = gst_buffer_copy(buf);
+            gsize size = gst_buffer_get_size(buf);
+            gint header = layout_header_len(&layouts[i]);
+            gsize clear = algo->cipher == SrtpEncryptionNull ? size : (gsize)header;
+            GstMapInfo a, b;
+
+            if (zsrtp_protect(send, buf) != 1 || gst_buffer_get_size(buf) != size + algo->tagLength) {
+                g_printerr("%s: protect failed, layout %u\n", algo->name, i);
+                ok = FALSE;
+            }
+            gst_buffer_map(buf, &a, GST_MAP_READ);
+            gst_buffer_map(ref, &b, GST_MAP_READ);
+            if (memcmp(a.data, b.data, clear) != 0) {
+                g_printerr("%s: protect changed the RTP header or NULL cipher payload, layout %u\n",
+                           algo->name, i);
+                ok = FALSE;
+            }
+            gst_buffer_unmap(ref, &b);
+            gst_buffer_unmap(buf, &a);
+            if (!check_meta(buf, &layouts[i], index)) {
+                g_printerr("%s: protect meta differs, layout %u\n", algo->name, i);
+                ok = FALSE;
+            }
+
+            if (zsrtp_unprotect(recv, buf) != 1 || !check_packet(buf, ref)) {
+                g_printerr("%s: unprotect result differs, layout %u\n", algo->name, i);
+                ok = FALSE;
+            }
+            if (!check_meta(buf, &layouts[i], index)) {
+                g_printerr("%s: unprotect meta differs, layout %u\n", algo->name, i);
+                ok = FALSE;
+            }
+            gst_buffer_unref(buf);
+            gst_buffer_unref(ref);
+        }
+    }
+    zsrtp_DestroyWrapper(send);
+    zsrtp_DestroyWrapper(recv);
+    return ok;
+}
+
+static ZsrtpContext*
+new_srtp(const BenchAlgo* algo, gboolean fast)
+{
+    gint32 old = zsrtp_setFastHmac(fast);
+    gint32 oldCipher = zsrtp_setFastCipher(fast);
+    ZsrtpContext* ctx;
+
+    ctx = zsrtp_CreateWrapper(0x01020304, 0, 0L, algo->cipher, algo->auth, masterKey, algo->keyLength,
+                              masterSalt, sizeof(masterSalt), algo->keyLength, algo->authKeyLength,
+                              sizeof(masterSalt), algo->tagLength);
+    zsrtp_setFastHmac(old);
+    zsrtp_setFastCipher(oldCipher);
+    if (ctx != NULL)
+        zsrtp_deriveSrtpKeys(ctx, 0L);
+    return ctx;
+}
+
+static ZsrtpContextCtrl*
+new_srtcp(const BenchAlgo* algo, gboolean fast)
+{
+    gint32 old = zsrtp_setFastHmac(fast);
+    gint32 oldCipher = zsrtp_setFastCipher(fast);
+    ZsrtpContextCtrl* ctx;
+
+    ctx = zsrtp_CreateWrapperCtrl(0x01020304, algo->cipher, algo->auth, masterKey, algo->keyLength,
+                                  masterSalt, sizeof(masterSalt), algo->keyLength, algo->authKeyLength,
+                                  sizeof(masterSalt), algo->tagLength);
+    zsrtp_setFastHmac(old);
+    zsrtp_setFastCipher(oldCipher);
+    if (ctx != NULL)
+        zsrtp_deriveSrtpKeysCtrl(ctx);
+    return ctx;
+}
+
+/*
+ * Round trips between a wrapper with and one without the precomputed HMAC
+ * state and the AES-CM kernels, in both directions. The payload sizes cross
+ * the SHA-1 block boundaries of the message and the appended ROC or index,
+ * and the 8 block steps of the AES kernels.
+ */
+static gboolean
+check_fast_modes(const BenchAlgo* algo)
+{
+    gboolean ok = TRUE;
+    guint16 seq = 1;
+    gint dir, payload;
+
+    if (algo->auth != SrtpAuthenticationSha1Hmac && algo->cipher != SrtpEncryptionAESCM)
+        return TRUE;
+
+    for (dir = 0; dir < 2; dir++) {
+        ZsrtpContext* send = new_srtp(algo, dir == 0);
+        ZsrtpContext* recv = new_srtp(algo, dir != 0);
+        ZsrtpContextCtrl* sendCtrl = new_srtcp(algo, dir == 0);
+        ZsrtpContextCtrl* recvCtrl = new_srtcp(algo, dir != 0);
+
+        for (payload = 0; payload <= 200 && send != NULL && recv != NULL; payload++, seq++) {
+            GstBuffer* buf = new_packet(RTP_HEADER + payload, ZSRTP_MAX_SRTP_TAIL);
+            GstBuffer* ref;
+
+            fill_rtp(buf, seq, payload);
+            ref = gst_buffer_copy(buf);
+            if (zsrtp_protect(send, buf) != 1 || zsrtp_unprotect(recv, buf) != 1 || !check_packet(buf, ref)) {
+                g_printerr("%s: SRTP fast modes differ, payload %d\n", algo->name, payload);
+                ok = FALSE;
+            }
+            gst_buffer_unref(buf);
+            gst_buffer_unref(ref);
+        }
+        for (payload = 0; payload <= 200 && sendCtrl != NULL && recvCtrl != NULL; payload += 4, seq++) {
+            GstBuffer* buf = new_packet(RTCP_HEADER + payload, ZSRTP_MAX_SRTCP_TAIL);
+            GstBuffer* ref;
+
+            fill_rtcp(buf, seq, payload);
+            ref = gst_buffer_copy(buf);
+            if (zsrtp_protectCtrl(sendCtrl, buf) != 1 || zsrtp_unprotectCtrl(recvCtrl, buf) != 1 ||
+                !check_packet(buf, ref)) {
+                g_printerr("%s: SRTCP fast modes differ, payload %d\n", algo->name, payload);
+                ok = FALSE;
+            }
+            gst_buffer_unref(buf);
+            gst_buffer_unref(ref);
+        }
+        zsrtp_DestroyWrapper(send);
+        zsrtp_DestroyWrapper(recv);
+        zsrtp_DestroyWrapperCtrl(sendCtrl);
+        zsrtp_DestroyWrapperCtrl(recvCtrl);
+    }
+    return ok;
+}
+
+/*
+ * The batch functions against the single packet functions: batch protect
+ * and single unprotect, single protect and batch unprotect across a ROC
+ * wrap with a duplicate in the batch, then both batched with a corrupted
+ * packet. Payload sizes vary within a batch. A few single packets move the
+ * sequence numbers close to the wrap first.
+ */
+#define CHECK_BATCH 40
+
+static gboolean
+check_batch(const BenchAlgo* algo)
+{
+    GstBuffer* bufs[CHECK_BATCH + 1];
+    GstBuffer* refs[CHECK_BATCH + 1];
+    gint32 results[CHECK_BATCH + 1];
+    ZsrtpContext* send = new_srtp(algo, TRUE);
+    ZsrtpContext* recv = new_srtp(algo, TRUE);
+    guint16 seq = 0xffc0;
+    gboolean ok = TRUE;
+    gint round, i, n;
+
+    for (i = 0; i < 4 && send != NULL && recv != NULL; i++) {
+        GstBuffer* buf = new_packet(RTP_HEADER + 20, ZSRTP_MAX_SRTP_TAIL);
+
+        fill_rtp(buf, 1 + i * 0x4000, 20);
+        if (zsrtp_protect(send, buf) != 1 || zsrtp_unprotect(recv, buf) != 1)
+            ok = FALSE;
+        gst_buffer_unref(buf);
+    }
+    for (round = 0; round < 3 && send != NULL && recv != NULL; round++) {
+        for (i = 0; i < CHECK_BATCH; i++, seq++) {
+            gint payload = (i * 37 + round) % 200;
+
+            bufs[i] = new_packet(RTP_HEADER + payload, ZSRTP_MAX_SRTP_TAIL);
+            fill_rtp(bufs[i], seq, payload);
+            refs[i] = gst_buffer_copy(bufs[i]);
+        }
+        n = CHECK_BATCH;
+        if (round == 1) {
+            for (i = 0; i < CHECK_BATCH; i++)
+                zsrtp_protect(send, bufs[i]);
+            /* duplicate of a packet in the same chunk of the batch */
+            bufs[n] = gst_buffer_copy(bufs[n - 3]);
+            refs[n] = NULL;
+            n++;
+        } else {
+            zsrtp_protectBatch(send, bufs, CHECK_BATCH, results);
+            for (i = 0; i < CHECK_BATCH; i++)
+                ok &= results[i] == 1;
+        }
+        if (round == 2) {
+            GstMapInfo map;
+
+            gst_buffer_map(bufs[7], &map, GST_MAP_WRITE);
+            map.data[map.size - 1] ^= 0x01;
+            gst_buffer_unmap(bufs[7], &map);
+        }
+
+        if (round == 0) {
+            for (i = 0; i < n; i++)
+                results[i] = zsrtp_unprotect(recv, bufs[i]);
+        } else {
+            zsrtp_unprotectBatch(recv, bufs, n, results);
+        }
+        for (i = 0; i < n; i++) {
+            gint32 expect = refs[i] == NULL ? -2 : (round == 2 && i == 7) ? -1 : 1;
+
+            if (results[i] != expect || (expect == 1 && !check_packet(bufs[i], refs[i]))) {
+                g_printerr("%s: SRTP batch round %d packet %d, result %d\n", algo->name, round, i, results[i]);
+                ok = FALSE;
+            }
+            gst_buffer_unref(bufs[i]);
+            if (refs[i] != NULL)
+                gst_buffer_unref(refs[i]);
+        }
+    }
+    zsrtp_DestroyWrapper(send);
+    zsrtp_DestroyWrapper(recv);
+    return ok;
+}
+
+/*
+ * Deep reordering across a ROC wrap: the receivers get the first packet in
+ * order and the others in reverse order. A receiver with the largest replay
+ * window accepts each of them once, one with the default window rejects the
+ * packets more than 64 behind. The tags cover the ROC, thus an accepted
+ * packet also shows that the receiver estimated the ROC right.
+ */
+#define CHECK_REPLAY 3000
+
+static gboolean
+check_replay(const BenchAlgo* algo)
+{
+    GstBuffer** bufs = g_new(GstBuffer*, CHECK_REPLAY);
+    ZsrtpContext* send = new_srtp(algo, TRUE);
+    ZsrtpContext* recv = new_srtp(algo, TRUE);
+    ZsrtpContext* small = new_srtp(algo, TRUE);
+    GstBuffer* dup;
+    gboolean ok = TRUE;
+    gint i, n;
+
+    if (send == NULL || recv == NULL || small == NULL || !zsrtp_setReplayWindow(recv, ZSRTP_MAX_REPLAY_WINDOW)) {
+        g_printerr("%s: cannot create SRTP contexts for the replay check\n", algo->name);
+        zsrtp_DestroyWrapper(send);
+        zsrtp_DestroyWrapper(recv);
+        zsrtp_DestroyWrapper(small);
+        g_free(bufs);
+        return FALSE;
+    }
+    for (i = 0; i < CHECK_REPLAY; i++) {
+        bufs[i] = new_packet(RTP_HEADER + 20, ZSRTP_MAX_SRTP_TAIL);
+        fill_rtp(bufs[i], (guint16)(0xff00 + i), 20);
+        zsrtp_protect(send, bufs[i]);
+    }
+    dup = gst_buffer_copy(bufs[5]);
+
+    for (n = 0; n < CHECK_REPLAY; n++) {
+        GstBuffer* copy;
+        gint32 expect;
+
+        i = n == 0 ? 0 : CHECK_REPLAY - n;
+        copy = gst_buffer_copy(bufs[i]);
+        expect = (i == 0 || i >= CHECK_REPLAY - 64) ? 1 : -2;
+        if (zsrtp_unprotect(recv, bufs[i]) != 1 || zsrtp_unprotect(small, copy) != expect) {
+            g_printerr("%s: SRTP replay window, packet %d\n", algo->name, i);
+            ok = FALSE;
+        }
+        gst_buffer_unref(copy);
+        gst_buffer_unref(bufs[i]);
+    }
+    if (zsrtp_unprotect(recv, dup) != -2) {
+        g_printerr("%s: SRTP replay window accepts a duplicate\n", algo->name);
+        ok = FALSE;
+    }
+    gst_buffer_unref(dup);
+    zsrtp_DestroyWrapper(send);
+    zsrtp_DestroyWrapper(recv);
+    zsrtp_DestroyWrapper(small);
+    g_free(bufs);
+    return ok;
+}
+
+/*
+ * The ZRTP engine cancels its timer while it holds the lock that the timeout
+ * callback waits for, cancel must not wait for the callback. cancel_sync
+ * waits, and a callback that re-arms its timer meanwhile must not put it
+ * back on the wheel.
+ */
+typedef struct {
+    ZrtpTimer timer;
+    GMutex* lock;           /* the callback takes it, like the engine lock */
+    gint entered;
+    gint calls;
+    gboolean rearm;
+} CheckTimer;
+
+static void
+check_timer_func(gpointer userData)
+{
+    CheckTimer* t = (CheckTimer*)userData;
+
+    g_atomic_int_inc(&t->entered);
+    g_mutex_lock(t->lock);
+    g_mutex_unlock(t->lock);
+    g_usleep(5000);
+    g_atomic_int_inc(&t->calls);
+    if (t->rearm)
+        zrtp_timer_arm(&t->timer, ZRTP_TIMER_TICK);
+}
+
+static void
+check_timer_wait_entered(CheckTimer* t, gint entered)
+{
+    while (g_atomic_int_get(&t->entered) < entered)
+        g_usleep(1000);
+}
+
+static gboolean
+check_timers(void)
+{
+    CheckTimer t;
+    gboolean ok = TRUE;
+    gint calls;
+
+    memset(&t, 0, sizeof(t));
+    t.lock = g_mutex_new();
+    zrtp_timer_init(&t.timer, check_timer_func, &t);
+
+    /* Cancel with the lock held while the callback waits for it */
+    g_mutex_lock(t.lock);
+    zrtp_timer_arm(&t.timer, ZRTP_TIMER_TICK);
+    check_timer_wait_entered(&t, 1);
+    zrtp_timer_cancel(&t.timer);
+    g_mutex_unlock(t.lock);
+
+    /* Stop a timer whose callback re-arms it, while the callback runs */
+    t.rearm = TRUE;
+    zrtp_timer_arm(&t.timer, ZRTP_TIMER_TICK);
+    check_timer_wait_entered(&t, 3);
+    zrtp_timer_cancel_sync(&t.timer);
+    calls = g_atomic_int_get(&t.calls);
+    g_usleep(100000);
+    if (g_atomic_int_get(&t.calls) != calls || t.timer.armed) {
+        g_printerr("Timer fires after zrtp_timer_cancel_sync\n");
+        ok = FALSE;
+    }
+    if (zrtp_timer_arm(&t.timer, ZRTP_TIMER_TICK)) {
+        g_printerr("Stopped timer can be armed\n");
+        zrtp_timer_cancel_sync(&t.timer);
+        ok = FALSE;
+    }
+    g_mutex_free(t.lock);
+    return ok;
+}
+
+/*
+ * The receive direction holds RTP packets during the handshake, the peer
+ * sent some in the clear and some with SRTP before the receive context
+ * existed. Installing the context replays them through unprotect: the SRTP
+ * packets arrive in order, the clear ones are dropped and, although more
+ * than ZRTP_SSRC_REJECT_FAILURES of them share a SSRC, do not get it
+ * rejected. The packets after the switch pass as usual.
+ */
+#define CHECK_EARLY_PEER   0x01020304
+#define CHECK_EARLY_OTHER  0x05060708
+#define CHECK_EARLY        (ZRTP_SSRC_REJECT_FAILURES + 6)
+
+typedef struct {
+    ZrtpSsrcTable* table;
+    GstBuffer* delivered[CHECK_EARLY];
+    gint count;
+    gint drops;
+} CheckEarly;
+
+static GstFlowReturn
+check_early_deliver(CheckEarly* e, GstBuffer* buf, gint32 rc)
+{
+    if (rc != 1) {
+        e->drops++;
+        gst_buffer_unref(buf);
+        return GST_FLOW_OK;
+    }
+    e->delivered[e->count++] = buf;
+    return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+check_early_held(gpointer data, GstBuffer* buf)
+{
+    CheckEarly* e = (CheckEarly*)data;
+
+    return check_early_deliver(e, buf, zrtp_ssrc_table_unprotect_held(e->table, buf));
+}
+
+static GstFlowReturn
+check_early_push(gpointer data, GstBuffer* buf)
+{
+    CheckEarly* e = (CheckEarly*)data;
+
+    return check_early_deliver(e, buf, zrtp_ssrc_table_unprotect(e->table, buf));
+}
+
+static void
+check_early_set_ssrc(GstBuffer* buf, guint32 ssrc)
+{
+    guint32 nssrc = g_htonl(ssrc);
+
+    gst_buffer_fill(buf, 8, &nssrc, sizeof(nssrc));
+}
+
+static gboolean
+check_early_media(const BenchAlgo* algo)
+{
+    ZrtpEarlyRing ring;
+    CheckEarly e;
+    GstBuffer* refs[CHECK_EARLY];
+    ZsrtpContext* sendPeer = new_srtp(algo, TRUE);
+    ZsrtpContext* sendOther = new_srtp(algo, TRUE);
+    ZsrtpContext* recv = new_srtp(algo, TRUE);
+    gboolean ok = TRUE;
+    guint dropped = 0;
+    gint nrefs = 0;
+    gint i;
+
+    memset(&e, 0, sizeof(e));
+    if (sendPeer == NULL || sendOther == NULL || recv == NULL) {
+        zsrtp_DestroyWrapper(sendPeer);
+        zsrtp_DestroyWrapper(sendOther);
+        zsrtp_DestroyWrapper(recv);
+        return FALSE;
+    }
+    e.table = zrtp_ssrc_table_new(recv, NULL, ZRTP_SSRC_TABLE_DEFAULT_SIZE);
+    zrtp_early_init(&ring, 16, 0);
+    zrtp_early_set_hold(&ring, TRUE);
+
+    for (i = 0; i < CHECK_EARLY; i++) {
+        GstBuffer* buf = new_packet(RTP_HEADER + 20, ZSRTP_MAX_SRTP_TAIL);
+        gboolean other = i >= 2 && i < 2 + ZRTP_SSRC_REJECT_FAILURES;
+        gboolean clear = i < 2 + ZRTP_SSRC_REJECT_FAILURES;
+        gboolean ready = i >= CHECK_EARLY - 2;
+
+        /* Last one: the other SSRC with SRTP after the switch */
+        if (i == CHECK_EARLY - 1)
+            other = TRUE;
+        fill_rtp(buf, (other ? 200 : 100) + i, 20);
+        if (other)
+            check_early_set_ssrc(buf, CHECK_EARLY_OTHER);
+        if (!clear) {
+            refs[nrefs++] = gst_buffer_copy(buf);
+            zsrtp_protect(other ? sendOther : sendPeer, buf);
+        }
+
+        /* The engine installs the receive context and replays the held packets */
+        if (i == CHECK_EARLY - 2) {
+            zrtp_ssrc_table_set_peer(e.table, CHECK_EARLY_PEER);
+            zrtp_early_flush(&ring, check_early_held, &e, &dropped);
+            zrtp_early_set_hold(&ring, FALSE);
+            if (e.count != 2 || e.drops != 2 + ZRTP_SSRC_REJECT_FAILURES || zrtp_early_active(&ring))
+                ok = FALSE;
+        }
+        zrtp_early_process(&ring, ready, check_early_held, check_early_push, &e, buf, &dropped);
+        if (!ready && e.count != 0)
+            ok = FALSE;
+    }
+    if (e.count != nrefs || e.drops != 2 + ZRTP_SSRC_REJECT_FAILURES || dropped != 0)
+        ok = FALSE;
+    for (i = 0; i < nrefs; i++) {
+        if (i < e.count) {
+            if (!check_packet(e.delivered[i], refs[i]))
+                ok = FALSE;
+            gst_buffer_unref(e.delivered[i]);
+        }
+        gst_buffer_unref(refs[i]);
+    }
+    if (!ok)
+        g_printerr("%s: held early media packets, %d of %d delivered, %d dropped\n",
+                   algo->name, e.count, nrefs, e.drops);
+    zrtp_early_free(&ring);
+    zrtp_ssrc_table_free(e.table);
+    zsrtp_DestroyWrapper(sendPeer);
+    zsrtp_DestroyWrapper(sendOther);
+    return ok;
+}
+
+typedef struct {
+    guint64 ns;
+    gsize allocs;
+    guint64 packets;
+} BenchResult;
+
+static void
+print_result(const gchar* what, const BenchAlgo* algo, gint payload, BenchResult* r)
+{
+    gdouble nsPerPacket = (gdouble)r->ns / r->packets;
+
+    g_print("%-20s %-14s %5d %10.0f %9.1f %8.2f\n", algo->name, what, payload,
+            1e9 / nsPerPacket, nsPerPacket, (gdouble)r->allocs / r->packets);
+}
+
+/*
+ * Run protect and unprotect on batches of packets, returns FALSE on
+ * mismatch. With useBatch the batch functions process each list of packets
+ * in one call.
+ */
+static gboolean
+bench_rtp(const BenchAlgo* algo, gint payload, guint64 packets, gboolean useBatch)
+{
+    GstBuffer* bufs[BATCH];
+    GstBuffer* refs[BATCH];
+    gint32 results[BATCH];
+    BenchResult prot = { 0, 0, 0 };
+    BenchResult unprot = { 0, 0, 0 };
+    ZsrtpContext* send;
+    ZsrtpContext* recv;
+    guint16 seq = 1;
+    gboolean ok = TRUE;
+    gint size = RTP_HEADER + payload;
+    gint i;
+
+    send = zsrtp_CreateWrapper(0x01020304, 0, 0L, algo->cipher, algo->auth, masterKey, algo->keyLength,
+                               masterSalt, sizeof(masterSalt), algo->keyLength, algo->authKeyLength,
+                               sizeof(masterSalt), algo->tagLength);
+    recv = zsrtp_CreateWrapper(0x01020304, 0, 0L, algo->cipher, algo->auth, masterKey, algo->keyLength,
+                               masterSalt, sizeof(masterSalt), algo->keyLength, algo->authKeyLength,
+                               sizeof(masterSalt), algo->tagLength);
+    if (send == NULL || recv == NULL) {
+        zsrtp_DestroyWrapper(send);
+        zsrtp_DestroyWrapper(recv);
+        return TRUE;                    /* not supported by this crypto backend */
+    }
+    zsrtp_deriveSrtpKeys(send, 0L);
+    zsrtp_deriveSrtpKeys(recv, 0L);
+
+    while (prot.packets < packets) {
+        guint64 start;
+        gsize allocs;
+
+        for (i = 0; i < BATCH; i++) {
+            bufs[i] = new_packet(size, ZSRTP_MAX_SRTP_TAIL);
+            fill_rtp(bufs[i], seq + i, payload);
+            refs[i] = gst_buffer_copy(bufs[i]);
+        }
+        allocs = allocCount;
+        start = now_ns();
+        if (useBatch) {
+            zsrtp_protectBatch(send, bufs, BATCH, results);
+        } else {
+            for (i = 0; i < BATCH; i++)
+                zsrtp_protect(send, bufs[i]);
+        }
+        prot.ns += now_ns() - start;
+        prot.allocs += allocCount - allocs;
+        prot.packets += BATCH;
+
+        allocs = allocCount;
+        start = now_ns();
+        if (useBatch) {
+            if (zsrtp_unprotectBatch(recv, bufs, BATCH, results) != BATCH)
+                ok = FALSE;
+        } else {
+            for (i = 0; i < BATCH; i++) {
+                if (zsrtp_unprotect(recv, bufs[i]) != 1)
+                    ok = FALSE;
+            }
+        }
+        unprot.ns += now_ns() - start;
+        unprot.allocs += allocCount - allocs;
+        unprot.packets += BATCH;
+
+        for (i = 0; i < BATCH; i++) {
+            if (!check_packet(bufs[i], refs[i]))
+                ok = FALSE;
+            gst_buffer_unref(bufs[i]);
+            gst_buffer_unref(refs[i]);
+        }
+        seq += BATCH;
+    }
+    print_result(useBatch ? "protect-batch" : "protect", algo, payload, &prot);
+    print_result(useBatch ? "unprotect-batch" : "unprotect", algo, payload, &unprot);
+
+    zsrtp_DestroyWrapper(send);
+    zsrtp_DestroyWrapper(recv);
+    return ok;
+}
+
+static gboolean
+bench_rtcp(const BenchAlgo* algo, gint payload, guint64 packets)
+{
+    GstBuffer* bufs[BATCH];
+    GstBuffer* refs[BATCH];
+    BenchResult prot = { 0, 0, 0 };
+    BenchResult unprot = { 0, 0, 0 };
+    ZsrtpContextCtrl* send;
+    ZsrtpContextCtrl* recv;
+    guint16 seq = 1;
+    gboolean ok = TRUE;
+    gint size;
+    gint i;
+
+    payload &= ~3;                      /* RTCP packets are multiples of 32 bit */
+    size = RTCP_HEADER + payload;
+
+    send = zsrtp_CreateWrapperCtrl(0x01020304, algo->cipher, algo->auth, masterKey, algo->keyLength,
+                                   masterSalt, sizeof(masterSalt), algo->keyLength, algo->authKeyLength,
+                                   sizeof(masterSalt), algo->tagLength);
+    recv = zsrtp_CreateWrapperCtrl(0x01020304, algo->cipher, algo->auth, masterKey, algo->keyLength,
+                                   masterSalt, sizeof(masterSalt), algo->keyLength, algo->authKeyLength,
+                                   sizeof(masterSalt), algo->tagLength);
+    if (send == NULL || recv == NULL) {
+        zsrtp_DestroyWrapperCtrl(send);
+        zsrtp_DestroyWrapperCtrl(recv);
+        return TRUE;
+    }
+    zsrtp_deriveSrtpKeysCtrl(send);
+    zsrtp_deriveSrtpKeysCtrl(recv);
+
+    while (prot.packets < packets) {
+        guint64 start;
+        gsize allocs;
+
+        for (i = 0; i < BATCH; i++) {
+            bufs[i] = new_packet(size, ZSRTP_MAX_SRTCP_TAIL);
+            fill_rtcp(bufs[i], seq + i, payload);
+            refs[i] = gst_buffer_copy(bufs[i]);
+        }
+        allocs = allocCount;
+        start = now_ns();
+        for (i = 0; i < BATCH; i++)
+            zsrtp_protectCtrl(send, bufs[i]);
+        prot.ns += now_ns() - start;
+        prot.allocs += allocCount - allocs;
+        prot.packets += BATCH;
+
+        allocs = allocCount;
+        start = now_ns();
+        for (i = 0; i < BATCH; i++) {
+            if (zsrtp_unprotectCtrl(recv, bufs[i]) != 1)
+                ok = FALSE;
+        }
+        unprot.ns += now_ns() - start;
+        unprot.allocs += allocCount - allocs;
+        unprot.packets += BATCH;
+
+        for (i = 0; i < BATCH; i++) {
+            if (!check_packet(bufs[i], refs[i]))
+                ok = FALSE;
+            gst_buffer_unref(bufs[i]);
+            gst_buffer_unref(refs[i]);
+        }
+        seq += BATCH;
+    }
+    print_result("protectCtrl", algo, payload, &prot);
+    print_result("unprotectCtrl", algo, payload, &unprot);
+
+    zsrtp_DestroyWrapperCtrl(send);
+    zsrtp_DestroyWrapperCtrl(recv);
+    return ok;
+}
+
+static guint32
+crc_libzrtp(const guint8* data, gsize length)
+{
+    /* zrtp_EndCksum() returns the CRC byte swapped, see gstzrtpcrc.h */
+    return GUINT32_SWAP_LE_BE(zrtp_EndCksum(zrtp_GenerateCksum((guint8*)data, length)));
+}
+
+typedef guint32 (*CrcFunc)(const guint8* data, gsize length);
+
+static guint64
+time_crc(CrcFunc func, const guint8* data, gsize length, guint64 packets, guint32* sum)
+{
+    guint64 start = now_ns();
+    guint64 i;
+
+    for (i = 0; i < packets; i++)
+        *sum += func(data, length);
+    return now_ns() - start;
+}
+
+/* Compare the CRC implementations, returns FALSE on mismatch */
+static gboolean
+bench_crc(guint64 packets)
+{
+    guint8 data[1024 + 8];
+    guint32 sum = 0;
+    gboolean ok = TRUE;
+    guint i, off;
+
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = g_random_int_range(0, 256);
+
+    /* All lengths and alignments, the implementations handle them separately */
+    for (off = 0; off < 8; off++) {
+        for (i = 0; i <= 1024; i++) {
+            guint32 ref = crc_libzrtp(data + off, i);
+
+            if (zrtp_crc32c(data + off, i) != ref || zrtp_crc32c_table(data + off, i) != ref) {
+                g_printerr("CRC-32c mismatch, length %u, offset %u\n", i, off);
+                ok = FALSE;
+            }
+        }
+    }
+
+    g_print("\nCRC-32c implementation: %s\n", zrtp_crc32c_impl());
+    g_print("%5s %14s %14s %14s\n", "size", "ns (filter)", "ns (table)", "ns (libzrtp)");
+    for (i = 0; i < G_N_ELEMENTS(zrtpSizes); i++) {
+        gsize length = zrtpSizes[i];
+        guint64 t1 = time_crc(zrtp_crc32c, data, length, packets, &sum);
+        guint64 t2 = time_crc(zrtp_crc32c_table, data, length, packets, &sum);
+        guint64 t3 = time_crc(crc_libzrtp, data, length, packets, &sum);
+
+        g_print("%5" G_GSIZE_FORMAT " %14.1f %14.1f %14.1f\n", length, (gdouble)t1 / packets,
+                (gdouble)t2 / packets, (gdouble)t3 / packets);
+    }
+    /* keep the compiler from dropping the loops */
+    if (sum == 0x5a5a5a5a)
+        g_print(" \n");
+    return ok;
+}
+
+#ifdef __GLIBC__
+static gsize
+heap_in_use(void)
+{
+#if __GLIBC__ > 2 || __GLIBC_MINOR__ >= 33
+    return mallinfo2().uordblks;
+#else
+    return (guint)mallinfo().uordblks;
+#endif
+}
+
+/* Print the heap bytes per zrtpfilter, with and without the slim property */
+static void
+bench_element_memory(void)
+{
+    GstElement** elements = g_new(GstElement*, ELEMENTS);
+    gboolean slim;
+    guint i;
+
+    /* The first filter creates the class, don't count it */
+    gst_object_unref(gst_object_ref_sink(g_object_new(GST_TYPE_ZRTPFILTER, NULL)));
+
+    g_print("\n%-12s %14s %6s\n", "zrtpfilter", "bytes/element", "pads");
+    for (slim = FALSE; slim <= TRUE; slim++) {
+        gsize before = heap_in_use();
+        gsize after;
+
+        for (i = 0; i < ELEMENTS; i++)
+            elements[i] = gst_object_ref_sink(g_object_new(GST_TYPE_ZRTPFILTER, "slim", slim, NULL));
+        after = heap_in_use();
+
+        g_print("%-12s %14" G_GSIZE_FORMAT " %6u\n", slim ? "slim" : "default",
+                (after - before) / ELEMENTS, elements[0]->numpads);
+        for (i = 0; i < ELEMENTS; i++)
+            gst_object_unref(elements[i]);
+    }
+    g_free(elements);
+}
+#endif
+
+int
+main (int argc, char *argv[])
+{
+    gint64 packets = 100000;
+    gint size = 0;
+    gchar* cipher = NULL;
+    gboolean noFastHmac = FALSE;
+    gboolean noFastCipher = FALSE;
+    gboolean useBatch = FALSE;
+    gboolean ok = TRUE;
+    GError* error = NULL;
+    GOptionContext* ctx;
+    guint a, p;
+
+    GOptionEntry entries[] = {
+        { "packets", 'n', 0, G_OPTION_ARG_INT64, &packets, "Packets per measurement", "N" },
+        { "size", 's', 0, G_OPTION_ARG_INT, &size, "Only this payload size", "BYTES" },
+        { "cipher", 'c', 0, G_OPTION_ARG_STRING, &cipher, "Only algorithms with this name prefix", "NAME" },
+        { "no-fast-hmac", 0, 0, G_OPTION_ARG_NONE, &noFastHmac, "Measure without the precomputed HMAC state", NULL },
+        { "no-fast-cipher", 0, 0, G_OPTION_ARG_NONE, &noFastCipher, "Measure without the AES-CM kernels", NULL },
+        { "batch", 'b', 0, G_OPTION_ARG_NONE, &useBatch, "Measure the SRTP batch functions", NULL },
+        { NULL }
+    };
+
+    /* Let GLib use malloc for slices, thus the benchmark counts them */
+    g_setenv("G_SLICE", "always-malloc", TRUE);
+
+    ctx = g_option_context_new("- SRTP protect/unprotect benchmark");
+    g_option_context_add_main_entries(ctx, entries, NULL);
+    g_option_context_add_group(ctx, gst_init_get_option_group());
+    if (!g_option_context_parse(ctx, &argc, &argv, &error)) {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free(ctx);
+    zsrtp_setFastHmac(!noFastHmac);
+    zsrtp_setFastCipher(!noFastCipher);
+
+    for (a = 0; a < sizeof(masterKey); a++)
+        masterKey[a] = a;
+    for (a = 0; a < sizeof(masterSalt); a++)
+        masterSalt[a] = 0xa0 + a;
+
+#ifndef COUNT_ALLOCS
+    g_print("Allocation counting not supported on this platform.\n");
+#endif
+    g_print("AES-CM kernel: %s\n", noFastCipher ? "off" : zrtp_aes_ctr_impl());
+    g_print("%-20s %-14s %5s %10s %9s %8s\n", "algorithm", "function", "size", "packets/s", "ns/packet", "allocs");
+
+    for (a = 0; a < G_N_ELEMENTS(algos); a++) {
+        if (cipher != NULL && !g_str_has_prefix(algos[a].name, cipher))
+            continue;
+        if (algos[a].cipher == SrtpEncryptionAESGCM && !zsrtp_hasAeadSupport())
+            continue;
+        if (!check_rtp_layouts(&algos[a]) || !check_fast_modes(&algos[a]) ||
+            !check_batch(&algos[a]) || !check_replay(&algos[a]))
+            ok = FALSE;
+        for (p = 0; p < G_N_ELEMENTS(payloadSizes); p++) {
+            if (size != 0 && payloadSizes[p] != size)
+                continue;
+            if (!bench_rtp(&algos[a], payloadSizes[p], packets, useBatch)) {
+                g_printerr("%s: SRTP round trip mismatch, payload %d\n", algos[a].name, payloadSizes[p]);
+                ok = FALSE;
+            }
+            if (!bench_rtcp(&algos[a], payloadSizes[p], packets)) {
+                g_printerr("%s: SRTCP round trip mismatch, payload %d\n", algos[a].name, payloadSizes[p]);
+                ok = FALSE;
+            }
+        }
+    }
+    if (!check_timers() || !check_early_media(&algos[0]))
+        ok = FALSE;
+    if (!bench_crc(packets))
+        ok = FALSE;
+#ifdef __GLIBC__
+    bench_element_memory();
+#endif
+
+    g_free(cipher);
+    return ok ? 0 : 1;
+}
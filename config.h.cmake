@@ -14,9 +14,18 @@
 /* Define to 1 if you have the <openssl/sha.h> header file. */
 #cmakedefine  HAVE_OPENSSL_SHA_H 1
 
+/* Define to 1 if you have the <openssl/evp.h> header file. */
+#cmakedefine  HAVE_OPENSSL_EVP_H 1
+
+/* Define to 1 if the crypto library supports AES-GCM (EVP_aes_128_gcm). */
+#cmakedefine  HAVE_OPENSSL_GCM 1
+
 /* Define to 1 if you have the <pthread.h> header file. */
 #cmakedefine  HAVE_PTHREAD_H 1
 
+/* Define to 1 if you have the <sys/sdt.h> header file and USDT probes are enabled. */
+#cmakedefine  HAVE_SYS_SDT_H 1
+
 /* Name of package */
 #define PACKAGE "${PACKAGE}"
 
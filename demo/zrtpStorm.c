@@ -0,0 +1,370 @@
+#include <gst/gst.h>
+#include <glib.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+/*
+ * This program starts many ZRTP calls at the same time and measures how the
+ * ZRTP filter copes with a call storm.
+ *
+ * Each call is a back-to-back pair of zrtpfilter elements, one on side A and
+ * one on side B. Both sides cannot live in one process: the ZRTP cache (and
+ * thus the ZID) is a process wide singleton and ZRTP refuses to negotiate
+ * with a peer that has the same ZID. Therefore the program forks, the parent
+ * is side A, the child is side B, each side uses its own cache file and the
+ * pairs exchange their packets over the loopback interface. In gst-launch
+ * notation one call on side A is:
+ *
+ *   udpsrc port=P ! zrtp.recv_rtp_sink zrtp.recv_rtp_src ! fakesink
+ *   zrtp.send_rtp_src ! udpsink clients="127.0.0.1:P+2"
+ *
+ * Side B uses the ports the other way round. The calls do not send RTP
+ * data, the filters use a fixed local SSRC. Side B waits for the Hello
+ * packets, side A starts all calls at once after side B is ready.
+ *
+ * With -m each call also gets a multi-stream slave session. The master's
+ * secure state enables the slave with the multi-stream parameters, as
+ * zrtpRecvMulti does. If the master cannot offer multi-stream mode the
+ * slave does not start and counts as not secure.
+ *
+ * When all sessions are secure (or after the timeout) each side prints:
+ * - the time-to-secure percentiles, measured by the filter from the start of
+ *   the ZRTP engine, i.e. the first Hello, until zrtp_InfoSecureStateOn,
+ * - the CPU time (user + system) per handshake,
+ * - the peak RSS of the process.
+ *
+ * Usage: zrtpStorm [-n calls] [-m] [-p base-port] [-t timeout]
+ *
+ * Each call needs two sockets per session and side, raise the file
+ * descriptor limit (ulimit -n) for large storms.
+ */
+
+#define SECURE_STATE_ON 10
+
+typedef struct {
+    GstElement* zrtp;
+    GstElement* slave;              /* multi-stream slave session or NULL */
+} StormSession;
+
+static GMainLoop* loop;
+static volatile gint secureCount;
+static volatile gint doneCount;         /* secure sessions and slaves that cannot start */
+static gint expected;
+static gboolean sideA;
+
+static gboolean
+bus_call (GstBus     *bus,
+          GstMessage *msg,
+          gpointer    data)
+{
+    switch (GST_MESSAGE_TYPE (msg)) {
+
+        case GST_MESSAGE_ERROR: {
+            gchar  *debug;
+            GError *error;
+
+            gst_message_parse_error (msg, &error, &debug);
+            g_free (debug);
+
+            g_printerr ("Side %c error: %s\n", sideA ? 'A' : 'B', error->message);
+            g_error_free (error);
+
+            g_main_loop_quit (loop);
+            break;
+        }
+        default:
+            break;
+    }
+
+    return TRUE;
+}
+
+/* Keep running a bit after the last secure state, the peer may still wait for a Conf2Ack */
+static gboolean
+storm_linger (gpointer data)
+{
+    g_main_loop_quit (loop);
+    return FALSE;
+}
+
+static gboolean
+storm_done (gpointer data)
+{
+    g_timeout_add_seconds (2, storm_linger, NULL);
+    return FALSE;
+}
+
+static gboolean
+storm_timeout (gpointer data)
+{
+    g_printerr ("Side %c: timeout, %d of %d sessions secure\n", sideA ? 'A' : 'B',
+                g_atomic_int_get (&secureCount), expected);
+    g_main_loop_quit (loop);
+    return FALSE;
+}
+
+static void
+storm_finish (gboolean secure)
+{
+    if (secure)
+        g_atomic_int_inc (&secureCount);
+    /* Signals arrive in streaming threads, the last one stops the main loop */
+    if (g_atomic_int_add (&doneCount, 1) + 1 == expected)
+        g_idle_add (storm_done, NULL);
+}
+
+static void
+zrtp_statusSlave (GstElement *element, gint severity, gint subCode, gpointer data)  {
+    if (severity == 1 && subCode == SECURE_STATE_ON)
+        storm_finish (TRUE);
+}
+
+static void
+zrtp_statusMaster (GstElement *element, gint severity, gint subCode, gpointer data)  {
+    StormSession* session = (StormSession*)data;
+
+    if (severity != 1 || subCode != SECURE_STATE_ON)
+        return;
+
+    if (session->slave != NULL) {
+        GByteArray* mspArr;
+        gboolean available = FALSE;
+
+        g_object_get (G_OBJECT(element), "multi-available", &available, NULL);
+        if (!available) {
+            g_printerr ("Side %c: multi-stream mode not available, slave session not started\n",
+                        sideA ? 'A' : 'B');
+            storm_finish (FALSE);
+        }
+        else {
+            g_object_get (G_OBJECT(element), "multi-param", &mspArr, NULL);
+            g_object_set (G_OBJECT(session->slave), "multi-param", mspArr, NULL);
+            g_byte_array_unref (mspArr);
+            g_object_set (G_OBJECT(session->slave), "enable", TRUE, NULL);
+            if (sideA)
+                g_object_set (G_OBJECT(session->slave), "start", TRUE, NULL);
+        }
+    }
+    storm_finish (TRUE);
+}
+
+/* Add one ZRTP session to the pipeline, receive at port, send to peerPort */
+static GstElement*
+storm_add_session (GstElement* pipe, gint port, gint peerPort, guint32 ssrc, gboolean slave)
+{
+    GstElement *udpRecv, *udpSend, *zrtp, *sink;
+    gchar* clients;
+
+    udpRecv = gst_element_factory_make ("udpsrc", NULL);
+    udpSend = gst_element_factory_make ("udpsink", NULL);
+    zrtp    = gst_element_factory_make ("zrtpfilter", NULL);
+    sink    = gst_element_factory_make ("fakesink", NULL);
+
+    if (!udpRecv || !udpSend || !zrtp || !sink) {
+        g_printerr ("One element could not be created. Exiting.\n");
+        exit (1);
+    }
+    g_object_set (G_OBJECT(udpRecv), "port", port, NULL);
+
+    clients = g_strdup_printf ("127.0.0.1:%d", peerPort);
+    g_object_set (G_OBJECT(udpSend), "clients", clients, "sync", FALSE, "async", FALSE, NULL);
+    g_free (clients);
+
+    g_object_set (G_OBJECT(sink), "sync", FALSE, "async", FALSE, NULL);
+
+    /* A slave multi-stream session must not be enabled during initialization */
+    g_object_set (G_OBJECT(zrtp), "cache-name", sideA ? "gstZrtpStormA.dat" : "gstZrtpStormB.dat", NULL);
+    g_object_set (G_OBJECT(zrtp), "local-ssrc", ssrc, NULL);
+    g_object_set (G_OBJECT(zrtp), "initialize", !slave, NULL);
+
+    gst_bin_add_many (GST_BIN(pipe), udpRecv, zrtp, sink, udpSend, NULL);
+    gst_element_link_pads (udpRecv, "src", zrtp, "recv_rtp_sink");
+    gst_element_link_pads (zrtp, "recv_rtp_src", sink, "sink");
+    gst_element_link_pads (zrtp, "send_rtp_src", udpSend, "sink");
+    return zrtp;
+}
+
+static guint64
+storm_handshake_duration (GstElement* zrtp)
+{
+    GstStructure* stats = NULL;
+    guint64 duration = 0;
+
+    g_object_get (G_OBJECT(zrtp), "stats", &stats, NULL);
+    if (stats != NULL) {
+        gst_structure_get_uint64 (stats, "handshake-duration", &duration);
+        gst_structure_free (stats);
+    }
+    return duration;
+}
+
+static int
+compare_u64 (const void* a, const void* b)
+{
+    guint64 x = *(const guint64*)a;
+    guint64 y = *(const guint64*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void
+storm_report (StormSession* sessions, gint calls, struct rusage* start)
+{
+    struct rusage end;
+    guint64* times;
+    gint i, n = 0;
+    gdouble cpu;
+
+    times = g_new (guint64, calls * 2);
+    for (i = 0; i < calls; i++) {
+        guint64 d = storm_handshake_duration (sessions[i].zrtp);
+
+        if (d != 0)
+            times[n++] = d;
+        if (sessions[i].slave != NULL && (d = storm_handshake_duration (sessions[i].slave)) != 0)
+            times[n++] = d;
+    }
+    getrusage (RUSAGE_SELF, &end);
+    cpu = (end.ru_utime.tv_sec - start->ru_utime.tv_sec) * 1e3 + (end.ru_utime.tv_usec - start->ru_utime.tv_usec) / 1e3 +
+          (end.ru_stime.tv_sec - start->ru_stime.tv_sec) * 1e3 + (end.ru_stime.tv_usec - start->ru_stime.tv_usec) / 1e3;
+
+    g_print ("Side %c: %d of %d sessions secure\n", sideA ? 'A' : 'B', n, expected);
+    if (n > 0) {
+        qsort (times, n, sizeof(guint64), compare_u64);
+        g_print ("Side %c: time to secure ms: p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n", sideA ? 'A' : 'B',
+                 times[n / 2] / 1e6, times[n * 90 / 100] / 1e6, times[n * 99 / 100] / 1e6, times[n - 1] / 1e6);
+        g_print ("Side %c: CPU per handshake: %.2f ms\n", sideA ? 'A' : 'B', cpu / n);
+    }
+    g_print ("Side %c: peak RSS: %ld kB\n", sideA ? 'A' : 'B', end.ru_maxrss);
+    g_free (times);
+}
+
+static int
+storm_run (gint calls, gboolean multi, gint basePort, gint timeout, int readyFd)
+{
+    GstElement* stormPipe;
+    GstBus* bus;
+    StormSession* sessions;
+    struct rusage start;
+    gint i, port, peer;
+    gchar ready = 'r';
+
+    gst_init (NULL, NULL);
+    loop = g_main_loop_new (NULL, FALSE);
+    expected = multi ? calls * 2 : calls;
+
+    stormPipe = gst_pipeline_new (sideA ? "storm-a" : "storm-b");
+    bus = gst_pipeline_get_bus (GST_PIPELINE(stormPipe));
+    gst_bus_add_watch (bus, bus_call, loop);
+    gst_object_unref (bus);
+
+    /* Call i uses port base + 4i on side A and base + 4i + 2 on side B, slaves follow all masters */
+    sessions = g_new0 (StormSession, calls);
+    for (i = 0; i < calls; i++) {
+        port = basePort + 4 * i + (sideA ? 0 : 2);
+        peer = basePort + 4 * i + (sideA ? 2 : 0);
+        sessions[i].zrtp = storm_add_session (stormPipe, port, peer, (sideA ? 0x10000000 : 0x20000000) + 2 * i, FALSE);
+        if (multi) {
+            port += 4 * calls;
+            peer += 4 * calls;
+            sessions[i].slave = storm_add_session (stormPipe, port, peer, (sideA ? 0x10000001 : 0x20000001) + 2 * i, TRUE);
+            g_signal_connect (sessions[i].slave, "status", G_CALLBACK(zrtp_statusSlave), &sessions[i]);
+        }
+        g_signal_connect (sessions[i].zrtp, "status", G_CALLBACK(zrtp_statusMaster), &sessions[i]);
+    }
+
+    gst_element_set_state (stormPipe, GST_STATE_PLAYING);
+    gst_element_get_state (stormPipe, NULL, NULL, GST_CLOCK_TIME_NONE);
+
+    getrusage (RUSAGE_SELF, &start);
+    if (sideA) {
+        /* Wait until side B listens, then start all calls at once */
+        if (read (readyFd, &ready, 1) != 1)
+            g_printerr ("Side B did not start\n");
+        for (i = 0; i < calls; i++)
+            g_object_set (G_OBJECT(sessions[i].zrtp), "start", TRUE, NULL);
+    }
+    else {
+        if (write (readyFd, &ready, 1) != 1)
+            g_printerr ("Cannot signal side A\n");
+    }
+    close (readyFd);
+
+    g_timeout_add_seconds (timeout, storm_timeout, NULL);
+    g_main_loop_run (loop);
+
+    storm_report (sessions, calls, &start);
+
+    gst_element_set_state (stormPipe, GST_STATE_NULL);
+    gst_object_unref (GST_OBJECT(stormPipe));
+    g_free (sessions);
+
+    return g_atomic_int_get (&secureCount) == expected ? 0 : 1;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    gint calls = 100;
+    gint basePort = 24000;
+    gint timeout = 60;
+    gboolean multi = FALSE;
+    GError* error = NULL;
+    GOptionContext* ctx;
+    int fds[2];
+    int rc, status;
+    pid_t pid;
+
+    GOptionEntry entries[] = {
+        { "calls", 'n', 0, G_OPTION_ARG_INT, &calls, "Number of concurrent calls", "N" },
+        { "multi", 'm', 0, G_OPTION_ARG_NONE, &multi, "Add a multi-stream slave session to each call", NULL },
+        { "port", 'p', 0, G_OPTION_ARG_INT, &basePort, "First UDP port", "PORT" },
+        { "timeout", 't', 0, G_OPTION_ARG_INT, &timeout, "Give up after this many seconds", "SECONDS" },
+        { NULL }
+    };
+
+    ctx = g_option_context_new ("- ZRTP call storm");
+    g_option_context_add_main_entries (ctx, entries, NULL);
+    if (!g_option_context_parse (ctx, &argc, &argv, &error)) {
+        g_printerr ("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free (ctx);
+
+    if (calls < 1 || basePort + 4 * calls * (multi ? 2 : 1) > 65535) {
+        g_printerr ("Number of calls does not fit into the UDP port range\n");
+        return 1;
+    }
+
+    /* Fork before GStreamer and ZRTP initialize, each side has its own ZRTP cache */
+    if (pipe (fds) != 0) {
+        g_printerr ("Cannot create pipe\n");
+        return 1;
+    }
+    pid = fork ();
+    if (pid < 0) {
+        g_printerr ("Cannot fork\n");
+        return 1;
+    }
+    if (pid == 0) {
+        close (fds[0]);
+        sideA = FALSE;
+        return storm_run (calls, multi, basePort, timeout, fds[1]);
+    }
+    close (fds[1]);
+    sideA = TRUE;
+    g_print ("Starting %d calls%s\n", calls, multi ? " with multi-stream sessions" : "");
+    rc = storm_run (calls, multi, basePort, timeout, fds[0]);
+
+    waitpid (pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        rc = 1;
+    return rc;
+}
@@ -17,17 +17,1229 @@
 
 */
 
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
 #include <CryptoContext.h>
 #include <CryptoContextCtrl.h>
+#include <cryptcommon/aes.h>
+
+#include <gst/gst.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <immintrin.h>
+#endif
+
+#include <gstSrtpCWrapper.h>
+#include <gstzrtpaes.h>
+#include <gstzrtpmeta.h>
+// #include <arpa/inet.h>
+
+#if defined(HAVE_OPENSSL_EVP_H) && defined(HAVE_OPENSSL_GCM) && GST_CHECK_VERSION(1,0,0)
+#  define ZSRTP_HAVE_AEAD 1
+#  include <openssl/evp.h>
+#endif
+
+#if GST_CHECK_VERSION(1,0,0)
+/* Attach the parsed header and the index if the context has the meta enabled */
+static inline void
+attachMeta(ZsrtpContext* ctx, GstBuffer* gstBuf, uint32_t ssrc, uint16_t seqnum,
+           int32_t headerLength, uint64_t index)
+{
+    if (ctx->meta)
+        gst_buffer_add_zrtp_srtp_meta(gstBuf, ssrc, seqnum, headerLength, index,
+                                      (GstZrtpSrtpMetaFlags)ctx->metaFlags);
+}
+#endif
+
+/*
+ * Replay window and index estimation of a receiving SRTP wrapper.
+ *
+ * CryptoContext checks replay with a fixed window of 64 packets and guesses
+ * the ROC relative to the last packet, the wrapper does both itself. It
+ * keeps the highest authenticated index and a bitmap of the packets below
+ * it, bit i of the bitmap is index (top - i). A new highest index shifts
+ * the bitmap by whole words first, then by the remaining bits. The index
+ * estimation of RFC 3711, appendix A, is relative to the highest index as
+ * well, thus a packet from before a ROC wrap that arrives after the wrap
+ * still gets the old ROC.
+ */
+struct ZsrtpReplay {
+    uint64_t top;           /* highest index, ROC << 16 before the first packet */
+    int32_t  started;       /* top is the index of a packet */
+    int32_t  words;         /* bitmap size in 64 bit words */
+    uint64_t bits[1];       /* words entries, bit 0 of bits[0] is top */
+};
+
+#define REPLAY_SIZE(words) (offsetof(ZsrtpReplay, bits) + (words) * sizeof(uint64_t))
+
+static ZsrtpReplay*
+replayCreate(int32_t size, uint32_t roc)
+{
+    int32_t words = (size + 63) / 64;
+    ZsrtpReplay* replay = static_cast<ZsrtpReplay*>(g_slice_alloc0(REPLAY_SIZE(words)));
+
+    replay->top = (uint64_t)roc << 16;
+    replay->words = words;
+    return replay;
+}
+
+static void
+replayDestroy(ZsrtpReplay* replay)
+{
+    if (replay != NULL)
+        g_slice_free1(REPLAY_SIZE(replay->words), replay);
+}
+
+/*
+ * Estimate the index of a received packet and check it against the window.
+ * Returns false for a replayed packet, a packet older than the window and a
+ * packet from before index 0.
+ */
+static inline bool
+replayCheck(const ZsrtpReplay* replay, uint16_t seqnum, uint64_t* index)
+{
+    uint64_t roc = replay->top >> 16;
+    uint16_t s_l = (uint16_t)replay->top;
+
+    if (replay->started) {
+        if (s_l < 0x8000 && seqnum > s_l + 0x8000) {
+            if (roc == 0)
+                return false;
+            roc--;
+        }
+        else if (s_l >= 0x8000 && seqnum < s_l - 0x8000) {
+            roc++;
+        }
+    }
+    *index = (roc << 16) | seqnum;
+    if (!replay->started || *index > replay->top)
+        return true;
+
+    uint64_t delta = replay->top - *index;
+    if (delta >= (uint64_t)replay->words * 64)
+        return false;
+    return ((replay->bits[delta / 64] >> (delta % 64)) & 1) == 0;
+}
+
+/* Record an authenticated packet that passed replayCheck() */
+static inline void
+replayUpdate(ZsrtpReplay* replay, uint64_t index)
+{
+    uint64_t* bits = replay->bits;
+    int32_t words = replay->words;
+
+    if (replay->started && index <= replay->top) {
+        uint64_t delta = replay->top - index;
+        bits[delta / 64] |= (uint64_t)1 << (delta % 64);
+        return;
+    }
+    uint64_t shift = replay->started ? index - replay->top : (uint64_t)words * 64;
+
+    if (shift >= (uint64_t)words * 64) {
+        memset(bits, 0, words * sizeof(uint64_t));
+    }
+    else {
+        int32_t w = (int32_t)(shift / 64);
+        int32_t b = (int32_t)(shift % 64);
+
+        for (int32_t i = words - 1; i >= w; i--) {
+            uint64_t v = bits[i - w] << b;
+            if (b != 0 && i > w)
+                v |= bits[i - w - 1] >> (64 - b);
+            bits[i] = v;
+        }
+        for (int32_t i = 0; i < w; i++)
+            bits[i] = 0;
+    }
+    bits[0] |= 1;
+    replay->top = index;
+    replay->started = 1;
+}
+
+/*
+ * AES-GCM (RFC 7714) state of a SRTP or SRTCP wrapper.
+ *
+ * CryptoContext does not implement AEAD transforms. The wrapper creates the
+ * CryptoContext with Null algorithms and uses it for the ROC of sent packets
+ * only. The session key and salt are derived here with the AES-CM
+ * PRF of RFC 3711, chapter 4.3, from a 96 bit master salt as RFC 7714,
+ * chapter 12, requires, and the EVP context keeps the expanded key
+ * for the lifetime of the wrapper. EVP uses AES-NI and PCLMULQDQ (or the
+ * ARMv8 crypto extensions) if the CPU provides them.
+ */
+struct ZsrtpAead {
+    uint8_t  masterKey[32];
+    int32_t  masterKeyLength;
+    uint8_t  masterSalt[12];
+    uint8_t  sessionSalt[12];
+#ifdef ZSRTP_HAVE_AEAD
+    EVP_CIPHER_CTX* cipher;
+#endif
+};
+
+#define AEAD_IV_LENGTH    12
+
+/* key derivation labels, RFC 3711 chapter 4.3.2 */
+#define LABEL_SRTP_KEY    0x00
+#define LABEL_SRTP_AUTH   0x01
+#define LABEL_SRTP_SALT   0x02
+#define LABEL_SRTCP_KEY   0x03
+#define LABEL_SRTCP_AUTH  0x04
+#define LABEL_SRTCP_SALT  0x05
+
+#if GST_CHECK_VERSION(1,0,0)
+static void
+resize_buffer(GstBuffer *buffer, gsize len)
+{
+    gsize size, maxsize, offset;
+
+    size = gst_buffer_get_sizes(buffer, &offset, &maxsize);
+    g_return_if_fail(len > size);
+
+    /* Use the tailroom if the upstream allocator reserved enough of it,
+     * otherwise append a memory chunk. The following gst_buffer_map()
+     * must merge these chunks, thus it's a slow path.
+     */
+    if (offset + len <= maxsize) {
+        gst_buffer_set_size(buffer, len);
+    } else {
+        GstMemory *mem = gst_allocator_alloc (NULL, len - size, NULL);
+        gst_buffer_append_memory(buffer, mem);
+    }
+}
+
+/*
+ * Compute the RTP header length including CSRC list and header extension.
+ * Returns 0 if the data is not a valid RTP header.
+ */
+static int32_t
+rtpHeaderLength(const uint8_t* data, int32_t length)
+{
+    if (length < 12 || (data[0] & 0xc0) != 0x80)
+        return 0;
+
+    int32_t headerLength = 12 + (data[0] & 0x0f) * 4;
+
+    if (data[0] & 0x10) {
+        if (headerLength + 4 > length)
+            return 0;
+        headerLength += 4 + ((data[headerLength + 2] << 8) | data[headerLength + 3]) * 4;
+    }
+    return headerLength <= length ? headerLength : 0;
+}
+#endif
+
+int32_t zsrtp_hasAeadSupport(void)
+{
+#ifdef ZSRTP_HAVE_AEAD
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+#ifdef ZSRTP_HAVE_AEAD
+static const EVP_CIPHER*
+aeadCipher(int32_t keyLength, bool gcm)
+{
+    switch (keyLength) {
+    case 16:
+        return gcm ? EVP_aes_128_gcm() : EVP_aes_128_ctr();
+    case 24:
+        return gcm ? EVP_aes_192_gcm() : EVP_aes_192_ctr();
+    case 32:
+        return gcm ? EVP_aes_256_gcm() : EVP_aes_256_ctr();
+    }
+    return NULL;
+}
+
+static ZsrtpAead*
+aeadCreate(uint8_t* masterKey, int32_t masterKeyLength,
+           uint8_t* masterSalt, int32_t masterSaltLength)
+{
+    if (aeadCipher(masterKeyLength, true) == NULL)
+        return NULL;
+
+    ZsrtpAead* aead = g_slice_new0(ZsrtpAead);
+
+    memcpy(aead->masterKey, masterKey, masterKeyLength);
+    aead->masterKeyLength = masterKeyLength;
+
+    /* RFC 7714 uses a 96 bit master salt, take the first 12 bytes of the
+     * 112 bit salt that ZRTP negotiates, pad shorter salts with zeros */
+    if (masterSaltLength > (int32_t)sizeof(aead->masterSalt))
+        masterSaltLength = sizeof(aead->masterSalt);
+    memcpy(aead->masterSalt, masterSalt, masterSaltLength);
+
+    aead->cipher = EVP_CIPHER_CTX_new();
+    return aead;
+}
+
+static void
+aeadDestroy(ZsrtpAead* aead)
+{
+    if (aead == NULL)
+        return;
+
+    EVP_CIPHER_CTX_free(aead->cipher);
+    memset(aead, 0, sizeof(ZsrtpAead));
+    g_slice_free(ZsrtpAead, aead);
+}
+
+/*
+ * AES-CM PRF according to RFC 3711, chapter 4.3.1 and 4.3.3, with a key
+ * derivation rate of zero. The key_id (label || r) is XORed into the master
+ * salt, the result is the IV of an AES-CM keystream that forms the key. The
+ * 96 bit master salt is padded with zeros to 112 bit, RFC 7714 chapter 12.
+ */
+static bool
+aeadDeriveKey(ZsrtpAead* aead, uint8_t label, uint8_t* out, int32_t length)
+{
+    uint8_t iv[16];
+    int outLength;
+
+    memset(iv, 0, sizeof(iv));
+    memcpy(iv, aead->masterSalt, sizeof(aead->masterSalt));
+    iv[7] ^= label;
+
+    memset(out, 0, length);
+
+    EVP_CIPHER_CTX* prf = EVP_CIPHER_CTX_new();
+    bool ok = EVP_EncryptInit_ex(prf, aeadCipher(aead->masterKeyLength, false), NULL,
+                                 aead->masterKey, iv) == 1 &&
+              EVP_EncryptUpdate(prf, out, &outLength, out, length) == 1;
+    EVP_CIPHER_CTX_free(prf);
+    return ok;
+}
+
+static void
+aeadDeriveKeys(ZsrtpAead* aead, uint8_t keyLabel, uint8_t saltLabel)
+{
+    uint8_t sessionKey[32];
+
+    aeadDeriveKey(aead, keyLabel, sessionKey, aead->masterKeyLength);
+    aeadDeriveKey(aead, saltLabel, aead->sessionSalt, sizeof(aead->sessionSalt));
+
+    /* Expand the session key once, each packet sets the IV only */
+    EVP_CipherInit_ex(aead->cipher, aeadCipher(aead->masterKeyLength, true), NULL,
+                      NULL, NULL, 1);
+    EVP_CIPHER_CTX_ctrl(aead->cipher, EVP_CTRL_GCM_SET_IVLEN, AEAD_IV_LENGTH, NULL);
+    EVP_CipherInit_ex(aead->cipher, NULL, NULL, sessionKey, NULL, 1);
+
+    memset(sessionKey, 0, sizeof(sessionKey));
+}
+
+/*
+ * Encrypt or decrypt data in place and compute or check the tag.
+ *
+ * The 12 byte IV is XORed with the session salt, RFC 7714 chapter 8.1 and
+ * 9.1. Returns false if the cipher failed or, on decryption, if the tag does
+ * not match. Decryption writes into the buffer before the tag is verified,
+ * callers must drop the packet on failure.
+ */
+static bool
+aeadCrypt(ZsrtpAead* aead, uint8_t* iv, const uint8_t* aad, int32_t aadLength,
+          const uint8_t* aad2, int32_t aad2Length,
+          uint8_t* data, int32_t length, uint8_t* tag, int enc)
+{
+    EVP_CIPHER_CTX* c = aead->cipher;
+    int outLength;
+
+    for (int i = 0; i < AEAD_IV_LENGTH; i++)
+        iv[i] ^= aead->sessionSalt[i];
+
+    if (EVP_CipherInit_ex(c, NULL, NULL, NULL, iv, enc) != 1)
+        return false;
+    if (EVP_CipherUpdate(c, NULL, &outLength, aad, aadLength) != 1)
+        return false;
+    if (aad2Length > 0 && EVP_CipherUpdate(c, NULL, &outLength, aad2, aad2Length) != 1)
+        return false;
+    if (length > 0 && EVP_CipherUpdate(c, data, &outLength, data, length) != 1)
+        return false;
+
+    if (enc) {
+        if (EVP_CipherFinal_ex(c, data + length, &outLength) != 1)
+            return false;
+        return EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_GCM_GET_TAG, ZSRTP_AEAD_TAG_LENGTH, tag) == 1;
+    }
+    if (EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_GCM_SET_TAG, ZSRTP_AEAD_TAG_LENGTH, tag) != 1)
+        return false;
+    return EVP_CipherFinal_ex(c, data + length, &outLength) > 0;
+}
+
+static void
+aeadRtpIv(uint8_t* iv, uint32_t ssrc, uint32_t roc, uint16_t seqnum)
+{
+    iv[0] = iv[1] = 0;
+    iv[2] = ssrc >> 24; iv[3] = ssrc >> 16; iv[4] = ssrc >> 8; iv[5] = ssrc;
+    iv[6] = roc >> 24;  iv[7] = roc >> 16;  iv[8] = roc >> 8;  iv[9] = roc;
+    iv[10] = seqnum >> 8; iv[11] = seqnum;
+}
+
+static void
+aeadRtcpIv(uint8_t* iv, uint32_t ssrc, uint32_t index)
+{
+    memset(iv, 0, AEAD_IV_LENGTH);
+    iv[2] = ssrc >> 24;  iv[3] = ssrc >> 16;  iv[4] = ssrc >> 8;   iv[5] = ssrc;
+    iv[8] = (index >> 24) & 0x7f; iv[9] = index >> 16; iv[10] = index >> 8; iv[11] = index;
+}
+
+static int32_t
+aeadProtect(ZsrtpContext* ctx, GstBuffer* gstBuf)
+{
+    CryptoContext* pcc = ctx->srtp;
+    GstMapInfo mapInfo;
+    uint8_t iv[AEAD_IV_LENGTH];
+
+    gint32 length = gst_buffer_get_size(gstBuf);
+
+    resize_buffer(gstBuf, length + ZSRTP_AEAD_TAG_LENGTH);
+
+    if (!gst_buffer_map(gstBuf, &mapInfo, (GstMapFlags) GST_MAP_READWRITE)) {
+        gst_buffer_set_size(gstBuf, length);
+        return 0;
+    }
+    guint8* data = mapInfo.data;
+
+    int32_t headerLength = rtpHeaderLength(data, length);
+    if (headerLength == 0) {
+        gst_buffer_unmap(gstBuf, &mapInfo);
+        gst_buffer_set_size(gstBuf, length);
+        return 0;
+    }
+    uint16_t seqnum = (data[2] << 8) | data[3];
+    uint32_t ssrc = g_ntohl(*(reinterpret_cast<guint32*>(data + 8)));
+
+    /* The RTP header is the AAD, RFC 7714 chapter 8.2 */
+    uint64_t index = ((uint64_t)pcc->getRoc() << 16) | (uint64_t)seqnum;
+    aeadRtpIv(iv, ssrc, pcc->getRoc(), seqnum);
+    /* The payload may be partly encrypted on failure, the caller drops the packet */
+    if (!aeadCrypt(ctx->aead, iv, data, headerLength, NULL, 0,
+                   data + headerLength, length - headerLength, data + length, 1)) {
+        gst_buffer_unmap(gstBuf, &mapInfo);
+        gst_buffer_set_size(gstBuf, length);
+        return 0;
+    }
+
+    /* Update the ROC if necessary */
+    if (seqnum == 0xFFFF ) {
+        pcc->setRoc(pcc->getRoc() + 1);
+    }
+    gst_buffer_unmap(gstBuf, &mapInfo);
+    attachMeta(ctx, gstBuf, ssrc, seqnum, headerLength, index);
+    return 1;
+}
+
+static int32_t
+aeadUnprotect(ZsrtpContext* ctx, GstBuffer* gstBuf)
+{
+    GstMapInfo mapInfo;
+    uint8_t iv[AEAD_IV_LENGTH];
+    int32_t rc = 1;
+
+    if (!gst_buffer_map(gstBuf, &mapInfo, (GstMapFlags) GST_MAP_READWRITE))
+        return -1;
+
+    gint32 length = mapInfo.size - ZSRTP_AEAD_TAG_LENGTH;
+    guint8* data = mapInfo.data;
+
+    int32_t headerLength = length > 0 ? rtpHeaderLength(data, length) : 0;
+    if (headerLength == 0) {
+        gst_buffer_unmap(gstBuf, &mapInfo);
+        return -1;
+    }
+    uint16_t seqnum = (data[2] << 8) | data[3];
+    uint32_t ssrc = g_ntohl(*(reinterpret_cast<guint32*>(data + 8)));
+
+    uint64_t guessedIndex;
+    if (!replayCheck(ctx->replay, seqnum, &guessedIndex)) {
+        gst_buffer_unmap(gstBuf, &mapInfo);
+        return -2;
+    }
+
+    aeadRtpIv(iv, ssrc, guessedIndex >> 16, seqnum);
+    if (aeadCrypt(ctx->aead, iv, data, headerLength, NULL, 0,
+                  data + headerLength, length - headerLength, data + length, 0)) {
+        replayUpdate(ctx->replay, guessedIndex);
+    }
+    else {
+        rc = -1;
+    }
+    gst_buffer_unmap(gstBuf, &mapInfo);
+
+    if (rc == 1) {
+        gst_buffer_set_size(gstBuf, length);
+        attachMeta(ctx, gstBuf, ssrc, seqnum, headerLength, guessedIndex);
+    }
+    return rc;
+}
+
+static int32_t
+aeadProtectCtrl(ZsrtpContextCtrl* ctx, GstBuffer* gstBuf)
+{
+    GstMapInfo mapInfo;
+    uint8_t iv[AEAD_IV_LENGTH];
+
+    gint32 length = gst_buffer_get_size(gstBuf);
+    if (length < 8)
+        return 0;
+
+    resize_buffer(gstBuf, length + ZSRTP_AEAD_TAG_LENGTH + sizeof(uint32_t));
+
+    if (!gst_buffer_map(gstBuf, &mapInfo, (GstMapFlags) GST_MAP_READWRITE)) {
+        gst_buffer_set_size(gstBuf, length);
+        return 0;
+    }
+    guint8* data = mapInfo.data;
+
+    uint32_t ssrc = g_ntohl(*(reinterpret_cast<guint32*>(data + 4))); // always SSRC of sender
+    uint32_t encIndex = ctx->srtcpIndex | 0x80000000;                  // set the E flag
+
+    /* E flag and SRTCP index follow the tag, RFC 7714 chapter 9.2 */
+    uint32_t* ip = reinterpret_cast<uint32_t*>(data + length + ZSRTP_AEAD_TAG_LENGTH);
+    *ip = g_htonl(encIndex);
+
+    /* AAD is the fixed RTCP header and the E flag/index word, RFC 7714 chapter 9.3 */
+    aeadRtcpIv(iv, ssrc, ctx->srtcpIndex);
+    if (!aeadCrypt(ctx->aead, iv, data, 8, reinterpret_cast<uint8_t*>(ip), sizeof(uint32_t),
+                   data + 8, length - 8, data + length, 1)) {
+        gst_buffer_unmap(gstBuf, &mapInfo);
+        gst_buffer_set_size(gstBuf, length);
+        return 0;
+    }
+
+    ctx->srtcpIndex++;
+    ctx->srtcpIndex &= ~0x80000000;       // clear possible overflow
+
+    gst_buffer_unmap(gstBuf, &mapInfo);
+    return 1;
+}
+
+static int32_t
+aeadUnprotectCtrl(ZsrtpContextCtrl* ctx, GstBuffer* gstBuf)
+{
+    CryptoContextCtrl* pcc = ctx->srtcp;
+    GstMapInfo mapInfo;
+    uint8_t iv[AEAD_IV_LENGTH];
+    int32_t rc = 1;
+
+    if (!gst_buffer_map(gstBuf, &mapInfo, (GstMapFlags) GST_MAP_READWRITE))
+        return -1;
+
+    guint8* data = mapInfo.data;
+    int32_t length = mapInfo.size - (ZSRTP_AEAD_TAG_LENGTH + sizeof(uint32_t));
+    if (length < 8) {
+        gst_buffer_unmap(gstBuf, &mapInfo);
+        return -1;
+    }
+    uint8_t* tag = data + length;
+    uint8_t* ip = tag + ZSRTP_AEAD_TAG_LENGTH;
+
+    uint32_t encIndex = g_ntohl(*(reinterpret_cast<uint32_t*>(ip)));
+    uint32_t remoteIndex = encIndex & ~0x80000000;    // index without Encryption flag
+
+    if (!pcc->checkReplay(remoteIndex)) {
+        gst_buffer_unmap(gstBuf, &mapInfo);
+        return -2;
+    }
+    uint32_t ssrc = g_ntohl(*(reinterpret_cast<guint32*>(data + 4)));
+
+    aeadRtcpIv(iv, ssrc, remoteIndex);
+
+    bool ok;
+    if (encIndex & 0x80000000)
+        ok = aeadCrypt(ctx->aead, iv, data, 8, ip, sizeof(uint32_t),
+                       data + 8, length - 8, tag, 0);
+    else    /* unencrypted SRTCP, the whole packet is AAD */
+        ok = aeadCrypt(ctx->aead, iv, data, length, ip, sizeof(uint32_t),
+                       NULL, 0, tag, 0);
+    if (ok) {
+        pcc->update(remoteIndex);
+    }
+    else {
+        rc = -1;
+    }
+    gst_buffer_unmap(gstBuf, &mapInfo);
+
+    if (rc == 1)
+        gst_buffer_set_size(gstBuf, length);
+    return rc;
+}
+#endif
+
+/*
+ * Precomputed HMAC-SHA1 of a SRTP or SRTCP wrapper.
+ *
+ * HMAC-SHA1 hashes the key XOR ipad block before and the key XOR opad block
+ * after the message. Both blocks depend on the session authentication key
+ * only, thus the wrapper computes the SHA-1 state after each of them once
+ * when it derives the keys and each packet starts from a copy of these
+ * states. For short audio packets this halves the compression function
+ * calls. The wrapper derives the authentication key itself with the AES-CM
+ * PRF of RFC 3711, the CryptoContext keeps its own copy and uses it only if
+ * the precomputed state is not available.
+ *
+ * The wrapper uses the precomputed state for HMAC-SHA1 with the AES-CM or
+ * AES-F8 PRF and a key derivation rate of zero, ZRTP always uses these. All
+ * other combinations use the CryptoContext functions. The tag compare is
+ * constant-time in both cases.
+ */
+struct ZsrtpHmac {
+    uint8_t  masterKey[32];
+    int32_t  masterKeyLength;
+    uint8_t  masterSalt[14];
+    int32_t  authKeyLength;
+    int32_t  tagLength;
+    bool     ready;             /* inner and outer state valid */
+    uint32_t inner[5];          /* SHA-1 state after the key XOR ipad block */
+    uint32_t outer[5];          /* SHA-1 state after the key XOR opad block */
+};
+
+#define SHA1_BLOCK        64
+#define SHA1_DIGEST       20
+
+static int32_t fastHmac = 1;
+
+#define ROL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+static void
+sha1Compress(uint32_t* h, const uint8_t* block)
+{
+    uint32_t w[16];
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = ((uint32_t)block[4*i] << 24) | ((uint32_t)block[4*i+1] << 16) |
+               ((uint32_t)block[4*i+2] << 8) | block[4*i+3];
+
+    for (i = 0; i < 80; i++) {
+        uint32_t f, k, t;
+
+        if (i >= 16) {
+            t = w[(i+13) & 15] ^ w[(i+8) & 15] ^ w[(i+2) & 15] ^ w[i & 15];
+            w[i & 15] = ROL32(t, 1);
+        }
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5a827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ed9eba1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8f1bbcdc;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xca62c1d6;
+        }
+        t = ROL32(a, 5) + f + e + k + w[i & 15];
+        e = d;
+        d = c;
+        c = ROL32(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+static void
+sha1StoreLength(uint8_t* block, uint64_t bytes)
+{
+    uint64_t bits = bytes * 8;
+
+    for (int i = 0; i < 8; i++)
+        block[63 - i] = (uint8_t)(bits >> (8 * i));
+}
+
+/*
+ * Build the last blocks of the inner hash: the bytes of data after the
+ * last full block, the 4 trailer bytes (ROC or SRTCP index, in network
+ * order) and the SHA-1 padding. Returns the number of tail blocks, 1 or 2.
+ */
+static int32_t
+hmacTail(const uint8_t* data, int32_t length, uint32_t trailer, uint8_t* tail)
+{
+    int32_t rem = length % SHA1_BLOCK;
+    int32_t blocks = (rem + 4 + 1 + 8 > SHA1_BLOCK) ? 2 : 1;
+
+    memcpy(tail, data + length - rem, rem);
+    tail[rem] = trailer >> 24; tail[rem+1] = trailer >> 16;
+    tail[rem+2] = trailer >> 8; tail[rem+3] = trailer;
+    tail[rem+4] = 0x80;
+    memset(tail + rem + 5, 0, blocks * SHA1_BLOCK - rem - 5);
+    sha1StoreLength(tail + (blocks - 1) * SHA1_BLOCK, (uint64_t)SHA1_BLOCK + length + 4);
+    return blocks;
+}
+
+/* The outer hash block: the inner digest fits into the one remaining block */
+static void
+hmacOuterBlock(const uint32_t* h, uint8_t* block)
+{
+    for (int i = 0; i < 5; i++) {
+        block[4*i] = h[i] >> 24; block[4*i+1] = h[i] >> 16;
+        block[4*i+2] = h[i] >> 8; block[4*i+3] = h[i];
+    }
+    block[SHA1_DIGEST] = 0x80;
+    memset(block + SHA1_DIGEST + 1, 0, SHA1_BLOCK - 8 - SHA1_DIGEST - 1);
+    sha1StoreLength(block, SHA1_BLOCK + SHA1_DIGEST);
+}
+
+/*
+ * HMAC-SHA1 of data followed by the 4 bytes of trailer, the digest stays
+ * in the SHA-1 state words.
+ */
+static void
+hmacSha1(const ZsrtpHmac* hmac, const uint8_t* data, int32_t length, uint32_t trailer, uint32_t* digest)
+{
+    uint8_t tail[2 * SHA1_BLOCK];
+    uint32_t h[5];
+    int32_t full = length / SHA1_BLOCK;
+    int32_t blocks, i;
+
+    memcpy(h, hmac->inner, sizeof(h));
+    for (i = 0; i < full; i++)
+        sha1Compress(h, data + i * SHA1_BLOCK);
+    blocks = hmacTail(data, length, trailer, tail);
+    for (i = 0; i < blocks; i++)
+        sha1Compress(h, tail + i * SHA1_BLOCK);
+
+    hmacOuterBlock(h, tail);
+    memcpy(digest, hmac->outer, 5 * sizeof(uint32_t));
+    sha1Compress(digest, tail);
+}
+
+/*
+ * Multi-buffer HMAC-SHA1: the packets of a batch share the key, thus all
+ * lanes start with the same inner and outer state. The AVX2 kernel runs
+ * the SHA-1 rounds of 8 packets in the 8 32-bit lanes of the vector
+ * registers, one block of each packet per step. Packets with fewer blocks
+ * hash a dummy block once they are done, their state is taken after their
+ * last block. Equal sized packets, e.g. a batch of G.711 frames, use all
+ * lanes in every step.
+ */
+typedef struct HmacJob {
+    const uint8_t* data;
+    int32_t  length;
+    uint32_t trailer;
+    uint32_t digest[5];
+} HmacJob;
+
+#define HMAC_LANES 8
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ZSRTP_HAVE_AVX2 1
+
+#define V_ROL(x, n) _mm256_or_si256(_mm256_slli_epi32((x), (n)), _mm256_srli_epi32((x), 32 - (n)))
+
+static inline uint32_t
+loadBe32(const uint8_t* p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return __builtin_bswap32(v);
+}
+
+/* One SHA-1 block for each of 8 lanes, block[j] is the block of lane j */
+__attribute__((target("avx2")))
+static void
+sha1Compress8(__m256i* h, const uint8_t* const* block)
+{
+    __m256i w[16];
+    __m256i a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = _mm256_set_epi32(loadBe32(block[7] + 4*i), loadBe32(block[6] + 4*i),
+                                loadBe32(block[5] + 4*i), loadBe32(block[4] + 4*i),
+                                loadBe32(block[3] + 4*i), loadBe32(block[2] + 4*i),
+                                loadBe32(block[1] + 4*i), loadBe32(block[0] + 4*i));
+
+    for (i = 0; i < 80; i++) {
+        __m256i f, k, t;
+
+        if (i >= 16) {
+            t = _mm256_xor_si256(_mm256_xor_si256(w[(i+13) & 15], w[(i+8) & 15]),
+                                 _mm256_xor_si256(w[(i+2) & 15], w[i & 15]));
+            w[i & 15] = V_ROL(t, 1);
+        }
+        if (i < 20) {
+            f = _mm256_or_si256(_mm256_and_si256(b, c), _mm256_andnot_si256(b, d));
+            k = _mm256_set1_epi32(0x5a827999);
+        } else if (i < 40) {
+            f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+            k = _mm256_set1_epi32(0x6ed9eba1);
+        } else if (i < 60) {
+            f = _mm256_or_si256(_mm256_and_si256(b, c), _mm256_and_si256(d, _mm256_or_si256(b, c)));
+            k = _mm256_set1_epi32(0x8f1bbcdc);
+        } else {
+            f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+            k = _mm256_set1_epi32(0xca62c1d6);
+        }
+        t = _mm256_add_epi32(_mm256_add_epi32(V_ROL(a, 5), f),
+                             _mm256_add_epi32(_mm256_add_epi32(e, k), w[i & 15]));
+        e = d;
+        d = c;
+        c = V_ROL(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] = _mm256_add_epi32(h[0], a);
+    h[1] = _mm256_add_epi32(h[1], b);
+    h[2] = _mm256_add_epi32(h[2], c);
+    h[3] = _mm256_add_epi32(h[3], d);
+    h[4] = _mm256_add_epi32(h[4], e);
+}
+
+/* HMAC-SHA1 of up to 8 jobs, unused lanes hash dummy blocks */
+__attribute__((target("avx2")))
+static void
+hmacSha1Lanes(const ZsrtpHmac* hmac, HmacJob* jobs, int32_t count)
+{
+    static const uint8_t dummy[SHA1_BLOCK] = { 0 };
+    uint8_t tails[HMAC_LANES][2 * SHA1_BLOCK];
+    const uint8_t* block[HMAC_LANES];
+    int32_t full[HMAC_LANES];
+    int32_t blocks[HMAC_LANES];
+    uint32_t lanes[5][HMAC_LANES];
+    __m256i h[5];
+    int32_t maxBlocks = 0;
+    int32_t i, j, k;
+
+    for (j = 0; j < count; j++) {
+        full[j] = jobs[j].length / SHA1_BLOCK;
+        blocks[j] = full[j] + hmacTail(jobs[j].data, jobs[j].length, jobs[j].trailer, tails[j]);
+        if (blocks[j] > maxBlocks)
+            maxBlocks = blocks[j];
+    }
+    for (; j < HMAC_LANES; j++)
+        blocks[j] = -1;
+
+    for (i = 0; i < 5; i++)
+        h[i] = _mm256_set1_epi32(hmac->inner[i]);
+
+    for (k = 0; k < maxBlocks; k++) {
+        bool finished = false;
+
+        for (j = 0; j < HMAC_LANES; j++) {
+            if (k < blocks[j])
+                block[j] = k < full[j] ? jobs[j].data + k * SHA1_BLOCK : tails[j] + (k - full[j]) * SHA1_BLOCK;
+            else
+                block[j] = dummy;
+            finished |= (k == blocks[j] - 1);
+        }
+        sha1Compress8(h, block);
+        if (!finished)
+            continue;
+
+        for (i = 0; i < 5; i++)
+            _mm256_storeu_si256((__m256i*)lanes[i], h[i]);
+        for (j = 0; j < count; j++) {
+            if (k == blocks[j] - 1) {
+                for (i = 0; i < 5; i++)
+                    jobs[j].digest[i] = lanes[i][j];
+            }
+        }
+    }
+
+    /* Outer hash, one block for every lane */
+    for (j = 0; j < HMAC_LANES; j++) {
+        if (j < count) {
+            hmacOuterBlock(jobs[j].digest, tails[j]);
+            block[j] = tails[j];
+        } else {
+            block[j] = dummy;
+        }
+    }
+    for (i = 0; i < 5; i++)
+        h[i] = _mm256_set1_epi32(hmac->outer[i]);
+    sha1Compress8(h, block);
+
+    for (i = 0; i < 5; i++)
+        _mm256_storeu_si256((__m256i*)lanes[i], h[i]);
+    for (j = 0; j < count; j++) {
+        for (i = 0; i < 5; i++)
+            jobs[j].digest[i] = lanes[i][j];
+    }
+}
+#endif
+
+static void
+hmacSha1Batch(const ZsrtpHmac* hmac, HmacJob* jobs, int32_t count)
+{
+#ifdef ZSRTP_HAVE_AVX2
+    static int avx2 = -1;
+
+    if (avx2 < 0)
+        avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+
+    /* a single packet is faster on the scalar path */
+    if (avx2 && count > 1) {
+        for (int32_t i = 0; i < count; i += HMAC_LANES)
+            hmacSha1Lanes(hmac, jobs + i, MIN(HMAC_LANES, count - i));
+        return;
+    }
+#endif
+    for (int32_t i = 0; i < count; i++)
+        hmacSha1(hmac, jobs[i].data, jobs[i].length, jobs[i].trailer, jobs[i].digest);
+}
+
+/* Write the truncated digest into the tag field of the packet */
+static inline void
+hmacStoreTag(const uint32_t* digest, uint8_t* tag, int32_t tagLength)
+{
+    for (int32_t i = 0; i < tagLength; i++)
+        tag[i] = (uint8_t)(digest[i >> 2] >> (24 - 8 * (i & 3)));
+}
+
+/* Constant-time compare of the truncated digest with the tag of the packet */
+static inline bool
+hmacCheckTag(const uint32_t* digest, const uint8_t* tag, int32_t tagLength)
+{
+    uint8_t diff = 0;
+
+    for (int32_t i = 0; i < tagLength; i++)
+        diff |= tag[i] ^ (uint8_t)(digest[i >> 2] >> (24 - 8 * (i & 3)));
+    return diff == 0;
+}
+
+/* Constant-time compare for the CryptoContext authentication path */
+static inline bool
+tagEqual(const uint8_t* a, const uint8_t* b, int32_t length)
+{
+    uint8_t diff = 0;
+
+    for (int32_t i = 0; i < length; i++)
+        diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+static ZsrtpHmac*
+hmacCreate(int32_t ealg, int32_t aalg, int64_t keyDerivRate,
+           const uint8_t* masterKey, int32_t masterKeyLength,
+           const uint8_t* masterSalt, int32_t masterSaltLength,
+           int32_t akeyl, int32_t tagLength)
+{
+    /* The NULL cipher uses the precomputed state in any case, see below */
+    if ((!fastHmac && ealg != SrtpEncryptionNull) || aalg != SrtpAuthenticationSha1Hmac ||
+        keyDerivRate != 0)
+        return NULL;
+    if (ealg != SrtpEncryptionAESCM && ealg != SrtpEncryptionAESF8 && ealg != SrtpEncryptionNull)
+        return NULL;
+    if ((masterKeyLength != 16 && masterKeyLength != 24 && masterKeyLength != 32) ||
+        akeyl <= 0 || akeyl > SHA1_BLOCK || tagLength > SHA1_DIGEST)
+        return NULL;
+
+    ZsrtpHmac* hmac = g_slice_new0(ZsrtpHmac);
+
+    memcpy(hmac->masterKey, masterKey, masterKeyLength);
+    hmac->masterKeyLength = masterKeyLength;
+    if (masterSaltLength > (int32_t)sizeof(hmac->masterSalt))
+        masterSaltLength = sizeof(hmac->masterSalt);
+    memcpy(hmac->masterSalt, masterSalt, masterSaltLength);
+    hmac->authKeyLength = akeyl;
+    hmac->tagLength = tagLength;
+    return hmac;
+}
+
+static ZsrtpHmac*
+hmacFork(const ZsrtpHmac* hmac)
+{
+    if (hmac == NULL)
+        return NULL;
+
+    ZsrtpHmac* fork = g_slice_dup(ZsrtpHmac, hmac);
+    fork->ready = false;
+    return fork;
+}
+
+static void
+hmacDestroy(ZsrtpHmac* hmac)
+{
+    if (hmac == NULL)
+        return;
+
+    memset(hmac, 0, sizeof(ZsrtpHmac));
+    g_slice_free(ZsrtpHmac, hmac);
+}
+
+/*
+ * AES-CM PRF, RFC 3711 chapter 4.3.1 and 4.3.3, key derivation rate zero.
+ * Uses the AES of the crypto module, both builds have it.
+ */
+static void
+prfDerive(const uint8_t* masterKey, int32_t masterKeyLength, const uint8_t* masterSalt,
+          uint8_t label, uint8_t* out, int32_t length)
+{
+    aes_encrypt_ctx aes[1];
+    uint8_t block[16];
+    uint8_t iv[16];
+
+    memset(iv, 0, sizeof(iv));
+    memcpy(iv, masterSalt, 14);
+    iv[7] ^= label;
+
+    aes_encrypt_key(masterKey, masterKeyLength, aes);
+    for (int32_t i = 0; i < length; i += 16) {
+        iv[14] = (uint8_t)(i >> 12);
+        iv[15] = (uint8_t)(i >> 4);
+        aes_encrypt(iv, block, aes);
+        memcpy(out + i, block, MIN(16, length - i));
+    }
+    memset(block, 0, sizeof(block));
+    memset(aes, 0, sizeof(aes));
+}
+
+/* Derive the authentication key and hash the ipad and opad blocks */
+static void
+hmacDeriveKeys(ZsrtpHmac* hmac, uint8_t label)
+{
+    static const uint32_t sha1Init[5] = {
+        0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+    };
+    uint8_t authKey[SHA1_BLOCK];
+    uint8_t block[SHA1_BLOCK];
+    int32_t i;
+
+    prfDerive(hmac->masterKey, hmac->masterKeyLength, hmac->masterSalt, label,
+              authKey, hmac->authKeyLength);
+
+    for (i = 0; i < SHA1_BLOCK; i++)
+        block[i] = (i < hmac->authKeyLength ? authKey[i] : 0) ^ 0x36;
+    memcpy(hmac->inner, sha1Init, sizeof(sha1Init));
+    sha1Compress(hmac->inner, block);
+
+    for (i = 0; i < SHA1_BLOCK; i++)
+        block[i] = (i < hmac->authKeyLength ? authKey[i] : 0) ^ 0x5c;
+    memcpy(hmac->outer, sha1Init, sizeof(sha1Init));
+    sha1Compress(hmac->outer, block);
+
+    memset(authKey, 0, sizeof(authKey));
+    memset(block, 0, sizeof(block));
+    hmac->ready = true;
+}
+
+/*
+ * AES-CM with the AES instructions of the CPU.
+ *
+ * The CryptoContext encrypts one block per AES call. If the CPU has AES
+ * instructions the wrapper derives the session key and salt itself, with
+ * the same PRF as above, and XORs the keystream of the gstzrtpaes.c kernels
+ * into the payload. The CryptoContext keeps its own keys and encrypts if
+ * the kernels are not available or disabled. This applies to AES-CM with a
+ * key derivation rate of zero and the standard 112 bit session salt, ZRTP
+ * always uses these.
+ */
+struct ZsrtpCtr {
+    uint8_t  masterKey[32];
+    int32_t  masterKeyLength;
+    uint8_t  masterSalt[14];
+    int32_t  keyLength;         /* session key */
+    bool     ready;             /* aes and sessionSalt valid */
+    uint8_t  sessionSalt[14];
+    ZrtpAesCtr aes;
+};
+
+static int32_t fastCipher = 1;
+
+static ZsrtpCtr*
+ctrCreate(int32_t ealg, int64_t keyDerivRate,
+          const uint8_t* masterKey, int32_t masterKeyLength,
+          const uint8_t* masterSalt, int32_t masterSaltLength,
+          int32_t ekeyl, int32_t skeyl)
+{
+    if (!fastCipher || ealg != SrtpEncryptionAESCM || keyDerivRate != 0)
+        return NULL;
+    if ((masterKeyLength != 16 && masterKeyLength != 24 && masterKeyLength != 32) ||
+        (ekeyl != 16 && ekeyl != 24 && ekeyl != 32) || skeyl != 14 || masterSaltLength < 14)
+        return NULL;
+    if (!zrtp_aes_ctr_available())
+        return NULL;
+
+    ZsrtpCtr* ctr = g_slice_new0(ZsrtpCtr);
+
+    memcpy(ctr->masterKey, masterKey, masterKeyLength);
+    ctr->masterKeyLength = masterKeyLength;
+    memcpy(ctr->masterSalt, masterSalt, sizeof(ctr->masterSalt));
+    ctr->keyLength = ekeyl;
+    return ctr;
+}
+
+static ZsrtpCtr*
+ctrFork(const ZsrtpCtr* ctr)
+{
+    if (ctr == NULL)
+        return NULL;
+
+    ZsrtpCtr* fork = g_slice_dup(ZsrtpCtr, ctr);
+    fork->ready = false;
+    return fork;
+}
+
+static void
+ctrDestroy(ZsrtpCtr* ctr)
+{
+    if (ctr == NULL)
+        return;
+
+    memset(ctr, 0, sizeof(ZsrtpCtr));
+    g_slice_free(ZsrtpCtr, ctr);
+}
+
+static void
+ctrDeriveKeys(ZsrtpCtr* ctr, uint8_t keyLabel, uint8_t saltLabel)
+{
+    uint8_t sessionKey[32];
+
+    prfDerive(ctr->masterKey, ctr->masterKeyLength, ctr->masterSalt, keyLabel,
+              sessionKey, ctr->keyLength);
+    prfDerive(ctr->masterKey, ctr->masterKeyLength, ctr->masterSalt, saltLabel,
+              ctr->sessionSalt, sizeof(ctr->sessionSalt));
+    zrtp_aes_ctr_init(&ctr->aes, sessionKey, ctr->keyLength);
 
-#include <gst/gst.h>
-#include <gst/rtp/gstrtpbuffer.h>
+    memset(sessionKey, 0, sizeof(sessionKey));
+    ctr->ready = true;
+}
 
-#include <string.h>
+/*
+ * AES-CM IV, RFC 3711 chapter 4.1.1: (k_s * 2^16) XOR (SSRC * 2^64) XOR
+ * (i * 2^16). The SRTP index has 48 bits, the SRTCP index 31 bits.
+ */
+static inline void
+ctrXor(ZsrtpCtr* ctr, uint32_t ssrc, uint64_t index, uint8_t* data, int32_t length)
+{
+    uint8_t iv[16];
+
+    memcpy(iv, ctr->sessionSalt, sizeof(ctr->sessionSalt));
+    iv[14] = iv[15] = 0;
+    iv[4] ^= ssrc >> 24;  iv[5] ^= ssrc >> 16;  iv[6] ^= ssrc >> 8;   iv[7] ^= ssrc;
+    iv[8] ^= index >> 40; iv[9] ^= index >> 32; iv[10] ^= index >> 24;
+    iv[11] ^= index >> 16; iv[12] ^= index >> 8; iv[13] ^= index;
+    zrtp_aes_ctr_xor(&ctr->aes, iv, data, length);
+}
 
-#include <gstSrtpCWrapper.h>
-// #include <arpa/inet.h>
+/* Encrypt or decrypt the SRTP payload */
+static inline void
+srtpCrypt(ZsrtpContext* ctx, uint8_t* packet, uint8_t* payload, int32_t length, uint64_t index, uint32_t ssrc)
+{
+    if (ctx->nullCipher)
+        return;
+    if (ctx->ctr != NULL && ctx->ctr->ready) {
+        ctrXor(ctx->ctr, ssrc, index, payload, length);
+        return;
+    }
+    ctx->srtp->srtpEncrypt(packet, payload, length, index, ssrc);
+}
+
+/* Encrypt or decrypt the SRTCP packet after the first 8 bytes */
+static inline void
+srtcpCrypt(ZsrtpContextCtrl* ctx, uint8_t* data, int32_t length, uint32_t index, uint32_t ssrc)
+{
+    if (ctx->nullCipher)
+        return;
+    if (ctx->ctr != NULL && ctx->ctr->ready) {
+        ctrXor(ctx->ctr, ssrc, index, data, length);
+        return;
+    }
+    ctx->srtcp->srtcpEncrypt(data, length, index, ssrc);
+}
+
+/* Compute the SRTP tag of data and ROC and store it at tag */
+static inline void
+srtpAuthenticate(ZsrtpContext* ctx, const uint8_t* data, int32_t length, uint32_t roc, uint8_t* tag)
+{
+    CryptoContext* pcc = ctx->srtp;
+
+    if (ctx->hmac != NULL && ctx->hmac->ready) {
+        uint32_t digest[5];
+
+        hmacSha1(ctx->hmac, data, length, roc, digest);
+        hmacStoreTag(digest, tag, pcc->getTagLength());
+        return;
+    }
+    pcc->srtpAuthenticate(const_cast<uint8_t*>(data), length, roc, tag);
+}
+
+/* Check the SRTP tag of data and ROC, constant-time */
+static inline bool
+srtpCheckTag(ZsrtpContext* ctx, const uint8_t* data, int32_t length, uint32_t roc, const uint8_t* tag)
+{
+    CryptoContext* pcc = ctx->srtp;
 
+    if (ctx->hmac != NULL && ctx->hmac->ready) {
+        uint32_t digest[5];
+
+        hmacSha1(ctx->hmac, data, length, roc, digest);
+        return hmacCheckTag(digest, tag, pcc->getTagLength());
+    }
+    uint8_t mac[32];           /* Skein MACs are up to 32 bytes */
+    pcc->srtpAuthenticate(const_cast<uint8_t*>(data), length, roc, mac);
+    return tagEqual(tag, mac, pcc->getTagLength());
+}
+
+/* Compute the SRTCP tag of data and the E flag/index word and store it at tag */
+static inline void
+srtcpAuthenticate(ZsrtpContextCtrl* ctx, const uint8_t* data, int32_t length, uint32_t encIndex, uint8_t* tag)
+{
+    CryptoContextCtrl* pcc = ctx->srtcp;
+
+    if (ctx->hmac != NULL && ctx->hmac->ready) {
+        uint32_t digest[5];
+
+        hmacSha1(ctx->hmac, data, length, encIndex, digest);
+        hmacStoreTag(digest, tag, pcc->getTagLength());
+        return;
+    }
+    pcc->srtcpAuthenticate(const_cast<uint8_t*>(data), length, encIndex, tag);
+}
+
+/* Check the SRTCP tag of data and the E flag/index word, constant-time */
+static inline bool
+srtcpCheckTag(ZsrtpContextCtrl* ctx, const uint8_t* data, int32_t length, uint32_t encIndex, const uint8_t* tag)
+{
+    CryptoContextCtrl* pcc = ctx->srtcp;
+
+    if (ctx->hmac != NULL && ctx->hmac->ready) {
+        uint32_t digest[5];
+
+        hmacSha1(ctx->hmac, data, length, encIndex, digest);
+        return hmacCheckTag(digest, tag, pcc->getTagLength());
+    }
+    uint8_t mac[32];           /* Skein MACs are up to 32 bytes */
+    pcc->srtcpAuthenticate(const_cast<uint8_t*>(data), length, encIndex, mac);
+    return tagEqual(tag, mac, pcc->getTagLength());
+}
+
+int32_t zsrtp_setFastHmac(int32_t enable)
+{
+    int32_t old = fastHmac;
+
+    fastHmac = enable ? 1 : 0;
+    return old;
+}
+
+int32_t zsrtp_setFastCipher(int32_t enable)
+{
+    int32_t old = fastCipher;
+
+    fastCipher = enable ? 1 : 0;
+    return old;
+}
+
+/*
+ * The wrapper structures, HMAC, AES-CM and AES-GCM states come from the
+ * GLib slice allocator. It serves fixed size blocks from per-thread
+ * magazines of a process wide slab, thus the many small contexts of a node
+ * with thousands of SSRCs neither fragment the heap nor take a malloc lock.
+ * libzrtpcpp allocates the CryptoContext itself.
+ */
 ZsrtpContext* zsrtp_CreateWrapper(uint32_t ssrc, int32_t roc,
                                   int64_t  keyDerivRate,
                                   const  int32_t ealg,
@@ -41,11 +1253,46 @@ ZsrtpContext* zsrtp_CreateWrapper(uint32_t ssrc, int32_t roc,
                                   int32_t  skeyl,
                                   int32_t  tagLength)
 {
-    ZsrtpContext* zc = new ZsrtpContext;
-    zc->srtp = new CryptoContext(ssrc, roc, keyDerivRate, ealg, aalg,
-                                 masterKey, masterKeyLength, masterSalt,
-                                 masterSaltLength, ekeyl, akeyl, skeyl,
-                                 tagLength);
+    ZsrtpAead* aead = NULL;
+
+    if (ealg == SrtpEncryptionAESGCM) {
+#ifdef ZSRTP_HAVE_AEAD
+        aead = aeadCreate(masterKey, masterKeyLength, masterSalt, masterSaltLength);
+#endif
+        if (aead == NULL)
+            return NULL;
+    }
+    ZsrtpContext* zc = g_slice_new0(ZsrtpContext);
+    zc->aead = aead;
+    zc->hmac = NULL;
+    zc->ctr = NULL;
+    zc->meta = 0;
+    zc->metaFlags = 0;
+    if (ealg != SrtpEncryptionNull)
+        zc->metaFlags |= GST_ZRTP_SRTP_META_ENCRYPTED;
+    if (aead != NULL || aalg != SrtpAuthenticationNull)
+        zc->metaFlags |= GST_ZRTP_SRTP_META_AUTHENTICATED;
+    if (aead != NULL)
+        zc->srtp = new CryptoContext(ssrc, roc, keyDerivRate, SrtpEncryptionNull,
+                                     SrtpAuthenticationNull, masterKey, masterKeyLength,
+                                     masterSalt, masterSaltLength, 0, 0, 0, 0);
+    else
+        zc->srtp = new CryptoContext(ssrc, roc, keyDerivRate, ealg, aalg,
+                                     masterKey, masterKeyLength, masterSalt,
+                                     masterSaltLength, ekeyl, akeyl, skeyl,
+                                     tagLength);
+    if (aead == NULL) {
+        zc->hmac = hmacCreate(ealg, aalg, keyDerivRate, masterKey, masterKeyLength,
+                              masterSalt, masterSaltLength, akeyl, tagLength);
+        zc->ctr = ctrCreate(ealg, keyDerivRate, masterKey, masterKeyLength,
+                            masterSalt, masterSaltLength, ekeyl, skeyl);
+    }
+    zc->replay = replayCreate(ZSRTP_DEFAULT_REPLAY_WINDOW, roc);
+    zc->nullCipher = aead == NULL && ealg == SrtpEncryptionNull;
+    if (zc->nullCipher && aalg != SrtpAuthenticationNull && zc->hmac == NULL) {
+        zsrtp_DestroyWrapper(zc);
+        return NULL;
+    }
     return zc;
 }
 
@@ -57,45 +1304,351 @@ void zsrtp_DestroyWrapper (ZsrtpContext* ctx)
 
     delete ctx->srtp;
     ctx->srtp = NULL;
+    hmacDestroy(ctx->hmac);
+    ctrDestroy(ctx->ctr);
+    replayDestroy(ctx->replay);
+
+#ifdef ZSRTP_HAVE_AEAD
+    aeadDestroy(ctx->aead);
+#endif
+    g_slice_free(ZsrtpContext, ctx);
+}
+
+int32_t zsrtp_setReplayWindow(ZsrtpContext* ctx, int32_t size)
+{
+    if (size < ZSRTP_DEFAULT_REPLAY_WINDOW || size > ZSRTP_MAX_REPLAY_WINDOW)
+        return 0;
 
-    delete ctx;
+    uint32_t roc = (uint32_t)(ctx->replay->top >> 16);
+    replayDestroy(ctx->replay);
+    ctx->replay = replayCreate(size, roc);
+    return 1;
 }
 
 #if GST_CHECK_VERSION(1,0,0)
-static void
-resize_buffer(GstBuffer *buffer, gsize len)
+/*
+ * SRTP fast path: map the buffer once and parse the RTP header (CSRC count,
+ * extension, sequence number, SSRC) directly from the mapped data instead of
+ * mapping it again as GstRTPBuffer. The padding bit stays as is, SRTP
+ * encrypts the padding as part of the payload.
+ *
+ * The single packet and the batch functions share the steps before and
+ * after the authentication, a SrtpPacket keeps the state of one packet in
+ * between.
+ */
+struct SrtpPacket {
+    GstMapInfo map;
+    int32_t  length;            /* RTP packet length, without tag */
+    int32_t  headerLength;
+    uint16_t seqnum;
+    uint32_t ssrc;
+    uint64_t index;             /* SRTP index, ROC of the packet in the upper bits */
+};
+
+/*
+ * Resize and map the buffer, encrypt the payload and update the ROC. Returns
+ * 1 with the buffer mapped, 0 if the buffer is not a RTP packet.
+ */
+static int32_t
+protectBegin(ZsrtpContext* ctx, GstBuffer* gstBuf, SrtpPacket* pkt)
 {
-    gsize size, maxsize, offset;
+    CryptoContext* pcc = ctx->srtp;
 
-    size = gst_buffer_get_sizes(buffer, &offset, &maxsize);
-    g_return_if_fail(len > size);
+    /* Need original length of original RTP packet */
+    gint32 length = gst_buffer_get_size(gstBuf);
+    gint32 tagLength = pcc->getTagLength();
 
-    if (len < maxsize) {
-        gst_buffer_resize(buffer, offset, len);
-    } else {
-        GstMemory *mem = gst_allocator_alloc (NULL, len - size, NULL);
-        gst_buffer_append_memory(buffer, mem);
+    /* SRTP stores authentication after the RTP data */
+    if (tagLength > 0)
+        resize_buffer(gstBuf, length + tagLength);
+
+    if (!gst_buffer_map(gstBuf, &pkt->map, (GstMapFlags) GST_MAP_READWRITE)) {
+        gst_buffer_set_size(gstBuf, length);
+        return 0;
+    }
+    guint8* data = pkt->map.data;
+
+    int32_t headerLength = rtpHeaderLength(data, length);
+    if (headerLength == 0) {
+        gst_buffer_unmap(gstBuf, &pkt->map);
+        gst_buffer_set_size(gstBuf, length);
+        return 0;
     }
+    uint16_t seqnum = (data[2] << 8) | data[3];
+    uint32_t ssrc = g_ntohl(*(reinterpret_cast<guint32*>(data + 8)));
+    uint64_t index = ((uint64_t)pcc->getRoc() << 16) | (uint64_t)seqnum;
+
+    /* Encrypt the payload including all padding - padding is also encrypted */
+    srtpCrypt(ctx, data, data + headerLength, length - headerLength, index, ssrc);
+
+    /* Update the ROC if necessary, the tag uses the ROC of the index */
+    if (seqnum == 0xFFFF ) {
+        pcc->setRoc(pcc->getRoc() + 1);
+    }
+    pkt->length = length;
+    pkt->headerLength = headerLength;
+    pkt->seqnum = seqnum;
+    pkt->ssrc = ssrc;
+    pkt->index = index;
+    return 1;
 }
-#endif
 
 gint32 zsrtp_protect(ZsrtpContext* ctx, GstBuffer* gstBuf)
 {
     CryptoContext* pcc = ctx->srtp;
-#if GST_CHECK_VERSION(1,0,0)
-    GstMapInfo mapInfo;
-    GstRTPBuffer rtp = {NULL, };
-    GstRTPBuffer *rtpBuf = &rtp;
+#ifdef ZSRTP_HAVE_AEAD
+    if (ctx->aead != NULL)
+        return aeadProtect(ctx, gstBuf);
+#endif
+    SrtpPacket pkt;
+
+    if (pcc == NULL) {
+        return 0;
+    }
+    if (!protectBegin(ctx, gstBuf, &pkt))
+        return 0;
+
+    // NO MKI support yet - here we assume MKI is zero. To build in MKI
+    // take MKI length into account when storing the authentication tag.
+
+    /* Compute MAC and store at end of RTP packet data */
+    guint8* data = pkt.map.data;
+    srtpAuthenticate(ctx, data, pkt.length, (uint32_t)(pkt.index >> 16), data + pkt.length);
+
+    gst_buffer_unmap(gstBuf, &pkt.map);
+    attachMeta(ctx, gstBuf, pkt.ssrc, pkt.seqnum, pkt.headerLength, pkt.index);
+    return 1;
+}
+
+/*
+ * Map the buffer, parse the header, check for replay and guess the index.
+ * Returns 1 with the buffer mapped, -1 if the buffer is not a SRTP packet
+ * and -2 if the replay check failed.
+ */
+static int32_t
+unprotectBegin(ZsrtpContext* ctx, GstBuffer* gstBuf, SrtpPacket* pkt)
+{
+    CryptoContext* pcc = ctx->srtp;
+
+    if (!gst_buffer_map(gstBuf, &pkt->map, (GstMapFlags) GST_MAP_READWRITE))
+        return -1;
+
+    guint8* data = pkt->map.data;
 
-    gint32  length = gst_buffer_get_size(gstBuf);
+    /*
+     * The SRTP MKI and authentication data is always at the end of a
+     * packet, the RTP packet ends at srtpDataIndex. In case of SRTP the
+     * padding length field is also encrypted, thus the payload length is
+     * the RTP packet length minus header length.
+     */
+    int32_t srtpDataIndex = (int32_t)pkt->map.size - (pcc->getTagLength() + pcc->getMkiLength());
+    int32_t headerLength = srtpDataIndex > 0 ? rtpHeaderLength(data, srtpDataIndex) : 0;
+    if (headerLength == 0) {
+        gst_buffer_unmap(gstBuf, &pkt->map);
+        return -1;
+    }
+
+    /* Need sequence number for Replay control and crypto index */
+    uint16_t seqnum = (data[2] << 8) | data[3];
+    if (!replayCheck(ctx->replay, seqnum, &pkt->index)) {
+        gst_buffer_unmap(gstBuf, &pkt->map);
+        return -2;
+    }
+    pkt->length = srtpDataIndex;
+    pkt->headerLength = headerLength;
+    pkt->seqnum = seqnum;
+    pkt->ssrc = g_ntohl(*(reinterpret_cast<guint32*>(data + 8)));
+    return 1;
+}
+
+/* Decrypt an authenticated packet, update the context, unmap and trim the buffer */
+static int32_t
+unprotectFinish(ZsrtpContext* ctx, GstBuffer* gstBuf, SrtpPacket* pkt)
+{
+    guint8* data = pkt->map.data;
+
+    /* Decrypt the content */
+    srtpCrypt(ctx, data, data + pkt->headerLength, pkt->length - pkt->headerLength, pkt->index, pkt->ssrc);
+
+    /* Update the replay window */
+    replayUpdate(ctx->replay, pkt->index);
+
+    gst_buffer_unmap(gstBuf, &pkt->map);
+
+    /* Remove MKI and authentication tag */
+    gst_buffer_resize(gstBuf, 0, pkt->length);
+    attachMeta(ctx, gstBuf, pkt->ssrc, pkt->seqnum, pkt->headerLength, pkt->index);
+    return 1;
+}
+
+int32_t zsrtp_unprotect(ZsrtpContext* ctx, GstBuffer* gstBuf)
+{
+    CryptoContext* pcc = ctx->srtp;
+#ifdef ZSRTP_HAVE_AEAD
+    if (ctx->aead != NULL)
+        return aeadUnprotect(ctx, gstBuf);
+#endif
+    SrtpPacket pkt;
+    int32_t rc;
+
+    if (pcc == NULL) {
+        return 0;
+    }
+    if ((rc = unprotectBegin(ctx, gstBuf, &pkt)) != 1)
+        return rc;
+
+    /* Compute MAC over SRTP buffer and compare with tag in SRTP packet */
+    guint8* data = pkt.map.data;
+    if (!srtpCheckTag(ctx, data, pkt.length, (uint32_t)(pkt.index >> 16),
+                      data + pkt.length + pcc->getMkiLength())) {
+        gst_buffer_unmap(gstBuf, &pkt.map);
+        return -1;
+    }
+    return unprotectFinish(ctx, gstBuf, &pkt);
+}
+
+/*
+ * Batches: the packets of a chunk go through the steps before the
+ * authentication one after the other, in order, then the multi-buffer
+ * kernel hashes the whole chunk. For received packets the replay check
+ * runs again before the decryption, the authentication step above did not
+ * update the replay window and a chunk may contain duplicates. The index
+ * is guessed again as well, a ROC wrap inside the chunk may change it.
+ */
+#define SRTP_BATCH_CHUNK 16
+
+static inline bool
+batchCapable(ZsrtpContext* ctx)
+{
+    return ctx->aead == NULL && ctx->hmac != NULL && ctx->hmac->ready;
+}
+
+int32_t zsrtp_protectBatch(ZsrtpContext* ctx, GstBuffer** buffers, int32_t count, int32_t* results)
+{
+    SrtpPacket pkts[SRTP_BATCH_CHUNK];
+    HmacJob jobs[SRTP_BATCH_CHUNK];
+    int32_t slot[SRTP_BATCH_CHUNK];
+    int32_t done = 0;
+
+    if (ctx->srtp == NULL) {
+        for (int32_t i = 0; i < count; i++)
+            results[i] = 0;
+        return 0;
+    }
+    if (!batchCapable(ctx)) {
+        for (int32_t i = 0; i < count; i++)
+            done += (results[i] = zsrtp_protect(ctx, buffers[i])) == 1;
+        return done;
+    }
+    int32_t tagLength = ctx->srtp->getTagLength();
+
+    for (int32_t first = 0; first < count; first += SRTP_BATCH_CHUNK) {
+        int32_t n = MIN(SRTP_BATCH_CHUNK, count - first);
+        int32_t jobCount = 0;
+
+        for (int32_t i = 0; i < n; i++) {
+            SrtpPacket* pkt = &pkts[jobCount];
+
+            results[first + i] = protectBegin(ctx, buffers[first + i], pkt);
+            if (results[first + i] != 1)
+                continue;
+            jobs[jobCount].data = pkt->map.data;
+            jobs[jobCount].length = pkt->length;
+            jobs[jobCount].trailer = (uint32_t)(pkt->index >> 16);
+            slot[jobCount++] = first + i;
+        }
+        hmacSha1Batch(ctx->hmac, jobs, jobCount);
+
+        for (int32_t j = 0; j < jobCount; j++) {
+            hmacStoreTag(jobs[j].digest, pkts[j].map.data + pkts[j].length, tagLength);
+            gst_buffer_unmap(buffers[slot[j]], &pkts[j].map);
+            attachMeta(ctx, buffers[slot[j]], pkts[j].ssrc, pkts[j].seqnum,
+                       pkts[j].headerLength, pkts[j].index);
+        }
+        done += jobCount;
+    }
+    return done;
+}
+
+int32_t zsrtp_unprotectBatch(ZsrtpContext* ctx, GstBuffer** buffers, int32_t count, int32_t* results)
+{
+    SrtpPacket pkts[SRTP_BATCH_CHUNK];
+    HmacJob jobs[SRTP_BATCH_CHUNK];
+    int32_t slot[SRTP_BATCH_CHUNK];
+    int32_t done = 0;
+
+    if (ctx->srtp == NULL) {
+        for (int32_t i = 0; i < count; i++)
+            results[i] = 0;
+        return 0;
+    }
+    if (!batchCapable(ctx)) {
+        for (int32_t i = 0; i < count; i++)
+            done += (results[i] = zsrtp_unprotect(ctx, buffers[i])) == 1;
+        return done;
+    }
+    CryptoContext* pcc = ctx->srtp;
+    int32_t tagLength = pcc->getTagLength();
+    int32_t mkiLength = pcc->getMkiLength();
+
+    for (int32_t first = 0; first < count; first += SRTP_BATCH_CHUNK) {
+        int32_t n = MIN(SRTP_BATCH_CHUNK, count - first);
+        int32_t jobCount = 0;
+
+        for (int32_t i = 0; i < n; i++) {
+            SrtpPacket* pkt = &pkts[jobCount];
+
+            results[first + i] = unprotectBegin(ctx, buffers[first + i], pkt);
+            if (results[first + i] != 1)
+                continue;
+            jobs[jobCount].data = pkt->map.data;
+            jobs[jobCount].length = pkt->length;
+            jobs[jobCount].trailer = (uint32_t)(pkt->index >> 16);
+            slot[jobCount++] = first + i;
+        }
+        hmacSha1Batch(ctx->hmac, jobs, jobCount);
+
+        for (int32_t j = 0; j < jobCount; j++) {
+            SrtpPacket* pkt = &pkts[j];
+            GstBuffer* gstBuf = buffers[slot[j]];
+            uint8_t* tag = pkt->map.data + pkt->length + mkiLength;
+            bool ok;
+
+            uint64_t index;
+            if (!replayCheck(ctx->replay, pkt->seqnum, &index)) {
+                gst_buffer_unmap(gstBuf, &pkt->map);
+                results[slot[j]] = -2;
+                continue;
+            }
+            if (index == pkt->index) {
+                ok = hmacCheckTag(jobs[j].digest, tag, tagLength);
+            } else {
+                pkt->index = index;
+                ok = srtpCheckTag(ctx, pkt->map.data, pkt->length, (uint32_t)(index >> 16), tag);
+            }
+            if (!ok) {
+                gst_buffer_unmap(gstBuf, &pkt->map);
+                results[slot[j]] = -1;
+                continue;
+            }
+            done += results[slot[j]] = unprotectFinish(ctx, gstBuf, pkt);
+        }
+    }
+    return done;
+}
 
-    gst_rtp_buffer_map(gstBuf, GST_MAP_READ, &rtp);
 #else
+gint32 zsrtp_protect(ZsrtpContext* ctx, GstBuffer* gstBuf)
+{
+    CryptoContext* pcc = ctx->srtp;
+#ifdef ZSRTP_HAVE_AEAD
+    if (ctx->aead != NULL)
+        return aeadProtect(ctx, gstBuf);
+#endif
     GstBuffer *rtpBuf = gstBuf;
 
     /* Need original length of original RTP packet */
     gint32  length = GST_BUFFER_SIZE(gstBuf);
-#endif
 
     int32_t payloadlen;
     uint16_t seqnum;
@@ -120,63 +1673,41 @@ gint32 zsrtp_protect(ZsrtpContext* ctx, GstBuffer* gstBuf)
      * */
     gint newLength = length + pcc->getTagLength();
 
-#if GST_CHECK_VERSION(1,0,0)
-    gst_rtp_buffer_unmap(&rtp);
-
-    resize_buffer(gstBuf, newLength);
-
-    g_warn_if_fail(gst_buffer_map(gstBuf, &mapInfo, (GstMapFlags) GST_MAP_READWRITE));
-    gst_rtp_buffer_map(gstBuf, (GstMapFlags) GST_MAP_READWRITE, &rtp);
-    guint8* data = mapInfo.data;
-#else
     guint8* data = reinterpret_cast<uint8_t*>(g_realloc (GST_BUFFER_MALLOCDATA(gstBuf), newLength));
     GST_BUFFER_MALLOCDATA(gstBuf) = data;
     GST_BUFFER_DATA(gstBuf) = data;
     GST_BUFFER_SIZE(gstBuf) = newLength;
-#endif
 
     /* Encrypt the packet */
     uint8_t* payl = reinterpret_cast<uint8_t*>(gst_rtp_buffer_get_payload(rtpBuf));
-    pcc->srtpEncrypt(data, payl, payloadlen, index, ssrc);
+    srtpCrypt(ctx, data, payl, payloadlen, index, ssrc);
 
     // NO MKI support yet - here we assume MKI is zero. To build in MKI
     // take MKI length into account when storing the authentication tag.
 
     /* Compute MAC and store at end of RTP packet data */
-    pcc->srtpAuthenticate(data, length, pcc->getRoc(), data+length);
+    srtpAuthenticate(ctx, data, length, pcc->getRoc(), data+length);
 
 
     /* Update the ROC if necessary */
     if (seqnum == 0xFFFF ) {
         pcc->setRoc(pcc->getRoc() + 1);
     }
-#if GST_CHECK_VERSION(1,0,0)
-    gst_rtp_buffer_unmap(&rtp);
-    gst_buffer_unmap(gstBuf, &mapInfo);
-#endif
     return 1;
 }
 
 int32_t zsrtp_unprotect(ZsrtpContext* ctx, GstBuffer* gstBuf)
 {
     CryptoContext* pcc = ctx->srtp;
-#if GST_CHECK_VERSION(1,0,0)
-    GstMapInfo mapInfo;
-    GstRTPBuffer rtp = { NULL, };
-    GstRTPBuffer *rtpBuf = &rtp;
-
-    g_warn_if_fail(gst_buffer_map(gstBuf, &mapInfo, (GstMapFlags) GST_MAP_READWRITE));
-    gst_rtp_buffer_map(gstBuf, (GstMapFlags) GST_MAP_READWRITE, &rtp);
-
-    gint32  length = mapInfo.size;
-    guint8  *bufdata = mapInfo.data;
-#else
+#ifdef ZSRTP_HAVE_AEAD
+    if (ctx->aead != NULL)
+        return aeadUnprotect(ctx, gstBuf);
+#endif
     GstBuffer *rtpBuf = gstBuf;
 
     /* Need length of original SRTP packet */
     gint32  length = GST_BUFFER_SIZE(gstBuf);
     guint8  *bufdata = GST_BUFFER_DATA(gstBuf);
-#endif
 
     /* In case of SRTP the padding length field is also encrypted, thus
      * it gives a wrong length. Compute payload length without padding:
@@ -214,51 +1745,82 @@ int32_t zsrtp_unprotect(ZsrtpContext* ctx, GstBuffer* gstBuf)
 
     /* Need sequence number for Replay control and crypto index */
     seqnum = gst_rtp_buffer_get_seq(rtpBuf);
-    if (!pcc->checkReplay(seqnum)) {
+    uint64_t guessedIndex;
+    if (!replayCheck(ctx->replay, seqnum, &guessedIndex)) {
         return -2;
     }
-    /* Guess the index */
-    uint64_t guessedIndex = pcc->guessIndex(seqnum);
 
     uint32_t guessedRoc = guessedIndex >> 16;
-    uint8_t  mac[20];
 
     /* Compute MAC over SRTP buffer and compare with tag in SRTP packet */
-    pcc->srtpAuthenticate(bufdata, length, guessedRoc, mac);
-    if (memcmp(tag, mac, pcc->getTagLength()) != 0) {
+    if (!srtpCheckTag(ctx, bufdata, length, guessedRoc, tag)) {
         return -1;
     }
 
     /* Decrypt the content */
     ssrc = gst_rtp_buffer_get_ssrc(rtpBuf);
     uint8_t* payl = reinterpret_cast<uint8_t*>(gst_rtp_buffer_get_payload(rtpBuf));
-    pcc->srtpEncrypt(bufdata, payl, payloadlen, guessedIndex, ssrc);
-#if GST_CHECK_VERSION(1,0,0)
-    mapInfo.size = srtpDataIndex;
-#else
+    srtpCrypt(ctx, bufdata, payl, payloadlen, guessedIndex, ssrc);
     GST_BUFFER_SIZE(gstBuf) = srtpDataIndex;
-#endif
 
-    /* Update the Crypto-context */
-    pcc->update(seqnum);
+    /* Update the replay window */
+    replayUpdate(ctx->replay, guessedIndex);
 
-#if GST_CHECK_VERSION(1,0,0)
-    gst_rtp_buffer_unmap(&rtp);
-    gst_buffer_unmap(gstBuf, &mapInfo);
-#endif
     return 1;
 }
+#endif
 
-void zsrtp_newCryptoContextForSSRC(ZsrtpContext* ctx, uint32_t ssrc,
-                                   int32_t roc, int64_t keyDerivRate)
+ZsrtpContext* zsrtp_newCryptoContextForSSRC(ZsrtpContext* ctx, uint32_t ssrc,
+                                             int32_t roc, int64_t keyDerivRate)
 {
-    CryptoContext* newCrypto = ctx->srtp->newCryptoContextForSSRC(ssrc, 0, 0L);
-    ctx->srtp = newCrypto;
+    ZsrtpAead* aead = NULL;
+
+    /* The NULL cipher authenticates with the wrapper HMAC only */
+    if (ctx->nullCipher && keyDerivRate != 0)
+        return NULL;
+
+#ifdef ZSRTP_HAVE_AEAD
+    if (ctx->aead != NULL) {
+        aead = aeadCreate(ctx->aead->masterKey, ctx->aead->masterKeyLength,
+                          ctx->aead->masterSalt, sizeof(ctx->aead->masterSalt));
+        if (aead == NULL)
+            return NULL;
+    }
+#endif
+    CryptoContext* newCrypto = ctx->srtp->newCryptoContextForSSRC(ssrc, roc, keyDerivRate);
+    if (newCrypto == NULL) {
+#ifdef ZSRTP_HAVE_AEAD
+        aeadDestroy(aead);
+#endif
+        return NULL;
+    }
+    ZsrtpContext* zc = g_slice_new0(ZsrtpContext);
+    zc->srtp = newCrypto;
+    zc->userData = ctx->userData;
+    zc->aead = aead;
+    zc->hmac = keyDerivRate == 0 ? hmacFork(ctx->hmac) : NULL;
+    zc->ctr = keyDerivRate == 0 ? ctrFork(ctx->ctr) : NULL;
+    zc->replay = replayCreate(ctx->replay->words * 64, roc);
+    zc->nullCipher = ctx->nullCipher;
+    zc->meta = ctx->meta;
+    zc->metaFlags = ctx->metaFlags;
+    return zc;
 }
 
 void zsrtp_deriveSrtpKeys(ZsrtpContext* ctx, uint64_t index)
 {
-    ctx->srtp->deriveSrtpKeys(index);
+#ifdef ZSRTP_HAVE_AEAD
+    if (ctx->aead != NULL) {
+        aeadDeriveKeys(ctx->aead, LABEL_SRTP_KEY, LABEL_SRTP_SALT);
+        return;
+    }
+#endif
+    if (!ctx->nullCipher)
+        ctx->srtp->deriveSrtpKeys(index);
+    if (ctx->hmac != NULL)
+        hmacDeriveKeys(ctx->hmac, LABEL_SRTP_AUTH);
+    if (ctx->ctr != NULL)
+        ctrDeriveKeys(ctx->ctr, LABEL_SRTP_KEY, LABEL_SRTP_SALT);
 }
 
 
@@ -277,11 +1839,38 @@ ZsrtpContextCtrl* zsrtp_CreateWrapperCtrl( uint32_t ssrc,
                                            int32_t  skeyl,
                                            int32_t  tagLength )
 {
-    ZsrtpContextCtrl* zc = new ZsrtpContextCtrl;
-    zc->srtcp = new CryptoContextCtrl(ssrc, ealg, aalg, masterKey, masterKeyLength, masterSalt,
-                                      masterSaltLength, ekeyl, akeyl, skeyl, tagLength );
+    ZsrtpAead* aead = NULL;
 
+    if (ealg == SrtpEncryptionAESGCM) {
+#ifdef ZSRTP_HAVE_AEAD
+        aead = aeadCreate(masterKey, masterKeyLength, masterSalt, masterSaltLength);
+#endif
+        if (aead == NULL)
+            return NULL;
+    }
+    ZsrtpContextCtrl* zc = g_slice_new0(ZsrtpContextCtrl);
+    zc->aead = aead;
+    zc->hmac = NULL;
+    zc->ctr = NULL;
+    if (aead != NULL)
+        zc->srtcp = new CryptoContextCtrl(ssrc, SrtpEncryptionNull, SrtpAuthenticationNull,
+                                          masterKey, masterKeyLength, masterSalt,
+                                          masterSaltLength, 0, 0, 0, 0);
+    else
+        zc->srtcp = new CryptoContextCtrl(ssrc, ealg, aalg, masterKey, masterKeyLength, masterSalt,
+                                          masterSaltLength, ekeyl, akeyl, skeyl, tagLength );
+    if (aead == NULL) {
+        zc->hmac = hmacCreate(ealg, aalg, 0, masterKey, masterKeyLength,
+                              masterSalt, masterSaltLength, akeyl, tagLength);
+        zc->ctr = ctrCreate(ealg, 0, masterKey, masterKeyLength,
+                            masterSalt, masterSaltLength, ekeyl, skeyl);
+    }
     zc->srtcpIndex = 0;
+    zc->nullCipher = aead == NULL && ealg == SrtpEncryptionNull;
+    if (zc->nullCipher && aalg != SrtpAuthenticationNull && zc->hmac == NULL) {
+        zsrtp_DestroyWrapperCtrl(zc);
+        return NULL;
+    }
     return zc;
 }
 
@@ -293,8 +1882,13 @@ void zsrtp_DestroyWrapperCtrl (ZsrtpContextCtrl* ctx)
 
     delete ctx->srtcp;
     ctx->srtcp = NULL;
+    hmacDestroy(ctx->hmac);
+    ctrDestroy(ctx->ctr);
 
-    delete ctx;
+#ifdef ZSRTP_HAVE_AEAD
+    aeadDestroy(ctx->aead);
+#endif
+    g_slice_free(ZsrtpContextCtrl, ctx);
 }
 
 int32_t zsrtp_protectCtrl(ZsrtpContextCtrl* ctx, GstBuffer* gstBuf)
@@ -307,6 +1901,10 @@ int32_t zsrtp_protectCtrl(ZsrtpContextCtrl* ctx, GstBuffer* gstBuf)
     if (pcc == NULL) {
         return 0;
     }
+#ifdef ZSRTP_HAVE_AEAD
+    if (ctx->aead != NULL)
+        return aeadProtectCtrl(ctx, gstBuf);
+#endif
 
 #if GST_CHECK_VERSION(1,0,0)
     gint32 length = gst_buffer_get_size(gstBuf);
@@ -338,9 +1936,11 @@ int32_t zsrtp_protectCtrl(ZsrtpContextCtrl* ctx, GstBuffer* gstBuf)
     ssrc = g_ntohl(ssrc);
 
     /* Encrypt the packet */
-    pcc->srtcpEncrypt(data + 8, length - 8, ctx->srtcpIndex, ssrc);
+    srtcpCrypt(ctx, data + 8, length - 8, ctx->srtcpIndex, ssrc);
 
-    uint32_t encIndex = ctx->srtcpIndex | 0x80000000;  // set the E flag
+    uint32_t encIndex = ctx->srtcpIndex;
+    if (!ctx->nullCipher)
+        encIndex |= 0x80000000;                         // set the E flag
 
     // Fill SRTCP index as last word
     uint32_t* ip = reinterpret_cast<uint32_t*>(data+length);
@@ -350,8 +1950,7 @@ int32_t zsrtp_protectCtrl(ZsrtpContextCtrl* ctx, GstBuffer* gstBuf)
     // take MKI length into account when storing the authentication tag.
 
     // Compute MAC and store in packet after the SRTCP index field
-    pcc->srtcpAuthenticate(data, length, encIndex,
-                           data + length + sizeof(uint32_t));
+    srtcpAuthenticate(ctx, data, length, encIndex, data + length + sizeof(uint32_t));
 
     ctx->srtcpIndex++;
     ctx->srtcpIndex &= ~0x80000000;       // clear possible overflow
@@ -372,9 +1971,14 @@ int32_t zsrtp_unprotectCtrl(ZsrtpContextCtrl* ctx, GstBuffer* gstBuf)
     if (pcc == NULL) {
         return 0;
     }
+#ifdef ZSRTP_HAVE_AEAD
+    if (ctx->aead != NULL)
+        return aeadUnprotectCtrl(ctx, gstBuf);
+#endif
 
 #if GST_CHECK_VERSION(1,0,0)
-    g_warn_if_fail(gst_buffer_map(gstBuf, &mapInfo, (GstMapFlags) GST_MAP_READWRITE));
+    if (!gst_buffer_map(gstBuf, &mapInfo, (GstMapFlags) GST_MAP_READWRITE))
+        return -1;
     gint32 length = mapInfo.size;
     guint8 *bufdata = mapInfo.data;
 #else
@@ -385,6 +1989,12 @@ int32_t zsrtp_unprotectCtrl(ZsrtpContextCtrl* ctx, GstBuffer* gstBuf)
 
     // Compute the total length of the payload
     int32_t payloadLen = length - (pcc->getTagLength() + pcc->getMkiLength() + 4);
+    if (payloadLen < 8) {
+#if GST_CHECK_VERSION(1,0,0)
+        gst_buffer_unmap(gstBuf, &mapInfo);
+#endif
+        return -1;
+    }
 
     // point to the SRTCP index field just after the real payload
     const uint32_t* index = reinterpret_cast<uint32_t*>(bufdata + payloadLen);
@@ -393,17 +2003,20 @@ int32_t zsrtp_unprotectCtrl(ZsrtpContextCtrl* ctx, GstBuffer* gstBuf)
     uint32_t remoteIndex = encIndex & ~0x80000000;    // index without Encryption flag
 
     if (!pcc->checkReplay(remoteIndex)) {
-       return -2;
+#if GST_CHECK_VERSION(1,0,0)
+        gst_buffer_unmap(gstBuf, &mapInfo);
+#endif
+        return -2;
     }
 
-    uint8_t mac[20];
-
     // Now get a pointer to the authentication tag field
     const uint8_t* tag = bufdata + (length - pcc->getTagLength());
 
     // Authenticate includes the index, but not MKI and not (obviously) the tag itself
-    pcc->srtcpAuthenticate(bufdata, payloadLen, encIndex, mac);
-    if (memcmp(tag, mac, pcc->getTagLength()) != 0) {
+    if (!srtcpCheckTag(ctx, bufdata, payloadLen, encIndex, tag)) {
+#if GST_CHECK_VERSION(1,0,0)
+        gst_buffer_unmap(gstBuf, &mapInfo);
+#endif
         return -1;
     }
     guint32 ssrc = *(reinterpret_cast<guint32*>(bufdata + 4)); // always SSRC of sender
@@ -411,32 +2024,65 @@ int32_t zsrtp_unprotectCtrl(ZsrtpContextCtrl* ctx, GstBuffer* gstBuf)
 
     // Decrypt the content, exclude the very first SRTCP header (fixed, 8 bytes)
     if (encIndex & 0x80000000)
-        pcc->srtcpEncrypt(bufdata + 8,
-                          payloadLen - 8, remoteIndex, ssrc);
+        srtcpCrypt(ctx, bufdata + 8, payloadLen - 8, remoteIndex, ssrc);
 
     // Update the Crypto-context
     pcc->update(remoteIndex);
-#if GST_CHECK_VERSION(1,0,0)
-    mapInfo.size = payloadLen;
-#else
-    GST_BUFFER_SIZE(gstBuf) = payloadLen;
-#endif
 
+    // Remove SRTCP index, MKI and authentication tag
 #if GST_CHECK_VERSION(1,0,0)
     gst_buffer_unmap(gstBuf, &mapInfo);
+    gst_buffer_resize(gstBuf, 0, payloadLen);
+#else
+    GST_BUFFER_SIZE(gstBuf) = payloadLen;
 #endif
     return 1;
 }
 
-void zsrtp_newCryptoContextForSSRCCtrl(ZsrtpContextCtrl* ctx, uint32_t ssrc)
+ZsrtpContextCtrl* zsrtp_newCryptoContextForSSRCCtrl(ZsrtpContextCtrl* ctx, uint32_t ssrc)
 {
+    ZsrtpAead* aead = NULL;
+
+#ifdef ZSRTP_HAVE_AEAD
+    if (ctx->aead != NULL) {
+        aead = aeadCreate(ctx->aead->masterKey, ctx->aead->masterKeyLength,
+                          ctx->aead->masterSalt, sizeof(ctx->aead->masterSalt));
+        if (aead == NULL)
+            return NULL;
+    }
+#endif
     CryptoContextCtrl* newCrypto = ctx->srtcp->newCryptoContextForSSRC(ssrc);
-    ctx->srtcp = newCrypto;
+    if (newCrypto == NULL) {
+#ifdef ZSRTP_HAVE_AEAD
+        aeadDestroy(aead);
+#endif
+        return NULL;
+    }
+    ZsrtpContextCtrl* zc = g_slice_new0(ZsrtpContextCtrl);
+    zc->srtcp = newCrypto;
+    zc->userData = ctx->userData;
+    zc->srtcpIndex = 0;
+    zc->aead = aead;
+    zc->hmac = hmacFork(ctx->hmac);
+    zc->ctr = ctrFork(ctx->ctr);
+    zc->nullCipher = ctx->nullCipher;
+    return zc;
 }
 
 void zsrtp_deriveSrtpKeysCtrl(ZsrtpContextCtrl* ctx)
 {
-    ctx->srtcp->deriveSrtcpKeys();
+#ifdef ZSRTP_HAVE_AEAD
+    if (ctx->aead != NULL) {
+        aeadDeriveKeys(ctx->aead, LABEL_SRTCP_KEY, LABEL_SRTCP_SALT);
+        return;
+    }
+#endif
+    if (!ctx->nullCipher)
+        ctx->srtcp->deriveSrtcpKeys();
+    if (ctx->hmac != NULL)
+        hmacDeriveKeys(ctx->hmac, LABEL_SRTCP_AUTH);
+    if (ctx->ctr != NULL)
+        ctrDeriveKeys(ctx->ctr, LABEL_SRTCP_KEY, LABEL_SRTCP_SALT);
 }
 
 
@@ -44,19 +44,105 @@
 #define SrtpEncryptionTWOCM   3
 #define SrtpEncryptionTWOF8   4
 
+/*
+ * AEAD transforms are implemented by this wrapper and not by CryptoContext.
+ * AES-GCM according to RFC 7714 provides encryption and authentication in
+ * one pass, the authentication algorithm parameter is not used.
+ */
+#define SrtpEncryptionAESGCM  16
+
+#define ZSRTP_AEAD_TAG_LENGTH 16
+
+/*
+ * Maximum number of bytes that SRTP appends to a RTP packet and SRTCP appends
+ * to a RTCP packet. Elements that allocate buffers for SRTP protection should
+ * reserve this as tailroom, then SRTP can append its data in place.
+ */
+#define ZSRTP_MAX_TAG_LENGTH     16
+#define ZSRTP_MAX_MKI_LENGTH     0      /* No MKI support yet */
+#define ZSRTP_SRTCP_INDEX_LENGTH 4
+
+#define ZSRTP_MAX_SRTP_TAIL  (ZSRTP_MAX_TAG_LENGTH + ZSRTP_MAX_MKI_LENGTH)
+#define ZSRTP_MAX_SRTCP_TAIL (ZSRTP_MAX_TAG_LENGTH + ZSRTP_MAX_MKI_LENGTH + ZSRTP_SRTCP_INDEX_LENGTH)
+
+/*
+ * Size of the SRTP replay window in packets, see zsrtp_setReplayWindow().
+ * The wrapper rounds sizes up to a multiple of 64.
+ */
+#define ZSRTP_DEFAULT_REPLAY_WINDOW  64
+#define ZSRTP_MAX_REPLAY_WINDOW      4096
+
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
     typedef struct CryptoContext CryptoContext;
+    typedef struct ZsrtpAead ZsrtpAead;
+    typedef struct ZsrtpHmac ZsrtpHmac;
+    typedef struct ZsrtpCtr ZsrtpCtr;
+    typedef struct ZsrtpReplay ZsrtpReplay;
 
     typedef struct zsrtpContext
     {
         CryptoContext* srtp;
         void* userData;
+        ZsrtpAead* aead;        /* Not NULL if the AES-GCM transform is active */
+        ZsrtpHmac* hmac;        /* Not NULL if HMAC-SHA1 uses the precomputed state */
+        ZsrtpCtr* ctr;          /* Not NULL if AES-CM uses the AES instructions */
+        ZsrtpReplay* replay;    /* replay window and ROC estimation of received packets */
+        int32_t nullCipher;     /* 1: SrtpEncryptionNull, authentication only */
+        int32_t meta;           /* 1: attach a GstZrtpSrtpMeta to processed packets */
+        int32_t metaFlags;      /* GstZrtpSrtpMetaFlags of this context, set by the wrapper */
     } ZsrtpContext;
 
+    /**
+     * Check if the wrapper supports the AES-GCM AEAD transform.
+     *
+     * AES-GCM requires the openSSL crypto backend, the standalone crypto
+     * module does not implement it.
+     *
+     * @returns
+     *     1 if <code>SrtpEncryptionAESGCM</code> is available, 0 otherwise
+     */
+    int32_t zsrtp_hasAeadSupport(void);
+
+    /**
+     * Enable or disable the precomputed HMAC-SHA1 state.
+     *
+     * If enabled, the default, a SRTP or SRTCP wrapper with HMAC-SHA1
+     * authentication hashes the HMAC key pads once when it derives the
+     * keys and starts each packet from the saved state. The setting applies
+     * to wrappers created afterwards, forked wrappers inherit the mode of
+     * their template. Both modes compute the same tags.
+     *
+     * @param enable
+     *     1 to enable, 0 to use the CryptoContext authentication functions
+     *
+     * @returns
+     *     the previous setting
+     */
+    int32_t zsrtp_setFastHmac(int32_t enable);
+
+    /**
+     * Enable or disable the AES counter mode kernels.
+     *
+     * If enabled, the default, and the CPU has the AES-NI instructions or
+     * the ARMv8 crypto extensions, a SRTP or SRTCP wrapper with AES-CM
+     * encryption generates the keystream of 8 blocks per step with these
+     * instructions. Otherwise the CryptoContext encrypts with the AES
+     * implementation of the crypto module. The setting applies to wrappers
+     * created afterwards, forked wrappers inherit the mode of their
+     * template. Both modes produce the same packets.
+     *
+     * @param enable
+     *     1 to enable, 0 to use the CryptoContext encryption functions
+     *
+     * @returns
+     *     the previous setting
+     */
+    int32_t zsrtp_setFastCipher(int32_t enable);
+
     /**
      * Create a ZSRTP wrapper fir a SRTP cryptographic context.
      *
@@ -78,15 +164,20 @@ extern "C"
      *
      * @param ealg
      *    The encryption algorithm to use. Possible values are <code>
-     *    SrtpEncryptionNull, SrtpEncryptionAESCM, SrtpEncryptionAESF8
-     *    </code>. See chapter 4.1.1 for AESCM (Counter mode) and 4.1.2
-     *    for AES F8 mode.
+     *    SrtpEncryptionNull, SrtpEncryptionAESCM, SrtpEncryptionAESF8,
+     *    SrtpEncryptionAESGCM</code>. See chapter 4.1.1 for AESCM (Counter
+     *    mode) and 4.1.2 for AES F8 mode. SrtpEncryptionAESGCM selects the
+     *    AEAD transform of RFC 7714, refer to <code>zsrtp_hasAeadSupport</code>.
+     *    SrtpEncryptionNull leaves the payload in the clear, chapter 4.1.3,
+     *    and requires SrtpAuthenticationSha1Hmac with a key derivation rate
+     *    of zero or no authentication.
      *
      * @param aalg
      *    The authentication algorithm to use. Possible values are <code>
      *    SrtpEncryptionNull, SrtpAuthenticationSha1Hmac</code>. The only
      *    active algorithm here is SHA1 HMAC, a SHA1 based hashed message
-     *    authentication code as defined in RFC 2104.
+     *    authentication code as defined in RFC 2104. Not used if
+     *    <code>ealg</code> is SrtpEncryptionAESGCM.
      *
      * @param masterKey
      *    Pointer to the master key for this SRTP cryptographic context.
@@ -109,6 +200,8 @@ extern "C"
      *    AES as encryption algorithm. AES encrypts 16 byte blocks
      *    (independent of the key length). According to RFC3711 the standard
      *    value for the master salt length should be 112 bit (14 bytes).
+     *    AES-GCM uses a 96 bit (12 bytes) master salt, RFC 7714 chapter 12,
+     *    and takes the first 12 bytes of a longer salt.
      *
      * @param ekeyl
      *    The length in bytes of the session encryption key that SRTP shall
@@ -129,10 +222,12 @@ extern "C"
      *
      * @param tagLength
      *    The length is bytes of the authentication tag that SRTP appends
-     *    to the RTP packet. Refer to chapter 4.2. in the RFC 3711.
+     *    to the RTP packet. Refer to chapter 4.2. in the RFC 3711. AES-GCM
+     *    always uses a tag of <code>ZSRTP_AEAD_TAG_LENGTH</code> bytes.
      * 
      * @returns
-     *     Pointer to a new ZSRTP wrapper context.
+     *     Pointer to a new ZSRTP wrapper context, NULL if the wrapper does
+     *     not support the encryption algorithm.
      */
     ZsrtpContext* zsrtp_CreateWrapper(uint32_t ssrc, int32_t roc,
                                       int64_t  keyDerivRate,
@@ -155,6 +250,35 @@ extern "C"
      */
     void zsrtp_DestroyWrapper (ZsrtpContext* ctx);
 
+    /**
+     * Set the size of the SRTP replay window.
+     *
+     * A receiving wrapper accepts each packet index once and rejects
+     * packets that are older than the window, i.e. more than
+     * <code>size</code> packets behind the highest index it received. A
+     * larger window accepts packets that deep reordering delays, e.g. on
+     * bonded or multipath links. The wrapper keeps the window as a bitmap,
+     * a window costs one bit per packet and a new highest index shifts it.
+     * RFC 3711, chapter 3.3.2, requires at least 64 packets.
+     *
+     * Set the window before the wrapper processes the first packet, the
+     * function clears a window that already holds packets. Wrappers that
+     * <code>zsrtp_newCryptoContextForSSRC</code> forks get a window of the
+     * same size.
+     *
+     * @param ctx
+     *     A ZSRTP wrapper context.
+     *
+     * @param size
+     *     Window size in packets, <code>ZSRTP_DEFAULT_REPLAY_WINDOW</code>
+     *     up to <code>ZSRTP_MAX_REPLAY_WINDOW</code>, rounded up to a
+     *     multiple of 64.
+     *
+     * @returns
+     *     1 if the size is valid, 0 otherwise
+     */
+    int32_t zsrtp_setReplayWindow(ZsrtpContext* ctx, int32_t size);
+
     /**
      * Encrypt the RTP payload and compute authentication code.
      *
@@ -199,14 +323,61 @@ extern "C"
      */
     int32_t zsrtp_unprotect(ZsrtpContext* ctx, GstBuffer* buffer);
 
+#if GST_CHECK_VERSION(1,0,0)
+    /**
+     * Encrypt and authenticate a batch of RTP packets of one SSRC.
+     *
+     * Same as calling zsrtp_protect() for each buffer in order. With
+     * HMAC-SHA1 and the precomputed key state the tags of up to 16 packets
+     * are computed with one multi-buffer kernel call, it runs the SHA-1
+     * rounds of several packets in the lanes of the SIMD registers if the
+     * CPU supports it.
+     *
+     * @param ctx
+     *     The ZsrtpContext
+     * @param buffers
+     *     The RTP packets, in sending order
+     * @param count
+     *     Number of buffers
+     * @param results
+     *     Receives the result of zsrtp_protect() for each buffer
+     *
+     * @returns
+     *     the number of protected buffers
+     */
+    int32_t zsrtp_protectBatch(ZsrtpContext* ctx, GstBuffer** buffers, int32_t count, int32_t* results);
+
+    /**
+     * Check and decrypt a batch of SRTP packets of one SSRC.
+     *
+     * Same as calling zsrtp_unprotect() for each buffer in order, including
+     * the replay check of duplicates within the batch. See
+     * zsrtp_protectBatch().
+     *
+     * @param ctx
+     *     The ZsrtpContext
+     * @param buffers
+     *     The SRTP packets, in receiving order
+     * @param count
+     *     Number of buffers
+     * @param results
+     *     Receives the result of zsrtp_unprotect() for each buffer
+     *
+     * @returns
+     *     the number of decrypted buffers
+     */
+    int32_t zsrtp_unprotectBatch(ZsrtpContext* ctx, GstBuffer** buffers, int32_t count, int32_t* results);
+#endif
+
     /**
      * Derive a new Crypto Context for use with a new SSRC
      *
-     * This method stores a new Crypto Context initialized with the data
-     * of this crypto context. Replacing the SSRC, Roll-over-Counter, and
-     * the key derivation rate the application cab use this Crypto Context
-     * to encrypt / decrypt a new stream (Synchronization source) inside
-     * one RTP session.
+     * This method creates a new ZSRTP wrapper context initialized with the
+     * master key and master salt of this wrapper context. Replacing the SSRC,
+     * Roll-over-Counter, and the key derivation rate the application can use
+     * this Crypto Context to encrypt / decrypt a new stream (Synchronization
+     * source) inside one RTP session. The context <code>ctx</code> is not
+     * modified.
      *
      * Before the application can use this crypto context it must call
      * the <code>deriveSrtpKeys</code> method.
@@ -219,9 +390,11 @@ extern "C"
      *     The Roll-Over-Counter for this context
      * @param keyDerivRate
      *     The key derivation rate for this context
+     * @returns
+     *     Pointer to a new ZSRTP wrapper context, NULL on failure.
      */
-    void zsrtp_newCryptoContextForSSRC(ZsrtpContext* ctx, uint32_t ssrc, 
-                                      int32_t roc, int64_t keyDerivRate);
+    ZsrtpContext* zsrtp_newCryptoContextForSSRC(ZsrtpContext* ctx, uint32_t ssrc,
+                                                int32_t roc, int64_t keyDerivRate);
 
     /**
      * Perform key derivation according to SRTP specification
@@ -246,6 +419,10 @@ extern "C"
         CryptoContextCtrl* srtcp;
         void* userData;
         uint32_t srtcpIndex;
+        ZsrtpAead* aead;        /* Not NULL if the AES-GCM transform is active */
+        ZsrtpHmac* hmac;        /* Not NULL if HMAC-SHA1 uses the precomputed state */
+        ZsrtpCtr* ctr;          /* Not NULL if AES-CM uses the AES instructions */
+        int32_t nullCipher;     /* 1: SrtpEncryptionNull, authentication only */
     } ZsrtpContextCtrl;
 
     /**
@@ -260,9 +437,11 @@ extern "C"
      *
      * @param ealg
      *    The encryption algorithm to use. Possible values are <code>
-     *    SrtpEncryptionNull, SrtpEncryptionAESCM, SrtpEncryptionAESF8
-     *    </code>. See chapter 4.1.1 for AESCM (Counter mode) and 4.1.2
-     *    for AES F8 mode.
+     *    SrtpEncryptionNull, SrtpEncryptionAESCM, SrtpEncryptionAESF8,
+     *    SrtpEncryptionAESGCM</code>. See chapter 4.1.1 for AESCM (Counter
+     *    mode) and 4.1.2 for AES F8 mode, RFC 7714 for AES-GCM. With
+     *    SrtpEncryptionNull protected packets have the E flag cleared,
+     *    the same restrictions as for SRTP apply.
      *
      * @param aalg
      *    The authentication algorithm to use. Possible values are <code>
@@ -291,6 +470,8 @@ extern "C"
      *    AES as encryption algorithm. AES encrypts 16 byte blocks
      *    (independent of the key length). According to RFC3711 the standard
      *    value for the master salt length should be 112 bit (14 bytes).
+     *    AES-GCM uses a 96 bit (12 bytes) master salt, RFC 7714 chapter 12,
+     *    and takes the first 12 bytes of a longer salt.
      *
      * @param ekeyl
      *    The length in bytes of the session encryption key that SRTP shall
@@ -381,21 +562,23 @@ extern "C"
     /**
      * Derive a new Crypto Context for use with a new SSRC
      *
-     * This method stores a new Crypto Context initialized with the data
-     * of this crypto context. Replacing the SSRC, Roll-over-Counter, and
-     * the key derivation rate the application cab use this Crypto Context
-     * to encrypt / decrypt a new stream (Synchronization source) inside
-     * one RTP session.
+     * This method creates a new ZSRTCP wrapper context initialized with the
+     * master key and master salt of this wrapper context. Replacing the SSRC
+     * the application can use this Crypto Context to encrypt / decrypt a new
+     * stream (Synchronization source) inside one RTP session. The context
+     * <code>ctx</code> is not modified.
      *
      * Before the application can use this crypto context it must call
-     * the <code>deriveSrtpKeys</code> method.
+     * the <code>deriveSrtpKeysCtrl</code> method.
      *
      * @param ctx
      *     The ZsrtpContextCtrl
      * @param ssrc
      *     The SSRC for this context
+     * @returns
+     *     Pointer to a new ZSRTCP wrapper context, NULL on failure.
      */
-    void zsrtp_newCryptoContextForSSRCCtrl(ZsrtpContextCtrl* ctx, uint32_t ssrc);
+    ZsrtpContextCtrl* zsrtp_newCryptoContextForSSRCCtrl(ZsrtpContextCtrl* ctx, uint32_t ssrc);
 
     /**
      * Perform key derivation according to SRTP specification
@@ -0,0 +1,235 @@
+/*
+    This file implements an in-memory ZID cache on top of the ZID cache file.
+    Copyright (C) 2010  Werner Dittmann
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+
+#include <libzrtpcpp/ZIDCacheFile.h>
+#include <libzrtpcpp/ZIDRecordFile.h>
+
+/*
+ * In-memory ZID cache.
+ *
+ * The ZRTP engine of every filter calls getZidCacheInstance() and thus shares
+ * one cache per process. ZIDCacheFile searches the cache file for each
+ * getRecord() and writes and flushes the file for each saveRecord(), both in
+ * the handshake path and without locking.
+ *
+ * This cache keeps a copy of each record it read from the file in a hash
+ * table keyed by the ZID. getRecord() returns a copy of the cached record,
+ * saveRecord() finds the cached record by the ZID of the saved record, only
+ * updates it and marks it dirty. A
+ * background thread writes the dirty records to the file, batched every
+ * flush interval, and close() writes the remaining ones. One mutex protects
+ * the table, a second one the file cache.
+ *
+ * The build renames getZidCacheInstance() of ZIDCacheFile.cpp to
+ * getZidCacheFileInstance(), see src/CMakeLists.txt, and this file provides
+ * getZidCacheInstance().
+ */
+#define ZID_CACHE_FLUSH_INTERVAL 1000      /* milliseconds */
+
+ZIDCache* getZidCacheFileInstance();
+
+class ZIDCacheMem: public ZIDCache {
+
+public:
+    ZIDCacheMem(ZIDCache* file): file(file), stop(false), flusher() {}
+
+    ~ZIDCacheMem() { close(); }
+
+    int open(char *name) {
+        std::lock_guard<std::mutex> fileLock(fileMutex);
+        int rc = file->open(name);
+
+        if (rc >= 0 && !flusher.joinable()) {
+            stop = false;
+            flusher = std::thread(&ZIDCacheMem::flushThread, this);
+        }
+        return rc;
+    }
+
+    bool isOpen() {
+        std::lock_guard<std::mutex> fileLock(fileMutex);
+        return file->isOpen();
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wakeup.notify_one();
+        if (flusher.joinable())
+            flusher.join();
+        flush();
+
+        std::lock_guard<std::mutex> fileLock(fileMutex);
+        file->close();
+    }
+
+    ZIDRecord *getRecord(unsigned char *zid) {
+        std::string key((const char*)zid, IDENTIFIER_LEN);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = records.find(key);
+            if (it != records.end())
+                return new ZIDRecordFile(it->second);
+        }
+
+        /* Not cached: the file cache reads the record or creates and writes a new one */
+        ZIDRecordFile* rec;
+        {
+            std::lock_guard<std::mutex> fileLock(fileMutex);
+            rec = static_cast<ZIDRecordFile*>(file->getRecord(zid));
+        }
+        if (rec == NULL)
+            return NULL;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        records.emplace(key, *rec);
+        return rec;
+    }
+
+    /* ZRTP deletes the record after saving it, the key comes from the record itself */
+    unsigned int saveRecord(ZIDRecord *zidRecord) {
+        ZIDRecordFile* rec = static_cast<ZIDRecordFile*>(zidRecord);
+        std::string key((const char*)rec->getIdentifier(), IDENTIFIER_LEN);
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = records.find(key);
+
+        if (it == records.end())
+            return 0;
+
+        it->second = *rec;
+        dirty.insert(key);
+        return 1;
+    }
+
+    const unsigned char* getZid() {
+        std::lock_guard<std::mutex> fileLock(fileMutex);
+        return file->getZid();
+    }
+
+    int32_t getPeerName(const uint8_t *peerZid, std::string *name) {
+        std::lock_guard<std::mutex> fileLock(fileMutex);
+        return file->getPeerName(peerZid, name);
+    }
+
+    void putPeerName(const uint8_t *peerZid, const std::string name) {
+        std::lock_guard<std::mutex> fileLock(fileMutex);
+        file->putPeerName(peerZid, name);
+    }
+
+    void cleanup() {
+        flush();
+        std::lock_guard<std::mutex> lock(mutex);
+        std::lock_guard<std::mutex> fileLock(fileMutex);
+        file->cleanup();
+        records.clear();
+        dirty.clear();
+    }
+
+    void *prepareReadAll() {
+        flush();
+        fileMutex.lock();               /* until closeOpenStatement() */
+        return file->prepareReadAll();
+    }
+
+    void *readNextRecord(void *stmt, std::string *output) {
+        return file->readNextRecord(stmt, output);
+    }
+
+    void closeOpenStatement(void *stmt) {
+        file->closeOpenStatement(stmt);
+        fileMutex.unlock();
+    }
+
+    /* Write the dirty records to the file cache */
+    void flush() {
+        std::unordered_set<std::string> keys;
+        std::vector<ZIDRecordFile> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            keys.swap(dirty);
+            for (auto& key : keys)
+                batch.push_back(records.at(key));
+        }
+        if (batch.empty())
+            return;
+
+        std::lock_guard<std::mutex> fileLock(fileMutex);
+        for (auto& rec : batch)
+            file->saveRecord(&rec);
+    }
+
+private:
+    void flushThread() {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (!stop) {
+            wakeup.wait_for(lock, std::chrono::milliseconds(ZID_CACHE_FLUSH_INTERVAL));
+            if (dirty.empty())
+                continue;
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    ZIDCache* file;
+    std::mutex mutex;                   /* protects records and dirty */
+    std::mutex fileMutex;               /* protects the file cache */
+    std::condition_variable wakeup;
+    bool stop;
+    std::thread flusher;
+
+    std::unordered_map<std::string, ZIDRecordFile> records;
+    std::unordered_set<std::string> dirty;
+};
+
+static ZIDCacheMem* instance;
+
+static void closeInstance()
+{
+    instance->close();
+}
+
+ZIDCache* getZidCacheInstance()
+{
+    static std::once_flag once;
+
+    std::call_once(once, []() {
+        instance = new ZIDCacheMem(getZidCacheFileInstance());
+        atexit(closeInstance);
+    });
+    return instance;
+}
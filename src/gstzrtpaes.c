@@ -0,0 +1,275 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gstzrtpaes.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <wmmintrin.h>
+#  define ZRTP_AES_X86 1
+#elif defined(__aarch64__) && defined(__linux__)
+#  include <arm_neon.h>
+#  include <sys/auxv.h>
+#  include <asm/hwcap.h>
+#  define ZRTP_AES_ARM 1
+#  ifdef __clang__
+#    define ZRTP_AES_TARGET __attribute__((target("aes")))
+#  else
+#    define ZRTP_AES_TARGET __attribute__((target("+crypto")))
+#  endif
+#endif
+
+#define AES_BLOCK   16
+#define AES_LANES   8
+
+typedef void (*ZrtpAesFunc)(const ZrtpAesCtr* ctx, const guint8* iv, guint8* data, gsize length);
+
+static const guint8 sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b,
+    0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+    0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26,
+    0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2,
+    0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+    0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed,
+    0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f,
+    0x50, 0x3c, 0x9f, 0xa8, 0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+    0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec,
+    0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14,
+    0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+    0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79, 0xe7, 0xc8, 0x37, 0x6d,
+    0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f,
+    0x4b, 0xbd, 0x8b, 0x8a, 0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+    0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11,
+    0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f,
+    0xb0, 0x54, 0xbb, 0x16
+};
+
+gboolean
+zrtp_aes_ctr_init(ZrtpAesCtr* ctx, const guint8* key, gsize keyLength)
+{
+    guint8* w = &ctx->roundKeys[0][0];
+    guint8 rcon = 0x01;
+    guint nk = keyLength / 4;
+    guint words, i;
+
+    if (keyLength != 16 && keyLength != 24 && keyLength != 32)
+        return FALSE;
+
+    /* FIPS-197 chapter 5.2, the round keys stay in byte order */
+    ctx->rounds = nk + 6;
+    words = 4 * (ctx->rounds + 1);
+    memcpy(w, key, keyLength);
+    for (i = nk; i < words; i++) {
+        guint8 t[4];
+
+        memcpy(t, w + 4 * (i - 1), 4);
+        if (i % nk == 0) {
+            guint8 t0 = t[0];
+
+            t[0] = sbox[t[1]] ^ rcon;
+            t[1] = sbox[t[2]];
+            t[2] = sbox[t[3]];
+            t[3] = sbox[t0];
+            rcon = (rcon << 1) ^ ((rcon & 0x80) ? 0x1b : 0);
+        } else if (nk > 6 && i % nk == 4) {
+            t[0] = sbox[t[0]]; t[1] = sbox[t[1]];
+            t[2] = sbox[t[2]]; t[3] = sbox[t[3]];
+        }
+        w[4*i]   = w[4*(i - nk)]   ^ t[0];
+        w[4*i+1] = w[4*(i - nk)+1] ^ t[1];
+        w[4*i+2] = w[4*(i - nk)+2] ^ t[2];
+        w[4*i+3] = w[4*(i - nk)+3] ^ t[3];
+    }
+    return TRUE;
+}
+
+/* Counter block j after iv: the upper 96 bits of iv, the last 32 bits plus j */
+static inline void
+zrtp_aes_counter(guint8* block, const guint8* iv, guint32 j)
+{
+    guint32 ctr = ((guint32)iv[12] << 24 | (guint32)iv[13] << 16 | (guint32)iv[14] << 8 | iv[15]) + j;
+
+    memcpy(block, iv, 12);
+    block[12] = ctr >> 24;
+    block[13] = ctr >> 16;
+    block[14] = ctr >> 8;
+    block[15] = ctr;
+}
+
+#ifdef ZRTP_AES_X86
+/* Encrypt n counter blocks, n is a constant in the main loop */
+#define AESNI_BLOCKS(s, n, base, ctr, rk, rounds)                                       \
+    do {                                                                                \
+        guint i_;                                                                       \
+        gint r_;                                                                        \
+        for (i_ = 0; i_ < (n); i_++)                                                    \
+            s[i_] = _mm_xor_si128(_mm_or_si128(base,                                    \
+                        _mm_set_epi32(GUINT32_TO_BE((ctr) + i_), 0, 0, 0)), rk[0]);     \
+        for (r_ = 1; r_ < (rounds); r_++)                                               \
+            for (i_ = 0; i_ < (n); i_++)                                                \
+                s[i_] = _mm_aesenc_si128(s[i_], rk[r_]);                                \
+        for (i_ = 0; i_ < (n); i_++)                                                    \
+            s[i_] = _mm_aesenclast_si128(s[i_], rk[rounds]);                            \
+    } while (0)
+
+__attribute__((target("aes,sse2")))
+static void
+zrtp_aes_ctr_aesni(const ZrtpAesCtr* ctx, const guint8* iv, guint8* data, gsize length)
+{
+    __m128i rk[15];
+    __m128i s[AES_LANES];
+    __m128i base;
+    guint8 block[AES_BLOCK];
+    guint32 ctr = (guint32)iv[12] << 24 | (guint32)iv[13] << 16 | (guint32)iv[14] << 8 | iv[15];
+    gint r, rounds = ctx->rounds;
+    guint i, n;
+
+    for (r = 0; r <= rounds; r++)
+        rk[r] = _mm_loadu_si128((const __m128i*)ctx->roundKeys[r]);
+    base = _mm_and_si128(_mm_loadu_si128((const __m128i*)iv), _mm_set_epi32(0, -1, -1, -1));
+
+    for (; length >= AES_LANES * AES_BLOCK; length -= AES_LANES * AES_BLOCK, ctr += AES_LANES) {
+        AESNI_BLOCKS(s, AES_LANES, base, ctr, rk, rounds);
+        for (i = 0; i < AES_LANES; i++, data += AES_BLOCK) {
+            __m128i d = _mm_loadu_si128((const __m128i*)data);
+
+            _mm_storeu_si128((__m128i*)data, _mm_xor_si128(d, s[i]));
+        }
+    }
+    if (length == 0)
+        return;
+
+    n = (length + AES_BLOCK - 1) / AES_BLOCK;
+    AESNI_BLOCKS(s, n, base, ctr, rk, rounds);
+    for (i = 0; length >= AES_BLOCK; i++, data += AES_BLOCK, length -= AES_BLOCK) {
+        __m128i d = _mm_loadu_si128((const __m128i*)data);
+
+        _mm_storeu_si128((__m128i*)data, _mm_xor_si128(d, s[i]));
+    }
+    if (length > 0) {
+        _mm_storeu_si128((__m128i*)block, s[i]);
+        for (i = 0; i < length; i++)
+            data[i] ^= block[i];
+    }
+}
+#endif
+
+#ifdef ZRTP_AES_ARM
+ZRTP_AES_TARGET
+static void
+zrtp_aes_ctr_armv8(const ZrtpAesCtr* ctx, const guint8* iv, guint8* data, gsize length)
+{
+    uint8x16_t rk[15];
+    uint8x16_t s[AES_LANES];
+    guint8 block[AES_LANES][AES_BLOCK];
+    guint32 j = 0;
+    gint r, rounds = ctx->rounds;
+    guint i, n;
+
+    for (r = 0; r <= rounds; r++)
+        rk[r] = vld1q_u8(ctx->roundKeys[r]);
+
+    while (length > 0) {
+        n = MIN(AES_LANES, (length + AES_BLOCK - 1) / AES_BLOCK);
+        for (i = 0; i < n; i++) {
+            zrtp_aes_counter(block[i], iv, j++);
+            s[i] = vld1q_u8(block[i]);
+        }
+        /* AESE adds the round key before SubBytes and ShiftRows */
+        for (r = 0; r < rounds - 1; r++) {
+            for (i = 0; i < n; i++)
+                s[i] = vaesmcq_u8(vaeseq_u8(s[i], rk[r]));
+        }
+        for (i = 0; i < n; i++)
+            s[i] = veorq_u8(vaeseq_u8(s[i], rk[rounds - 1]), rk[rounds]);
+
+        for (i = 0; i < n && length >= AES_BLOCK; i++, data += AES_BLOCK, length -= AES_BLOCK)
+            vst1q_u8(data, veorq_u8(vld1q_u8(data), s[i]));
+        if (i < n) {
+            guint k;
+
+            vst1q_u8(block[0], s[i]);
+            for (k = 0; k < length; k++)
+                data[k] ^= block[0][k];
+            length = 0;
+        }
+    }
+}
+#endif
+
+static ZrtpAesFunc aesFunc = NULL;
+static const gchar* aesName = "none";
+static gint aesSelected = 0;
+
+/* Select the kernel, threads that race here store the same values */
+static void
+zrtp_aes_ctr_select(void)
+{
+    ZrtpAesFunc func = NULL;
+    const gchar* name = "none";
+
+#if defined(ZRTP_AES_X86)
+    if (__builtin_cpu_supports("aes")) {
+        func = zrtp_aes_ctr_aesni;
+        name = "aes-ni";
+    }
+#elif defined(ZRTP_AES_ARM)
+    if (getauxval(AT_HWCAP) & HWCAP_AES) {
+        func = zrtp_aes_ctr_armv8;
+        name = "armv8-ce";
+    }
+#endif
+    aesName = name;
+    g_atomic_pointer_set(&aesFunc, func);
+    g_atomic_int_set(&aesSelected, 1);
+}
+
+gboolean
+zrtp_aes_ctr_available(void)
+{
+    if (!g_atomic_int_get(&aesSelected))
+        zrtp_aes_ctr_select();
+    return g_atomic_pointer_get(&aesFunc) != NULL;
+}
+
+const gchar*
+zrtp_aes_ctr_impl(void)
+{
+    zrtp_aes_ctr_available();
+    return aesName;
+}
+
+void
+zrtp_aes_ctr_xor(const ZrtpAesCtr* ctx, const guint8* iv, guint8* data, gsize length)
+{
+    ZrtpAesFunc func = g_atomic_pointer_get(&aesFunc);
+
+    func(ctx, iv, data, length);
+}
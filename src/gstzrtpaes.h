@@ -0,0 +1,64 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_ZRTP_AES_H__
+#define __GST_ZRTP_AES_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * AES counter mode keystream for SRTP and SRTCP, RFC 3711 chapter 4.1.1.
+ *
+ * The kernels use the AES-NI instructions on x86 or the ARMv8 crypto
+ * extensions and encrypt 8 counter blocks per step, the rounds of the
+ * blocks overlap in the pipeline. The crypto module of the standalone build
+ * encrypts one block per table based AES call. If the CPU has neither
+ * instruction set zrtp_aes_ctr_available() returns FALSE and the caller
+ * keeps its own AES implementation. The first call selects the kernel.
+ *
+ * The counter is the last 32 bits of the IV in network order, the kernels
+ * do not carry into the upper 96 bits. SRTP IVs have 16 zero bits at the
+ * end, thus this holds for all packets shorter than 1 MByte.
+ */
+typedef struct _ZrtpAesCtr {
+    guint8 roundKeys[15][16];
+    gint   rounds;
+} ZrtpAesCtr;
+
+/* TRUE if the CPU supports one of the kernels */
+gboolean zrtp_aes_ctr_available(void);
+
+/* Name of the selected kernel, "none" if there is none */
+const gchar* zrtp_aes_ctr_impl(void);
+
+/* Expand a 16, 24 or 32 byte key, FALSE for other key lengths */
+gboolean zrtp_aes_ctr_init(ZrtpAesCtr* ctx, const guint8* key, gsize keyLength);
+
+/*
+ * XOR the keystream that starts with the counter block iv into data, for
+ * encryption and decryption. Requires zrtp_aes_ctr_available().
+ */
+void zrtp_aes_ctr_xor(const ZrtpAesCtr* ctx, const guint8* iv, guint8* data, gsize length);
+
+G_END_DECLS
+
+#endif /* __GST_ZRTP_AES_H__ */
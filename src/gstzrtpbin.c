@@ -0,0 +1,542 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:element-zrtpbin
+ *
+ * The zrtpbin contains one master zrtpfilter and one multi-stream zrtpfilter
+ * for each additional media stream of a call.
+ *
+ * The always pads of the bin (recv_rtp_sink, recv_rtp_src, ...) belong to the
+ * master session 0 and use the names of the zrtpfilter pads. Requesting a
+ * sink pad recv_rtp_sink_%u, recv_rtcp_sink_%u, send_rtp_sink_%u or
+ * send_rtcp_sink_%u creates the slave session %u (%u > 0) if it does not
+ * exist yet, the bin then adds the four matching src pads of the session.
+ *
+ * The bin sets the cache name on all sessions and initializes the master
+ * session when it goes to READY, the slave sessions are only initialized,
+ * not enabled. When the master session enters secure state the bin copies
+ * the master's multi-stream parameters to all slave sessions, enables them
+ * and, if multi-start is set, starts them. The individual sessions are
+ * children of the bin and named "zrtp_<session>", use gst_bin_get_by_name()
+ * to reach them, e.g. to connect to their signals.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch zrtpbin name=zrtp cache-name=gstZrtpCache.dat \
+ *     udpsrc port=5004 ! zrtp.recv_rtp_sink zrtp.recv_rtp_src ! fakesink \
+ *     udpsrc port=5008 ! zrtp.recv_rtp_sink_1 zrtp.recv_rtp_src_1 ! fakesink ...
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gstzrtpbin.h"
+#include "gstzrtpfilter.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_zrtp_bin_debug);
+#define GST_CAT_DEFAULT gst_zrtp_bin_debug
+
+#define ZRTP_BIN_SESSION "zrtp-session"
+#define ZRTP_BIN_STARTED "zrtp-started"
+
+#if GST_CHECK_VERSION(1,0,0)
+#define SESSION_FMT "%u"
+#else
+#define SESSION_FMT "%d"
+#endif
+
+enum
+{
+    PROP_0,
+    PROP_CACHE_NAME,
+    PROP_MULTI_START
+};
+
+/* Pad names of the zrtpfilter, sink pads at even indices, src pads follow their sink pad */
+static const gchar* filterPads[] = {
+    "recv_rtp_sink", "recv_rtp_src",
+    "recv_rtcp_sink", "recv_rtcp_src",
+    "send_rtp_sink", "send_rtp_src",
+    "send_rtcp_sink", "send_rtcp_src"
+};
+#define NUM_FILTER_PADS G_N_ELEMENTS(filterPads)
+
+/* Master session pads */
+#define ZRTP_BIN_ALWAYS_TEMPLATE(name, dir)                     \
+    static GstStaticPadTemplate zrtp_bin_##name##_template =    \
+        GST_STATIC_PAD_TEMPLATE (#name, dir, GST_PAD_ALWAYS, GST_STATIC_CAPS ("ANY"))
+
+/* Slave session pads */
+#define ZRTP_BIN_SESSION_TEMPLATE(name, dir, presence)                          \
+    static GstStaticPadTemplate zrtp_bin_##name##_session_template =            \
+        GST_STATIC_PAD_TEMPLATE (#name "_" SESSION_FMT, dir, presence, GST_STATIC_CAPS ("ANY"))
+
+ZRTP_BIN_ALWAYS_TEMPLATE(recv_rtp_sink, GST_PAD_SINK);
+ZRTP_BIN_ALWAYS_TEMPLATE(recv_rtp_src, GST_PAD_SRC);
+ZRTP_BIN_ALWAYS_TEMPLATE(recv_rtcp_sink, GST_PAD_SINK);
+ZRTP_BIN_ALWAYS_TEMPLATE(recv_rtcp_src, GST_PAD_SRC);
+ZRTP_BIN_ALWAYS_TEMPLATE(send_rtp_sink, GST_PAD_SINK);
+ZRTP_BIN_ALWAYS_TEMPLATE(send_rtp_src, GST_PAD_SRC);
+ZRTP_BIN_ALWAYS_TEMPLATE(send_rtcp_sink, GST_PAD_SINK);
+ZRTP_BIN_ALWAYS_TEMPLATE(send_rtcp_src, GST_PAD_SRC);
+
+ZRTP_BIN_SESSION_TEMPLATE(recv_rtp_sink, GST_PAD_SINK, GST_PAD_REQUEST);
+ZRTP_BIN_SESSION_TEMPLATE(recv_rtp_src, GST_PAD_SRC, GST_PAD_SOMETIMES);
+ZRTP_BIN_SESSION_TEMPLATE(recv_rtcp_sink, GST_PAD_SINK, GST_PAD_REQUEST);
+ZRTP_BIN_SESSION_TEMPLATE(recv_rtcp_src, GST_PAD_SRC, GST_PAD_SOMETIMES);
+ZRTP_BIN_SESSION_TEMPLATE(send_rtp_sink, GST_PAD_SINK, GST_PAD_REQUEST);
+ZRTP_BIN_SESSION_TEMPLATE(send_rtp_src, GST_PAD_SRC, GST_PAD_SOMETIMES);
+ZRTP_BIN_SESSION_TEMPLATE(send_rtcp_sink, GST_PAD_SINK, GST_PAD_REQUEST);
+ZRTP_BIN_SESSION_TEMPLATE(send_rtcp_src, GST_PAD_SRC, GST_PAD_SOMETIMES);
+
+#if GST_CHECK_VERSION(1,0,0)
+#define gst_zrtp_bin_parent_class parent_class
+G_DEFINE_TYPE(GstZrtpBin, gst_zrtp_bin, GST_TYPE_BIN)
+#else
+GST_BOILERPLATE (GstZrtpBin, gst_zrtp_bin, GstBin, GST_TYPE_BIN);
+#endif
+
+static void gst_zrtp_bin_finalize (GObject * object);
+static void gst_zrtp_bin_set_property (GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec);
+static void gst_zrtp_bin_get_property (GObject * object, guint prop_id, GValue * value, GParamSpec * pspec);
+
+#if GST_CHECK_VERSION(1,0,0)
+static GstPad* gst_zrtp_bin_request_new_pad (GstElement * element, GstPadTemplate * templ,
+                                             const gchar * name, const GstCaps * caps);
+#else
+static GstPad* gst_zrtp_bin_request_new_pad (GstElement * element, GstPadTemplate * templ,
+                                             const gchar * name);
+#endif
+static void gst_zrtp_bin_release_pad (GstElement * element, GstPad * pad);
+static GstStateChangeReturn gst_zrtp_bin_change_state (GstElement * element, GstStateChange transition);
+
+static void zrtp_bin_master_status (GstElement* master, gint severity, gint subCode, gpointer data);
+
+static void
+gst_zrtp_bin_base_init(gpointer gclass)
+{
+    GstElementClass *element_class = GST_ELEMENT_CLASS (gclass);
+
+    gst_element_class_set_details_simple(element_class,
+                                         "ZrtpBin",
+                                         "Filter/Network/ZRTP",
+                                         "Manage a ZRTP master session and its multi-stream sessions.",
+                                         "Werner Dittmann <Werner.Dittmann@t-online.de>");
+
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_recv_rtp_sink_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_recv_rtp_src_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_recv_rtcp_sink_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_recv_rtcp_src_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_send_rtp_sink_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_send_rtp_src_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_send_rtcp_sink_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_send_rtcp_src_template));
+
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_recv_rtp_sink_session_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_recv_rtp_src_session_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_recv_rtcp_sink_session_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_recv_rtcp_src_session_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_send_rtp_sink_session_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_send_rtp_src_session_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_send_rtcp_sink_session_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_bin_send_rtcp_src_session_template));
+}
+
+static void
+gst_zrtp_bin_class_init(GstZrtpBinClass * klass)
+{
+    GObjectClass *gobject_class;
+    GstElementClass *gstelement_class;
+
+    gobject_class = (GObjectClass *) klass;
+    gstelement_class = (GstElementClass *) klass;
+
+#if GST_CHECK_VERSION(1,0,0)
+    gst_zrtp_bin_base_init(klass);
+#endif
+
+    gobject_class->finalize = gst_zrtp_bin_finalize;
+    gobject_class->set_property = gst_zrtp_bin_set_property;
+    gobject_class->get_property = gst_zrtp_bin_get_property;
+
+    gstelement_class->request_new_pad = GST_DEBUG_FUNCPTR(gst_zrtp_bin_request_new_pad);
+    gstelement_class->release_pad = GST_DEBUG_FUNCPTR(gst_zrtp_bin_release_pad);
+    gstelement_class->change_state = GST_DEBUG_FUNCPTR(gst_zrtp_bin_change_state);
+
+    g_object_class_install_property(gobject_class, PROP_CACHE_NAME,
+                                    g_param_spec_string("cache-name", "Cache", "ZRTP cache filename.",
+                                                        NULL, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_MULTI_START,
+                                    g_param_spec_boolean("multi-start", "MultiStart",
+                                                         "Start the multi-stream sessions, otherwise only enable them.",
+                                                         TRUE, G_PARAM_READWRITE));
+
+    GST_DEBUG_CATEGORY_INIT (gst_zrtp_bin_debug, "zrtpbin", 0, "ZRTP bin");
+}
+
+/* Add a ghost pad for a pad of a session filter */
+static GstPad*
+zrtp_bin_ghost_pad(GstZrtpBin* zbin, GstElement* filter, const gchar* filterPad,
+                   const gchar* name, GstPadTemplate* templ)
+{
+    GstPad* target;
+    GstPad* ghost;
+
+    target = gst_element_get_static_pad(filter, filterPad);
+    ghost = gst_ghost_pad_new_from_template(name, target, templ);
+    gst_object_unref(target);
+
+    if (GST_STATE(zbin) > GST_STATE_NULL)
+        gst_pad_set_active(ghost, TRUE);
+    gst_element_add_pad(GST_ELEMENT(zbin), ghost);
+    return ghost;
+}
+
+/* initialize the new element, create the master session */
+#if GST_CHECK_VERSION(1,0,0)
+static void
+gst_zrtp_bin_init (GstZrtpBin* zbin)
+#else
+static void
+gst_zrtp_bin_init (GstZrtpBin* zbin, GstZrtpBinClass* gclass)
+#endif
+{
+    GstElementClass* klass = GST_ELEMENT_GET_CLASS(zbin);
+    guint i;
+
+    zbin->multiStart = TRUE;
+    zbin->master = gst_element_factory_make("zrtpfilter", "zrtp_0");
+    g_object_set_data(G_OBJECT(zbin->master), ZRTP_BIN_SESSION, GUINT_TO_POINTER(0));
+    gst_bin_add(GST_BIN(zbin), zbin->master);
+
+    for (i = 0; i < NUM_FILTER_PADS; i++)
+        zrtp_bin_ghost_pad(zbin, zbin->master, filterPads[i], filterPads[i],
+                           gst_element_class_get_pad_template(klass, filterPads[i]));
+
+    g_signal_connect(zbin->master, "status", G_CALLBACK(zrtp_bin_master_status), zbin);
+}
+
+static void
+gst_zrtp_bin_finalize (GObject* object)
+{
+    GstZrtpBin* zbin = GST_ZRTPBIN(object);
+
+    /* The bin owns the filters, the list just points to them */
+    g_slist_free(zbin->slaves);
+    g_free(zbin->cacheName);
+
+    G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_zrtp_bin_set_property (GObject * object, guint prop_id,
+                           const GValue * value, GParamSpec * pspec)
+{
+    GstZrtpBin* zbin = GST_ZRTPBIN(object);
+
+    switch (prop_id) {
+    case PROP_CACHE_NAME:
+        GST_OBJECT_LOCK(zbin);
+        g_free(zbin->cacheName);
+        zbin->cacheName = g_value_dup_string(value);
+        GST_OBJECT_UNLOCK(zbin);
+        GST_DEBUG("'%s'", zbin->cacheName);
+        break;
+    case PROP_MULTI_START:
+        zbin->multiStart = g_value_get_boolean(value);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+gst_zrtp_bin_get_property (GObject * object, guint prop_id,
+                           GValue * value, GParamSpec * pspec)
+{
+    GstZrtpBin* zbin = GST_ZRTPBIN(object);
+
+    switch (prop_id) {
+    case PROP_CACHE_NAME:
+        GST_OBJECT_LOCK(zbin);
+        g_value_set_string(value, zbin->cacheName);
+        GST_OBJECT_UNLOCK(zbin);
+        break;
+    case PROP_MULTI_START:
+        g_value_set_boolean(value, zbin->multiStart);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+/*
+ * Hand the master's multi-stream parameters to a slave session and enable it.
+ * Without multi-stream support of the peer the slave runs a full DH exchange.
+ * The master status and a new session may both try to start a slave, the
+ * started mark is checked and set under the object lock, each slave starts once.
+ */
+static void
+zrtp_bin_start_slave(GstZrtpBin* zbin, GstElement* slave)
+{
+    gboolean multiAvailable = FALSE;
+    gboolean started;
+
+    GST_OBJECT_LOCK(zbin);
+    started = g_object_get_data(G_OBJECT(slave), ZRTP_BIN_STARTED) != NULL;
+    if (!started)
+        g_object_set_data(G_OBJECT(slave), ZRTP_BIN_STARTED, GINT_TO_POINTER(TRUE));
+    GST_OBJECT_UNLOCK(zbin);
+    if (started)
+        return;
+
+    g_object_get(G_OBJECT(zbin->master), "multi-available", &multiAvailable, NULL);
+    if (multiAvailable) {
+        GByteArray* mspArr = NULL;
+
+        g_object_get(G_OBJECT(zbin->master), "multi-param", &mspArr, NULL);
+        if (mspArr != NULL && mspArr->len > 0)
+            g_object_set(G_OBJECT(slave), "multi-param", mspArr, NULL);
+        if (mspArr != NULL)
+            g_byte_array_unref(mspArr);
+    }
+    else
+        GST_WARNING_OBJECT(zbin, "peer does not support multi-stream, %s uses DH mode", GST_ELEMENT_NAME(slave));
+
+    g_object_set(G_OBJECT(slave), "enable", TRUE, NULL);
+    if (zbin->multiStart)
+        g_object_set(G_OBJECT(slave), "start", TRUE, NULL);
+}
+
+/* Set the cache name and initialize a slave without enabling it */
+static void
+zrtp_bin_init_slave(GstZrtpBin* zbin, GstElement* slave)
+{
+    g_object_set(G_OBJECT(slave), "cache-name", zbin->cacheName, NULL);
+    g_object_set(G_OBJECT(slave), "initialize", FALSE, NULL);
+}
+
+static void
+zrtp_bin_master_status (GstElement* master, gint severity, gint subCode, gpointer data)
+{
+    GstZrtpBin* zbin = GST_ZRTPBIN(data);
+    GSList* slaves;
+    GSList* walk;
+
+    if (severity != zrtp_Info)
+        return;
+
+    if (subCode == zrtp_InfoSecureStateOff) {
+        GST_OBJECT_LOCK(zbin);
+        zbin->masterSecure = FALSE;
+        GST_OBJECT_UNLOCK(zbin);
+        return;
+    }
+    if (subCode != zrtp_InfoSecureStateOn)
+        return;
+
+    /* Work on a copy, the sessions start without the object lock held */
+    GST_OBJECT_LOCK(zbin);
+    zbin->masterSecure = TRUE;
+    slaves = g_slist_copy(zbin->slaves);
+    g_slist_foreach(slaves, (GFunc)gst_object_ref, NULL);
+    GST_OBJECT_UNLOCK(zbin);
+
+    for (walk = slaves; walk != NULL; walk = g_slist_next(walk)) {
+        zrtp_bin_start_slave(zbin, GST_ELEMENT(walk->data));
+        gst_object_unref(walk->data);
+    }
+    g_slist_free(slaves);
+}
+
+static GstElement*
+zrtp_bin_find_session(GstZrtpBin* zbin, guint session)
+{
+    GSList* walk;
+
+    for (walk = zbin->slaves; walk != NULL; walk = g_slist_next(walk)) {
+        if (GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(walk->data), ZRTP_BIN_SESSION)) == session)
+            return GST_ELEMENT(walk->data);
+    }
+    return NULL;
+}
+
+/* Return the slave filter of a session, create it and its src pads if necessary */
+static GstElement*
+zrtp_bin_get_session(GstZrtpBin* zbin, guint session)
+{
+    GstElementClass* klass = GST_ELEMENT_GET_CLASS(zbin);
+    GstElement* slave;
+    gboolean secure;
+    gchar* name;
+    guint i;
+
+    GST_OBJECT_LOCK(zbin);
+    slave = zrtp_bin_find_session(zbin, session);
+    GST_OBJECT_UNLOCK(zbin);
+    if (slave != NULL)
+        return slave;
+
+    name = g_strdup_printf("zrtp_%u", session);
+    slave = gst_element_factory_make("zrtpfilter", name);
+    g_free(name);
+    if (slave == NULL)
+        return NULL;
+
+    g_object_set_data(G_OBJECT(slave), ZRTP_BIN_SESSION, GUINT_TO_POINTER(session));
+    gst_bin_add(GST_BIN(zbin), slave);
+
+    if (zbin->initialized)
+        zrtp_bin_init_slave(zbin, slave);
+
+    for (i = 1; i < NUM_FILTER_PADS; i += 2) {
+        GstPadTemplate* templ;
+        gchar* tmplName = g_strconcat(filterPads[i], "_" SESSION_FMT, NULL);
+
+        templ = gst_element_class_get_pad_template(klass, tmplName);
+        g_free(tmplName);
+
+        name = g_strdup_printf("%s_%u", filterPads[i], session);
+        zrtp_bin_ghost_pad(zbin, slave, filterPads[i], name, templ);
+        g_free(name);
+    }
+    gst_element_sync_state_with_parent(slave);
+
+    GST_OBJECT_LOCK(zbin);
+    zbin->slaves = g_slist_prepend(zbin->slaves, slave);
+    secure = zbin->masterSecure;
+    GST_OBJECT_UNLOCK(zbin);
+
+    /* A session added during the call starts at once */
+    if (secure && zbin->initialized)
+        zrtp_bin_start_slave(zbin, slave);
+
+    return slave;
+}
+
+#if GST_CHECK_VERSION(1,0,0)
+static GstPad*
+gst_zrtp_bin_request_new_pad (GstElement * element, GstPadTemplate * templ,
+                              const gchar * name, const GstCaps * caps)
+#else
+static GstPad*
+gst_zrtp_bin_request_new_pad (GstElement * element, GstPadTemplate * templ,
+                              const gchar * name)
+#endif
+{
+    GstZrtpBin* zbin = GST_ZRTPBIN(element);
+    const gchar* tmplName = GST_PAD_TEMPLATE_NAME_TEMPLATE(templ);
+    const gchar* filterPad = NULL;
+    GstElement* slave;
+    GstPad* pad;
+    gchar* padName;
+    guint session;
+    guint i;
+
+    if (GST_PAD_TEMPLATE_DIRECTION(templ) != GST_PAD_SINK)
+        return NULL;
+
+    for (i = 0; i < NUM_FILTER_PADS; i += 2) {
+        gsize len = strlen(filterPads[i]);
+
+        if (strncmp(tmplName, filterPads[i], len) == 0 && tmplName[len] == '_') {
+            filterPad = filterPads[i];
+            break;
+        }
+    }
+    if (filterPad == NULL)
+        return NULL;
+
+    /* Without a name use the next free session */
+    if (name == NULL || sscanf(name + strlen(filterPad), "_%u", &session) != 1) {
+        GST_OBJECT_LOCK(zbin);
+        for (session = 1; zrtp_bin_find_session(zbin, session) != NULL; session++)
+            ;
+        GST_OBJECT_UNLOCK(zbin);
+    }
+    if (session == 0) {
+        GST_WARNING_OBJECT(zbin, "session 0 is the master session, use the always pads");
+        return NULL;
+    }
+
+    slave = zrtp_bin_get_session(zbin, session);
+    if (slave == NULL)
+        return NULL;
+
+    padName = g_strdup_printf("%s_%u", filterPad, session);
+    pad = gst_element_get_static_pad(element, padName);
+    if (pad != NULL) {
+        gst_object_unref(pad);
+        GST_WARNING_OBJECT(zbin, "pad %s already requested", padName);
+        g_free(padName);
+        return NULL;
+    }
+    pad = zrtp_bin_ghost_pad(zbin, slave, filterPad, padName, templ);
+    g_free(padName);
+
+    return pad;
+}
+
+/* The session stays until the bin goes away, its src pads remain as well */
+static void
+gst_zrtp_bin_release_pad (GstElement * element, GstPad * pad)
+{
+    if (GST_PAD_PARENT(pad) != element)
+        return;
+
+    gst_pad_set_active(pad, FALSE);
+    gst_element_remove_pad(element, pad);
+}
+
+static GstStateChangeReturn
+gst_zrtp_bin_change_state (GstElement * element, GstStateChange transition)
+{
+    GstZrtpBin* zbin = GST_ZRTPBIN(element);
+
+    if (transition == GST_STATE_CHANGE_NULL_TO_READY && !zbin->initialized) {
+        GSList* slaves;
+        GSList* walk;
+
+        /* The master initializes the ZRTP cache, the slaves share it */
+        g_object_set(G_OBJECT(zbin->master), "cache-name", zbin->cacheName, NULL);
+        g_object_set(G_OBJECT(zbin->master), "initialize", TRUE, NULL);
+
+        GST_OBJECT_LOCK(zbin);
+        slaves = g_slist_copy(zbin->slaves);
+        zbin->initialized = TRUE;
+        GST_OBJECT_UNLOCK(zbin);
+
+        for (walk = slaves; walk != NULL; walk = g_slist_next(walk))
+            zrtp_bin_init_slave(zbin, GST_ELEMENT(walk->data));
+        g_slist_free(slaves);
+    }
+    return GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+}
@@ -0,0 +1,70 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_ZRTP_BIN_H__
+#define __GST_ZRTP_BIN_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_ZRTPBIN \
+(gst_zrtp_bin_get_type())
+
+#define GST_ZRTPBIN(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_ZRTPBIN,GstZrtpBin))
+
+#define GST_ZRTPBIN_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_ZRTPBIN,GstZrtpBinClass))
+
+#define GST_IS_ZRTPBIN(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_ZRTPBIN))
+
+#define GST_IS_ZRTPBIN_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_ZRTPBIN))
+
+typedef struct _GstZrtpBin      GstZrtpBin;
+typedef struct _GstZrtpBinClass GstZrtpBinClass;
+
+/**
+ * GstZrtpBin:
+ *
+ * Opaque #GstZrtpBin data structure.
+ */
+struct _GstZrtpBin
+{
+    GstBin bin;
+
+    /*< private >*/
+    GstElement* master;         /* session 0 */
+    GSList* slaves;             /* GstElement, session id in "zrtp-session", started mark in "zrtp-started" data */
+    gchar* cacheName;
+    gboolean initialized;       /* master engine initialized, bin is READY or higher */
+    gboolean masterSecure;
+    gboolean multiStart;        /* start slaves, otherwise only enable them */
+};
+
+struct _GstZrtpBinClass
+{
+    GstBinClass parent_class;
+};
+
+GType gst_zrtp_bin_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_ZRTP_BIN_H__ */
@@ -0,0 +1,185 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "gstzrtpcrc.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <nmmintrin.h>
+#  define ZRTP_CRC_X86 1
+#elif defined(__aarch64__) && defined(__linux__)
+#  include <sys/auxv.h>
+#  include <asm/hwcap.h>
+#  define ZRTP_CRC_ARM 1
+#endif
+
+#define CRC32C_POLY 0x82f63b78          /* reflected Castagnoli polynomial */
+
+typedef guint32 (*ZrtpCrcFunc)(guint32 crc, const guint8* data, gsize length);
+
+static guint32 crcTable[8][256];
+
+static void
+zrtp_crc32c_init_table(void)
+{
+    static gsize initialized = 0;
+    guint32 i, j, crc;
+
+    if (!g_once_init_enter(&initialized))
+        return;
+
+    for (i = 0; i < 256; i++) {
+        crc = i;
+        for (j = 0; j < 8; j++)
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        crcTable[0][i] = crc;
+    }
+    for (i = 0; i < 256; i++) {
+        crc = crcTable[0][i];
+        for (j = 1; j < 8; j++) {
+            crc = crcTable[0][crc & 0xff] ^ (crc >> 8);
+            crcTable[j][i] = crc;
+        }
+    }
+    g_once_init_leave(&initialized, 1);
+}
+
+/* Slice-by-8: eight table lookups per 8 bytes instead of a dependent chain */
+static guint32
+zrtp_crc32c_sw(guint32 crc, const guint8* data, gsize length)
+{
+    while (length > 0 && ((gsize)data & 7) != 0) {
+        crc = crcTable[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+        length--;
+    }
+    while (length >= 8) {
+        guint32 lo = GUINT32_FROM_LE(*(const guint32*)data) ^ crc;
+        guint32 hi = GUINT32_FROM_LE(*(const guint32*)(data + 4));
+
+        crc = crcTable[7][lo & 0xff] ^ crcTable[6][(lo >> 8) & 0xff] ^
+              crcTable[5][(lo >> 16) & 0xff] ^ crcTable[4][lo >> 24] ^
+              crcTable[3][hi & 0xff] ^ crcTable[2][(hi >> 8) & 0xff] ^
+              crcTable[1][(hi >> 16) & 0xff] ^ crcTable[0][hi >> 24];
+        data += 8;
+        length -= 8;
+    }
+    while (length-- > 0)
+        crc = crcTable[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef ZRTP_CRC_X86
+__attribute__((target("sse4.2")))
+static guint32
+zrtp_crc32c_sse42(guint32 crc, const guint8* data, gsize length)
+{
+    while (length > 0 && ((gsize)data & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+        length--;
+    }
+#ifdef __x86_64__
+    {
+        guint64 crc64 = crc;
+
+        for (; length >= 8; data += 8, length -= 8)
+            crc64 = _mm_crc32_u64(crc64, *(const guint64*)data);
+        crc = (guint32)crc64;
+    }
+#endif
+    for (; length >= 4; data += 4, length -= 4)
+        crc = _mm_crc32_u32(crc, *(const guint32*)data);
+    while (length-- > 0)
+        crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+#endif
+
+#ifdef ZRTP_CRC_ARM
+static guint32
+zrtp_crc32c_armv8(guint32 crc, const guint8* data, gsize length)
+{
+    while (length > 0 && ((gsize)data & 7) != 0) {
+        __asm__(".arch_extension crc\n\tcrc32cb %w0, %w0, %w1" : "+r"(crc) : "r"((guint32)*data++));
+        length--;
+    }
+    for (; length >= 8; data += 8, length -= 8)
+        __asm__(".arch_extension crc\n\tcrc32cx %w0, %w0, %x1" : "+r"(crc) : "r"(*(const guint64*)data));
+    while (length-- > 0)
+        __asm__(".arch_extension crc\n\tcrc32cb %w0, %w0, %w1" : "+r"(crc) : "r"((guint32)*data++));
+    return crc;
+}
+#endif
+
+static guint32 zrtp_crc32c_select(guint32 crc, const guint8* data, gsize length);
+
+static ZrtpCrcFunc crcFunc = zrtp_crc32c_select;
+static const gchar* crcName = "table";
+
+/* Select the implementation, threads that race here store the same values */
+static guint32
+zrtp_crc32c_select(guint32 crc, const guint8* data, gsize length)
+{
+    ZrtpCrcFunc func = zrtp_crc32c_sw;
+    const gchar* name = "table";
+
+#if defined(ZRTP_CRC_X86)
+    if (__builtin_cpu_supports("sse4.2")) {
+        func = zrtp_crc32c_sse42;
+        name = "sse4.2";
+    }
+#elif defined(ZRTP_CRC_ARM)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        func = zrtp_crc32c_armv8;
+        name = "armv8-crc";
+    }
+#endif
+    if (func == zrtp_crc32c_sw)
+        zrtp_crc32c_init_table();
+
+    crcName = name;
+    g_atomic_pointer_set(&crcFunc, func);
+    return func(crc, data, length);
+}
+
+guint32
+zrtp_crc32c(const guint8* data, gsize length)
+{
+    ZrtpCrcFunc func = g_atomic_pointer_get(&crcFunc);
+
+    return ~func(~(guint32)0, data, length);
+}
+
+guint32
+zrtp_crc32c_table(const guint8* data, gsize length)
+{
+    zrtp_crc32c_init_table();
+    return ~zrtp_crc32c_sw(~(guint32)0, data, length);
+}
+
+const gchar*
+zrtp_crc32c_impl(void)
+{
+    if (g_atomic_pointer_get(&crcFunc) == zrtp_crc32c_select)
+        zrtp_crc32c(NULL, 0);
+    return crcName;
+}
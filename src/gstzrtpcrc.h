@@ -0,0 +1,52 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_ZRTP_CRC_H__
+#define __GST_ZRTP_CRC_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * CRC-32c (Castagnoli) of ZRTP packets, RFC 6189 chapter 5.
+ *
+ * zrtp_crc32c() uses the CRC32 instruction of SSE4.2 on x86 or the CRC32
+ * extension of ARMv8 if the CPU has it and a slice-by-8 table otherwise.
+ * The first call selects the implementation.
+ *
+ * The result is the final CRC value, the filter stores it in little endian
+ * byte order at the end of the ZRTP packet. This is the same value that
+ * zrtp_EndCksum(zrtp_GenerateCksum()) returns, byte swapped.
+ */
+
+/* CRC-32c of length bytes */
+guint32 zrtp_crc32c(const guint8* data, gsize length);
+
+/* Table implementation, for comparison in the benchmark */
+guint32 zrtp_crc32c_table(const guint8* data, gsize length);
+
+/* Name of the implementation that zrtp_crc32c() uses */
+const gchar* zrtp_crc32c_impl(void);
+
+G_END_DECLS
+
+#endif /* __GST_ZRTP_CRC_H__ */
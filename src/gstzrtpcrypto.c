@@ -0,0 +1,330 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "gstzrtpcrypto.h"
+
+typedef struct _ZrtpCryptoItem {
+    GstBuffer* buffer;
+    guint seq;
+} ZrtpCryptoItem;
+
+/* Single producer/single consumer ring, head and tail count up and wrap */
+typedef struct _ZrtpCryptoQueue {
+    ZrtpCryptoItem items[ZRTP_CRYPTO_DEPTH];
+    volatile gint head;             /* written by the worker */
+    volatile gint tail;             /* written by the streaming thread */
+} ZrtpCryptoQueue;
+
+typedef struct _ZrtpCryptoWorker {
+    ZrtpCryptoQueue queues[ZRTP_CRYPTO_STREAMS];
+    ZrtpCryptoPool* pool;
+    guint index;
+    GThread* thread;
+    GMutex* mutex;
+    GCond* wakeup;
+    volatile gint sleeping;
+} ZrtpCryptoWorker;
+
+typedef struct _ZrtpCryptoStream {
+    ZrtpCryptoFunc process;
+    ZrtpCryptoPushFunc push;
+    GstBuffer* buffers[ZRTP_CRYPTO_DEPTH];  /* reorder slots */
+    volatile gint done[ZRTP_CRYPTO_DEPTH];
+    guint nextSeq;                  /* streaming thread only */
+    volatile gint nextOut;          /* next sequence number to push */
+    volatile gint flow;
+    GMutex* pushMutex;
+    GMutex* mutex;                  /* protects waiting for space or drain */
+    GCond* space;
+    volatile gint waiting;
+} ZrtpCryptoStream;
+
+struct _ZrtpCryptoPool {
+    ZrtpCryptoStream streams[ZRTP_CRYPTO_STREAMS];
+    ZrtpCryptoWorker* workers;
+    guint numWorkers;
+    volatile gint running;
+    gpointer userData;
+};
+
+static inline guint
+zrtp_crypto_in_flight(ZrtpCryptoStream* stream)
+{
+    return stream->nextSeq - (guint)g_atomic_int_get(&stream->nextOut);
+}
+
+/* Wait until at most limit packets of the stream are in flight */
+static void
+zrtp_crypto_wait(ZrtpCryptoStream* stream, guint limit)
+{
+    if (zrtp_crypto_in_flight(stream) <= limit)
+        return;
+
+    g_mutex_lock(stream->mutex);
+    g_atomic_int_set(&stream->waiting, 1);
+    while (zrtp_crypto_in_flight(stream) > limit)
+        g_cond_wait(stream->space, stream->mutex);
+    g_atomic_int_set(&stream->waiting, 0);
+    g_mutex_unlock(stream->mutex);
+}
+
+/*
+ * Store a processed packet in its reorder slot and push all consecutive
+ * finished packets. Only the holder of the push lock pushes, a worker that
+ * does not get the lock leaves its packet to the holder. The holder checks
+ * the next slot again after it released the lock, thus no packet stays
+ * behind.
+ */
+static void
+zrtp_crypto_finish(ZrtpCryptoPool* pool, ZrtpCryptoStream* stream, guint seq, GstBuffer* gstBuf)
+{
+    guint slot = seq & (ZRTP_CRYPTO_DEPTH - 1);
+
+    stream->buffers[slot] = gstBuf;
+    g_atomic_int_set(&stream->done[slot], 1);
+
+    for (;;) {
+        if (!g_mutex_trylock(stream->pushMutex))
+            return;
+
+        for (;;) {
+            guint out = g_atomic_int_get(&stream->nextOut);
+            GstBuffer* outBuf;
+
+            slot = out & (ZRTP_CRYPTO_DEPTH - 1);
+            if (!g_atomic_int_get(&stream->done[slot]))
+                break;
+            outBuf = stream->buffers[slot];
+            stream->buffers[slot] = NULL;
+            g_atomic_int_set(&stream->done[slot], 0);
+
+            if (outBuf != NULL) {
+                GstFlowReturn rc = stream->push(pool->userData, outBuf);
+                if (rc != GST_FLOW_OK)
+                    g_atomic_int_set(&stream->flow, rc);
+            }
+            g_atomic_int_set(&stream->nextOut, out + 1);
+
+            if (g_atomic_int_get(&stream->waiting)) {
+                g_mutex_lock(stream->mutex);
+                g_cond_signal(stream->space);
+                g_mutex_unlock(stream->mutex);
+            }
+        }
+        g_mutex_unlock(stream->pushMutex);
+
+        slot = (guint)g_atomic_int_get(&stream->nextOut) & (ZRTP_CRYPTO_DEPTH - 1);
+        if (!g_atomic_int_get(&stream->done[slot]))
+            return;
+    }
+}
+
+static gboolean
+zrtp_crypto_queues_empty(ZrtpCryptoWorker* worker)
+{
+    guint s;
+
+    for (s = 0; s < ZRTP_CRYPTO_STREAMS; s++) {
+        ZrtpCryptoQueue* queue = &worker->queues[s];
+
+        if (g_atomic_int_get(&queue->head) != g_atomic_int_get(&queue->tail))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static gpointer
+zrtp_crypto_worker_thread(gpointer data)
+{
+    ZrtpCryptoWorker* worker = (ZrtpCryptoWorker*)data;
+    ZrtpCryptoPool* pool = worker->pool;
+
+    while (g_atomic_int_get(&pool->running)) {
+        gboolean idle = TRUE;
+        guint s;
+
+        for (s = 0; s < ZRTP_CRYPTO_STREAMS; s++) {
+            ZrtpCryptoQueue* queue = &worker->queues[s];
+            ZrtpCryptoStream* stream = &pool->streams[s];
+            guint head = g_atomic_int_get(&queue->head);
+
+            while (head != (guint)g_atomic_int_get(&queue->tail)) {
+                ZrtpCryptoItem item = queue->items[head & (ZRTP_CRYPTO_DEPTH - 1)];
+
+                g_atomic_int_set(&queue->head, ++head);
+                zrtp_crypto_finish(pool, stream, item.seq,
+                                   stream->process(pool->userData, worker->index, item.buffer));
+                idle = FALSE;
+            }
+        }
+        if (!idle)
+            continue;
+
+        /* Announce the sleep first, then check again: a producer either sees
+         * the flag or this check sees its packet
+         */
+        g_mutex_lock(worker->mutex);
+        g_atomic_int_set(&worker->sleeping, 1);
+        if (zrtp_crypto_queues_empty(worker) && g_atomic_int_get(&pool->running))
+            g_cond_wait(worker->wakeup, worker->mutex);
+        g_atomic_int_set(&worker->sleeping, 0);
+        g_mutex_unlock(worker->mutex);
+    }
+    return NULL;
+}
+
+static void
+zrtp_crypto_wakeup(ZrtpCryptoWorker* worker)
+{
+    g_mutex_lock(worker->mutex);
+    g_cond_signal(worker->wakeup);
+    g_mutex_unlock(worker->mutex);
+}
+
+ZrtpCryptoPool*
+zrtp_crypto_pool_new(guint workers, gpointer userData)
+{
+    ZrtpCryptoPool* pool;
+    GError* error = NULL;
+    guint i;
+
+    workers = CLAMP(workers, 1, ZRTP_CRYPTO_MAX_WORKERS);
+
+    pool = g_new0(ZrtpCryptoPool, 1);
+    pool->userData = userData;
+    pool->running = 1;
+    for (i = 0; i < ZRTP_CRYPTO_STREAMS; i++) {
+        pool->streams[i].flow = GST_FLOW_OK;
+        pool->streams[i].pushMutex = g_mutex_new();
+        pool->streams[i].mutex = g_mutex_new();
+        pool->streams[i].space = g_cond_new();
+    }
+
+    pool->workers = g_new0(ZrtpCryptoWorker, workers);
+    for (i = 0; i < workers; i++) {
+        ZrtpCryptoWorker* worker = &pool->workers[i];
+
+        worker->pool = pool;
+        worker->index = i;
+        worker->mutex = g_mutex_new();
+        worker->wakeup = g_cond_new();
+#if !GLIB_CHECK_VERSION (2, 31, 0)
+        worker->thread = g_thread_create(zrtp_crypto_worker_thread, worker, TRUE, &error);
+#else
+        worker->thread = g_thread_try_new("zrtp-crypto", zrtp_crypto_worker_thread, worker, &error);
+#endif
+        if (worker->thread == NULL) {
+            GST_ERROR("Cannot start SRTP crypto worker: %s", error->message);
+            g_error_free(error);
+            g_mutex_free(worker->mutex);
+            g_cond_free(worker->wakeup);
+            break;
+        }
+        pool->numWorkers++;
+    }
+    if (pool->numWorkers == 0) {
+        zrtp_crypto_pool_free(pool);
+        return NULL;
+    }
+    GST_DEBUG("Started %u SRTP crypto workers", pool->numWorkers);
+    return pool;
+}
+
+void
+zrtp_crypto_pool_free(ZrtpCryptoPool* pool)
+{
+    guint i;
+
+    if (pool == NULL)
+        return;
+
+    for (i = 0; i < ZRTP_CRYPTO_STREAMS; i++) {
+        if (pool->numWorkers > 0 && pool->streams[i].process != NULL)
+            zrtp_crypto_wait(&pool->streams[i], 0);
+    }
+
+    g_atomic_int_set(&pool->running, 0);
+    for (i = 0; i < pool->numWorkers; i++) {
+        zrtp_crypto_wakeup(&pool->workers[i]);
+        g_thread_join(pool->workers[i].thread);
+        g_mutex_free(pool->workers[i].mutex);
+        g_cond_free(pool->workers[i].wakeup);
+    }
+    for (i = 0; i < ZRTP_CRYPTO_STREAMS; i++) {
+        g_mutex_free(pool->streams[i].pushMutex);
+        g_mutex_free(pool->streams[i].mutex);
+        g_cond_free(pool->streams[i].space);
+    }
+    g_free(pool->workers);
+    g_free(pool);
+}
+
+guint
+zrtp_crypto_pool_workers(ZrtpCryptoPool* pool)
+{
+    return pool->numWorkers;
+}
+
+void
+zrtp_crypto_set_stream(ZrtpCryptoPool* pool, guint stream,
+                       ZrtpCryptoFunc process, ZrtpCryptoPushFunc push)
+{
+    g_return_if_fail(stream < ZRTP_CRYPTO_STREAMS);
+
+    pool->streams[stream].process = process;
+    pool->streams[stream].push = push;
+}
+
+GstFlowReturn
+zrtp_crypto_submit(ZrtpCryptoPool* pool, guint stream, guint32 ssrc, GstBuffer* gstBuf)
+{
+    ZrtpCryptoStream* s = &pool->streams[stream];
+    ZrtpCryptoWorker* worker;
+    ZrtpCryptoQueue* queue;
+    guint tail;
+
+    /* Keep the reorder slot of this packet free */
+    zrtp_crypto_wait(s, ZRTP_CRYPTO_DEPTH - 1);
+
+    worker = &pool->workers[((ssrc * 2654435761U) >> 16) % pool->numWorkers];
+    queue = &worker->queues[stream];
+
+    /* At most ZRTP_CRYPTO_DEPTH packets in flight, the queue cannot overflow */
+    tail = g_atomic_int_get(&queue->tail);
+    queue->items[tail & (ZRTP_CRYPTO_DEPTH - 1)].buffer = gstBuf;
+    queue->items[tail & (ZRTP_CRYPTO_DEPTH - 1)].seq = s->nextSeq++;
+    g_atomic_int_set(&queue->tail, tail + 1);
+
+    if (g_atomic_int_get(&worker->sleeping))
+        zrtp_crypto_wakeup(worker);
+
+    return (GstFlowReturn)g_atomic_int_get(&s->flow);
+}
+
+void
+zrtp_crypto_drain(ZrtpCryptoPool* pool, guint stream)
+{
+    zrtp_crypto_wait(&pool->streams[stream], 0);
+    g_atomic_int_set(&pool->streams[stream].flow, GST_FLOW_OK);
+}
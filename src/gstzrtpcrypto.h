@@ -0,0 +1,87 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_ZRTP_CRYPTO_H__
+#define __GST_ZRTP_CRYPTO_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Crypto worker pool of a filter.
+ *
+ * A stream is one direction of the filter, e.g. the RTP receive path. The
+ * streaming thread of a stream submits packets, the pool processes them in
+ * its worker threads and pushes them in submit order.
+ *
+ * - Sharding: the SSRC selects the worker, thus all packets of a SSRC run
+ *   on the same worker in order and each crypto context is used by one
+ *   thread only.
+ * - Each worker has one single producer/single consumer queue per stream,
+ *   the streaming thread is the producer. The queues are rings of fixed
+ *   size, submit does not allocate and takes no lock.
+ * - Reorder stage: every packet gets a sequence number of its stream. A
+ *   worker stores the processed packet in the reorder slot of its sequence
+ *   number, the worker that gets the push lock pushes all consecutive
+ *   finished packets. Thus packets of different SSRCs leave the pool in the
+ *   order they arrived.
+ *
+ * At most ZRTP_CRYPTO_DEPTH packets of a stream are in flight, submit
+ * blocks if the stream reached this limit. zrtp_crypto_drain() waits until
+ * all submitted packets of a stream are pushed, call it before serialized
+ * events to keep events and buffers in order.
+ */
+#define ZRTP_CRYPTO_MAX_WORKERS  16
+#define ZRTP_CRYPTO_STREAMS      2
+#define ZRTP_CRYPTO_DEPTH        256    /* must be a power of 2 */
+
+typedef struct _ZrtpCryptoPool ZrtpCryptoPool;
+
+/* Process a packet in worker thread worker, return the packet or NULL to drop it */
+typedef GstBuffer* (*ZrtpCryptoFunc)(gpointer userData, guint worker, GstBuffer* gstBuf);
+
+/* Push a processed packet downstream, called in submit order */
+typedef GstFlowReturn (*ZrtpCryptoPushFunc)(gpointer userData, GstBuffer* gstBuf);
+
+/* Create a pool and start its worker threads, NULL on failure */
+ZrtpCryptoPool* zrtp_crypto_pool_new(guint workers, gpointer userData);
+
+/* Drain all streams, stop the workers and free the pool */
+void zrtp_crypto_pool_free(ZrtpCryptoPool* pool);
+
+guint zrtp_crypto_pool_workers(ZrtpCryptoPool* pool);
+
+/* Set the functions of a stream, before the first submit */
+void zrtp_crypto_set_stream(ZrtpCryptoPool* pool, guint stream,
+                            ZrtpCryptoFunc process, ZrtpCryptoPushFunc push);
+
+/*
+ * Hand a packet to the worker of its SSRC, only the streaming thread of the
+ * stream may call it. Returns the flow result of the last push of the stream.
+ */
+GstFlowReturn zrtp_crypto_submit(ZrtpCryptoPool* pool, guint stream, guint32 ssrc, GstBuffer* gstBuf);
+
+/* Wait until all submitted packets of the stream are pushed, resets the flow result */
+void zrtp_crypto_drain(ZrtpCryptoPool* pool, guint stream);
+
+G_END_DECLS
+
+#endif /* __GST_ZRTP_CRYPTO_H__ */
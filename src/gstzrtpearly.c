@@ -0,0 +1,178 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "gstzrtpearly.h"
+#include "gstzrtpstats.h"
+
+void
+zrtp_early_init(ZrtpEarlyRing* ring, guint capacity, guint maxAge)
+{
+    ring->buffers = NULL;
+    ring->arrival = NULL;
+    ring->capacity = 0;
+    ring->head = 0;
+    ring->count = 0;
+    ring->hold = FALSE;
+    ring->maxAge = (guint64)maxAge * G_GUINT64_CONSTANT(1000000);
+    ring->mutex = g_mutex_new();
+    ring->replayMutex = g_mutex_new();
+
+    if (capacity == 0)
+        return;
+
+    ring->buffers = g_new0(GstBuffer*, capacity);
+    ring->arrival = g_new0(guint64, capacity);
+    ring->capacity = capacity;
+}
+
+void
+zrtp_early_free(ZrtpEarlyRing* ring)
+{
+    if (ring->mutex == NULL)
+        return;
+
+    zrtp_early_clear(ring);
+    g_free(ring->buffers);
+    g_free(ring->arrival);
+    ring->buffers = NULL;
+    ring->arrival = NULL;
+    ring->capacity = 0;
+    g_mutex_free(ring->mutex);
+    g_mutex_free(ring->replayMutex);
+    ring->mutex = NULL;
+    ring->replayMutex = NULL;
+}
+
+/* Remove the oldest packet, the caller holds the mutex */
+static GstBuffer*
+zrtp_early_take(ZrtpEarlyRing* ring, guint64* arrival)
+{
+    GstBuffer* gstBuf = ring->buffers[ring->head];
+
+    *arrival = ring->arrival[ring->head];
+    ring->buffers[ring->head] = NULL;
+    ring->head = (ring->head + 1) % ring->capacity;
+    g_atomic_int_add(&ring->count, -1);
+    return gstBuf;
+}
+
+guint
+zrtp_early_push(ZrtpEarlyRing* ring, GstBuffer* gstBuf, guint64 now)
+{
+    guint64 arrival;
+    guint dropped = 0;
+    guint tail;
+
+    g_mutex_lock(ring->mutex);
+    if (ring->capacity == 0) {
+        g_mutex_unlock(ring->mutex);
+        gst_buffer_unref(gstBuf);
+        return 1;
+    }
+    if ((guint)ring->count == ring->capacity) {
+        gst_buffer_unref(zrtp_early_take(ring, &arrival));
+        dropped++;
+    }
+    tail = (ring->head + ring->count) % ring->capacity;
+    ring->buffers[tail] = gstBuf;
+    ring->arrival[tail] = now;
+    g_atomic_int_add(&ring->count, 1);
+    g_mutex_unlock(ring->mutex);
+
+    return dropped;
+}
+
+GstBuffer*
+zrtp_early_pop(ZrtpEarlyRing* ring, guint64 now, guint* dropped)
+{
+    GstBuffer* gstBuf = NULL;
+    guint64 arrival;
+
+    g_mutex_lock(ring->mutex);
+    while (ring->count > 0) {
+        gstBuf = zrtp_early_take(ring, &arrival);
+        if (ring->maxAge == 0 || now - arrival <= ring->maxAge)
+            break;
+        gst_buffer_unref(gstBuf);
+        gstBuf = NULL;
+        (*dropped)++;
+    }
+    g_mutex_unlock(ring->mutex);
+
+    return gstBuf;
+}
+
+void
+zrtp_early_clear(ZrtpEarlyRing* ring)
+{
+    guint64 arrival;
+
+    if (ring->mutex == NULL)
+        return;
+
+    g_mutex_lock(ring->mutex);
+    while (ring->count > 0)
+        gst_buffer_unref(zrtp_early_take(ring, &arrival));
+    g_mutex_unlock(ring->mutex);
+}
+
+GstFlowReturn
+zrtp_early_flush(ZrtpEarlyRing* ring, ZrtpEarlyPushFunc replay, gpointer data, guint* dropped)
+{
+    GstFlowReturn rc = GST_FLOW_OK;
+    GstFlowReturn prc;
+    GstBuffer* held;
+    guint64 now = zrtp_stats_now();
+
+    if (ring->replayMutex == NULL)
+        return GST_FLOW_OK;
+
+    g_mutex_lock(ring->replayMutex);
+    while ((held = zrtp_early_pop(ring, now, dropped)) != NULL) {
+        prc = replay(data, held);
+        if (rc == GST_FLOW_OK)
+            rc = prc;
+    }
+    g_mutex_unlock(ring->replayMutex);
+    return rc;
+}
+
+GstFlowReturn
+zrtp_early_process(ZrtpEarlyRing* ring, gboolean ready, ZrtpEarlyPushFunc replay,
+                   ZrtpEarlyPushFunc push, gpointer data, GstBuffer* gstBuf,
+                   guint* dropped)
+{
+    GstFlowReturn rc;
+    GstFlowReturn prc;
+
+    if (g_atomic_int_get(&ring->hold) && !ready) {
+        *dropped += zrtp_early_push(ring, gstBuf, zrtp_stats_now());
+        return GST_FLOW_OK;
+    }
+
+    /* Waits for a replay of the engine, the new packet follows the held ones */
+    rc = zrtp_early_flush(ring, replay, data, dropped);
+    prc = push(data, gstBuf);
+    return rc == GST_FLOW_OK ? prc : rc;
+}
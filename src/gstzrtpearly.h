@@ -0,0 +1,116 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_ZRTP_EARLY_H__
+#define __GST_ZRTP_EARLY_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Early media ring buffer.
+ *
+ * While the ZRTP handshake runs the filter holds the RTP packets of a
+ * direction in a ring instead of passing them in the clear. When ZRTP
+ * installs the SRTP contexts of the direction the filter replays the held
+ * packets in their original order through protect or unprotect, and drops
+ * held received packets that fail to authenticate. The ZRTP engine replays
+ * the held packets when it installs the context or stops holding, else the
+ * next packet of the direction does.
+ *
+ * The ring stores buffer references only, its arrays are allocated once in
+ * zrtp_early_init(). If the ring is full a new packet replaces the oldest
+ * one, packets older than the maximum age are dropped when the ring
+ * releases them. The streaming thread of the direction pushes, the mutex
+ * guards the ring against pops and zrtp_early_clear() from other threads.
+ * The replay mutex keeps a replay of the engine and of the streaming thread
+ * apart, thus the held packets leave in order before the next packet.
+ */
+#define ZRTP_EARLY_MAX_PACKETS   4096
+#define ZRTP_EARLY_DEFAULT_TIME  500        /* milliseconds */
+
+typedef struct _ZrtpEarlyRing {
+    GstBuffer** buffers;
+    guint64* arrival;           /* monotonic time in ns */
+    guint capacity;
+    guint head;                 /* index of the oldest packet */
+    volatile gint count;
+    volatile gint hold;         /* hold packets, handshake in progress */
+    guint64 maxAge;             /* ns, 0 for no limit */
+    GMutex* mutex;
+    GMutex* replayMutex;
+} ZrtpEarlyRing;
+
+/* Allocate a ring for capacity packets, maxAge in milliseconds, 0 disables it */
+void zrtp_early_init(ZrtpEarlyRing* ring, guint capacity, guint maxAge);
+
+/* Release all held packets and the ring arrays */
+void zrtp_early_free(ZrtpEarlyRing* ring);
+
+/* Take over the buffer, returns the number of packets dropped to make room */
+guint zrtp_early_push(ZrtpEarlyRing* ring, GstBuffer* gstBuf, guint64 now);
+
+/* Return the oldest packet that is not too old, NULL if the ring is empty.
+ * Adds the number of dropped old packets to dropped.
+ */
+GstBuffer* zrtp_early_pop(ZrtpEarlyRing* ring, guint64 now, guint* dropped);
+
+/* Drop all held packets */
+void zrtp_early_clear(ZrtpEarlyRing* ring);
+
+typedef GstFlowReturn (*ZrtpEarlyPushFunc)(gpointer data, GstBuffer* gstBuf);
+
+/* Pass the held packets to replay in order, returns the first error. Adds
+ * the number of packets dropped as too old to dropped.
+ */
+GstFlowReturn zrtp_early_flush(ZrtpEarlyRing* ring, ZrtpEarlyPushFunc replay, gpointer data,
+                               guint* dropped);
+
+/* Hold gstBuf if the ring holds and the direction is not ready. Otherwise
+ * pass the held packets to replay, then gstBuf to push, returns the first
+ * error. Adds the number of dropped packets to dropped.
+ */
+GstFlowReturn zrtp_early_process(ZrtpEarlyRing* ring, gboolean ready, ZrtpEarlyPushFunc replay,
+                                 ZrtpEarlyPushFunc push, gpointer data, GstBuffer* gstBuf,
+                                 guint* dropped);
+
+static inline gboolean
+zrtp_early_enabled(ZrtpEarlyRing* ring)
+{
+    return ring->capacity > 0;
+}
+
+/* TRUE if the direction holds packets or has held packets to replay */
+static inline gboolean
+zrtp_early_active(ZrtpEarlyRing* ring)
+{
+    return g_atomic_int_get(&ring->hold) || g_atomic_int_get(&ring->count) > 0;
+}
+
+static inline void
+zrtp_early_set_hold(ZrtpEarlyRing* ring, gboolean hold)
+{
+    g_atomic_int_set(&ring->hold, hold && ring->capacity > 0);
+}
+
+G_END_DECLS
+
+#endif /* __GST_ZRTP_EARLY_H__ */
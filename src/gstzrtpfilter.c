@@ -87,6 +87,50 @@
  * </para>
  * </note>
  * </refsect2>
+ * <refsect2>
+ * <title>Many filters per process</title>
+ * <para>
+ * The filter creates its ZRTP engine and the engine mutexes when the
+ * application initializes ZRTP or sets the multi-stream parameters, and its
+ * SRTP contexts come from the GLib slice allocator. A filter that a media
+ * server creates for a call leg and has not started yet thus only holds its
+ * instance structure and pads.
+ * </para>
+ * <para>
+ * The construct-only property @slim also removes the four RTCP pads. A slim
+ * filter creates them on request of the templates recv_rtcp_sink_%u and
+ * send_rtcp_sink_%u, one pad per direction. The pads keep the names
+ * recv_rtcp_sink and send_rtcp_sink, requesting a sink pad also creates its
+ * recv_rtcp_src or send_rtcp_src pad and releasing it removes both. Other
+ * filters have the four RTCP pads always, as before. Create a slim filter with
+ * <code>g_object_new(GST_TYPE_ZRTPFILTER, "slim", TRUE, NULL)</code> or
+ * gst_element_factory_make_full(). The benchmark in bench/srtpBench.c prints
+ * the heap memory per filter with and without @slim.
+ * </para>
+ * </refsect2>
+ * <refsect2>
+ * <title>Demultiplexing</title>
+ * <para>
+ * The filter classifies each packet of recv_rtp_sink by its first byte as
+ * RFC 7983 describes, it does not map the buffer for this. RTP goes the SRTP
+ * path, ZRTP goes to the ZRTP engine or is dropped if ZRTP is disabled. If
+ * @rtcp-mux is set, RTCP packets on the RTP port (RFC 5761) are unprotected
+ * with the SRTCP context and leave via recv_rtcp_src, or via recv_rtp_src if
+ * the filter has no RTCP pads. STUN, DTLS and other packets leave via the
+ * request pad recv_other_src, or are dropped and counted as dropped-non-zrtp
+ * if the application did not request it.
+ * </para>
+ * </refsect2>
+ * <refsect2>
+ * <title>Tracing</title>
+ * <para>
+ * If the build finds sys/sdt.h the filter has USDT probes of provider
+ * "gstzrtp" in the chain functions, around SRTP protect and unprotect and
+ * for each received and sent ZRTP packet. Tools like bpftrace attach to the
+ * probes of a running process, the probes cost almost nothing while no tracer
+ * is attached. gstzrtptrace.h lists the probes and their arguments.
+ * </para>
+ * </refsect2>
  */
 
 #ifdef HAVE_CONFIG_H
@@ -99,6 +143,9 @@
 #include <gst/rtp/gstrtpbuffer.h>
 
 #include "gstzrtpfilter.h"
+#include "gstzrtpbin.h"
+#include "gstzrtpcrc.h"
+#include "gstzrtptrace.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_zrtp_filter_debug);
 #define GST_CAT_DEFAULT gst_zrtp_filter_debug
@@ -130,12 +177,39 @@ enum {
     PROP_MULTI_PARAM,
     PROP_IS_MULTI,
     PROP_MULTI_AVAILABLE,
+    PROP_SRTP_AEAD,
+    PROP_MAX_SSRC,
+    PROP_STATS,
+    PROP_ASYNC_ZRTP,
+    PROP_PUBKEY_ALGOS,
+    PROP_KEY_AGREEMENT,
+    PROP_RS_MATCHED,
+    PROP_EARLY_PACKETS,
+    PROP_EARLY_TIME,
+    PROP_ERROR_INTERVAL,
+    PROP_ERROR_SIGNALS,
+    PROP_CRYPTO_WORKERS,
+    PROP_SRTP_META,
+    PROP_SRTP_AUTH_ONLY,
+    PROP_SLIM,
+    PROP_REPLAY_WINDOW,
+    PROP_RTCP_MUX,
     PROP_LAST,
 };
 
 #define GST_ZRTP_LOCK(sess)   g_mutex_lock ((sess)->zrtpMutex)
 #define GST_ZRTP_UNLOCK(sess) g_mutex_unlock ((sess)->zrtpMutex)
 
+#define ZRTP_ERROR_DEFAULT_INTERVAL 1000    /* milliseconds */
+
+/* Streams of the crypto worker pool */
+#define ZRTP_CRYPTO_RECV 0
+#define ZRTP_CRYPTO_SEND 1
+
+#if !GST_CHECK_VERSION(1,0,0)
+#define gst_buffer_get_size(buf) GST_BUFFER_SIZE(buf)
+#endif
+
 
 /* the capabilities of the inputs and outputs.
  * 
@@ -170,6 +244,42 @@ static GstStaticPadTemplate zrtp_recv_rtp_src_template =
                              );
 
 
+/* The RTCP pads of a slim filter, see the section doc */
+static GstStaticPadTemplate zrtp_recv_rtcp_sink_slim_template =
+    GST_STATIC_PAD_TEMPLATE ("recv_rtcp_sink_%u",
+                             GST_PAD_SINK,
+                             GST_PAD_REQUEST,
+                             GST_STATIC_CAPS ("ANY")
+                             );
+
+static GstStaticPadTemplate zrtp_recv_rtcp_src_slim_template =
+    GST_STATIC_PAD_TEMPLATE ("recv_rtcp_src_%u",
+                             GST_PAD_SRC,
+                             GST_PAD_SOMETIMES,
+                             GST_STATIC_CAPS ("ANY")
+                             );
+
+static GstStaticPadTemplate zrtp_send_rtcp_sink_slim_template =
+    GST_STATIC_PAD_TEMPLATE ("send_rtcp_sink_%u",
+                             GST_PAD_SINK,
+                             GST_PAD_REQUEST,
+                             GST_STATIC_CAPS ("ANY")
+                             );
+
+static GstStaticPadTemplate zrtp_send_rtcp_src_slim_template =
+    GST_STATIC_PAD_TEMPLATE ("send_rtcp_src_%u",
+                             GST_PAD_SRC,
+                             GST_PAD_SOMETIMES,
+                             GST_STATIC_CAPS ("ANY")
+                             );
+
+static GstStaticPadTemplate zrtp_recv_other_src_template =
+    GST_STATIC_PAD_TEMPLATE ("recv_other_src",
+                             GST_PAD_SRC,
+                             GST_PAD_REQUEST,
+                             GST_STATIC_CAPS ("ANY")
+                             );
+
 static GstStaticPadTemplate zrtp_send_rtcp_sink_template =
     GST_STATIC_PAD_TEMPLATE ("send_rtcp_sink",
                              GST_PAD_SINK,
@@ -206,10 +316,20 @@ G_DEFINE_TYPE(GstZrtpFilter, gst_zrtp_filter, GST_TYPE_ELEMENT)
 GST_BOILERPLATE (GstZrtpFilter, gst_zrtp_filter, GstElement, GST_TYPE_ELEMENT);
 #endif
 
+static void gst_zrtp_filter_constructed (GObject * object);
 static void gst_zrtp_filter_finalize (GObject * object);
 static void gst_zrtp_filter_set_property (GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec);
 static void gst_zrtp_filter_get_property (GObject * object, guint prop_id, GValue * value, GParamSpec * pspec);
 
+#if GST_CHECK_VERSION(1,0,0)
+static GstPad* gst_zrtp_filter_request_new_pad (GstElement * element, GstPadTemplate * templ,
+                                                const gchar * name, const GstCaps * caps);
+#else
+static GstPad* gst_zrtp_filter_request_new_pad (GstElement * element, GstPadTemplate * templ,
+                                                const gchar * name);
+#endif
+static void gst_zrtp_filter_release_pad (GstElement * element, GstPad * pad);
+
 // static gboolean gst_zrtp_filter_set_caps (GstPad * pad, GstCaps * caps);
 
 #if GST_CHECK_VERSION(1,0,0)
@@ -217,11 +337,20 @@ static GstFlowReturn gst_zrtp_filter_chain_rtp_up    (GstPad * pad, GstObject *
 static GstFlowReturn gst_zrtp_filter_chain_rtp_down  (GstPad * pad, GstObject * parent, GstBuffer * buf);
 static GstFlowReturn gst_zrtp_filter_chain_rtcp_up   (GstPad * pad, GstObject * parent, GstBuffer * buf);
 static GstFlowReturn gst_zrtp_filter_chain_rtcp_down (GstPad * pad, GstObject * parent, GstBuffer * buf);
+
+static GstFlowReturn gst_zrtp_filter_chain_list_rtp_up    (GstPad * pad, GstObject * parent, GstBufferList * list);
+static GstFlowReturn gst_zrtp_filter_chain_list_rtp_down  (GstPad * pad, GstObject * parent, GstBufferList * list);
+static GstFlowReturn gst_zrtp_filter_chain_list_rtcp_up   (GstPad * pad, GstObject * parent, GstBufferList * list);
+static GstFlowReturn gst_zrtp_filter_chain_list_rtcp_down (GstPad * pad, GstObject * parent, GstBufferList * list);
+
+static gboolean gst_zrtp_filter_send_query (GstPad * pad, GstObject * parent, GstQuery * query);
+static gboolean gst_zrtp_filter_rtp_event (GstPad * pad, GstObject * parent, GstEvent * event);
 #else
 static GstFlowReturn gst_zrtp_filter_chain_rtp_up    (GstPad * pad, GstBuffer * buf);
 static GstFlowReturn gst_zrtp_filter_chain_rtp_down  (GstPad * pad, GstBuffer * buf);
 static GstFlowReturn gst_zrtp_filter_chain_rtcp_up   (GstPad * pad, GstBuffer * buf);
 static GstFlowReturn gst_zrtp_filter_chain_rtcp_down (GstPad * pad, GstBuffer * buf);
+static gboolean gst_zrtp_filter_rtp_event (GstPad * pad, GstEvent * event);
 #endif
 
 
@@ -229,9 +358,12 @@ static GstFlowReturn gst_zrtp_filter_chain_rtcp_down (GstPad * pad, GstBuffer *
                               1234567890123456   */
 static gchar clientId[] =    "GST ZRTP 3.0.0  ";
 
+static ZrtpContext* zrtp_filter_engine(GstZrtpFilter* filter);
 static gboolean zrtp_initialize(GstZrtpFilter* filter, const gchar *zidFilename, gboolean autoEnable);
 static void zrtp_filter_startZrtp(GstZrtpFilter *zrtp);
 static void zrtp_filter_stopZrtp(GstZrtpFilter *zrtp);
+static void zrtp_filter_timeout(gpointer userData);
+static void zrtp_filter_report_errors(gpointer userData);
 
 /* Forward declaration of the ZRTP specific callback functions that this
    adapter must implement */
@@ -491,11 +623,17 @@ gst_zrtp_filter_base_init(gpointer gclass)
     gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_recv_rtp_src_template));
     gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_send_rtp_sink_template));
     gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_send_rtp_src_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_recv_other_src_template));
 
     gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_recv_rtcp_sink_template));
     gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_recv_rtcp_src_template));
     gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_send_rtcp_sink_template));
     gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_send_rtcp_src_template));
+
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_recv_rtcp_sink_slim_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_recv_rtcp_src_slim_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_send_rtcp_sink_slim_template));
+    gst_element_class_add_pad_template (element_class, gst_static_pad_template_get (&zrtp_send_rtcp_src_slim_template));
 }
 
 /* initialize the zrtpfilter's class */
@@ -503,19 +641,23 @@ static void
 gst_zrtp_filter_class_init(GstZrtpFilterClass * klass)
 {
     GObjectClass *gobject_class;
-    //    GstElementClass *gstelement_class;
+    GstElementClass *gstelement_class;
 
     gobject_class = (GObjectClass *) klass;
-    //    gstelement_class = (GstElementClass *) klass;
+    gstelement_class = (GstElementClass *) klass;
 
 #if GST_CHECK_VERSION(1,0,0)
     gst_zrtp_filter_base_init(klass);
 #endif
 
+    gobject_class->constructed = gst_zrtp_filter_constructed;
     gobject_class->finalize = gst_zrtp_filter_finalize;
     gobject_class->set_property = gst_zrtp_filter_set_property;
     gobject_class->get_property = gst_zrtp_filter_get_property;
 
+    gstelement_class->request_new_pad = GST_DEBUG_FUNCPTR(gst_zrtp_filter_request_new_pad);
+    gstelement_class->release_pad = GST_DEBUG_FUNCPTR(gst_zrtp_filter_release_pad);
+
     g_object_class_install_property(gobject_class, PROP_ENABLE_ZRTP,
                                     g_param_spec_boolean ("enable", "Enable", "Enable ZRTP processing.",
                                                           FALSE, G_PARAM_READWRITE));
@@ -558,6 +700,117 @@ gst_zrtp_filter_class_init(GstZrtpFilterClass * klass)
                                     g_param_spec_boolean("multi-available", "MultiAvailable",
                                                          "Check if master session supports multi-stream mode.",
                                                           FALSE, G_PARAM_READABLE));
+
+    g_object_class_install_property(gobject_class, PROP_SRTP_AEAD,
+                                    g_param_spec_boolean("srtp-aead", "SrtpAead",
+                                                         "Use AES-GCM (RFC 7714) SRTP if ZRTP negotiated AES.",
+                                                          FALSE, G_PARAM_READWRITE));
+
+    /* ZRTP has no NULL cipher, both peers must set it out of band */
+    g_object_class_install_property(gobject_class, PROP_SRTP_AUTH_ONLY,
+                                    g_param_spec_boolean("srtp-auth-only", "SrtpAuthOnly",
+                                                         "Authenticate SRTP/SRTCP with the NULL cipher, no encryption. For trusted networks only.",
+                                                          FALSE, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_MAX_SSRC,
+                                    g_param_spec_uint("max-ssrc", "MaxSSRC",
+                                                      "Maximum number of remote SSRCs with own crypto contexts.",
+                                                      1, ZRTP_SSRC_TABLE_MAX_SIZE, ZRTP_SSRC_TABLE_DEFAULT_SIZE,
+                                                      G_PARAM_READWRITE));
+
+    /* Packets that arrive later than the window are dropped as replays,
+     * applies to SRTP contexts created afterwards
+     */
+    g_object_class_install_property(gobject_class, PROP_REPLAY_WINDOW,
+                                    g_param_spec_uint("replay-window", "ReplayWindow",
+                                                      "Size of the SRTP replay window in packets, rounded up to a multiple of 64.",
+                                                      ZSRTP_DEFAULT_REPLAY_WINDOW, ZSRTP_MAX_REPLAY_WINDOW,
+                                                      ZSRTP_DEFAULT_REPLAY_WINDOW, G_PARAM_READWRITE));
+
+    /* Muxed RTCP leaves via recv_rtcp_src if the pad exists, via recv_rtp_src otherwise */
+    g_object_class_install_property(gobject_class, PROP_RTCP_MUX,
+                                    g_param_spec_boolean("rtcp-mux", "RtcpMux",
+                                                         "Demultiplex and unprotect RTCP packets received on the RTP sink pad (RFC 5761).",
+                                                          FALSE, G_PARAM_READWRITE));
+
+    /* A GstStructure with packet and byte counters per direction, SRTP error
+     * counters, ZRTP counters, the handshake duration in ns and the
+     * protect/unprotect time histograms, see gstzrtpstats.h.
+     */
+    g_object_class_install_property(gobject_class, PROP_STATS,
+                                    g_param_spec_boxed("stats", "Statistics", "Statistics of the ZRTP filter.",
+                                                       GST_TYPE_STRUCTURE, G_PARAM_READABLE));
+
+    g_object_class_install_property(gobject_class, PROP_ASYNC_ZRTP,
+                                    g_param_spec_boolean("async-zrtp", "AsyncZrtp",
+                                                         "Process received ZRTP messages in a shared worker pool.",
+                                                          FALSE, G_PARAM_READWRITE));
+
+    /* Set before "initialize", e.g. "E255,EC25,DH3k" offers the fast Curve25519 first */
+    g_object_class_install_property(gobject_class, PROP_PUBKEY_ALGOS,
+                                    g_param_spec_string("pubkey-algorithms", "PubKeyAlgorithms",
+                                                        "Preferred ZRTP key agreement algorithms, comma separated.",
+                                                        NULL, G_PARAM_READWRITE));
+
+    /* The filter notifies key-agreement when the session enters secure state */
+    g_object_class_install_property(gobject_class, PROP_KEY_AGREEMENT,
+                                    g_param_spec_string("key-agreement", "KeyAgreement",
+                                                        "Negotiated key agreement: DH3k, EC25, E255, ... or Mult.",
+                                                        NULL, G_PARAM_READABLE));
+
+    g_object_class_install_property(gobject_class, PROP_RS_MATCHED,
+                                    g_param_spec_boolean("rs-matched", "RsMatched",
+                                                         "A retained shared secret of a previous call matched.",
+                                                          FALSE, G_PARAM_READABLE));
+
+    /* Held packets are replayed through SRTP once the direction is secure,
+     * held received packets that fail to authenticate are dropped. If the
+     * handshake fails they pass in the clear as without holding.
+     */
+    g_object_class_install_property(gobject_class, PROP_EARLY_PACKETS,
+                                    g_param_spec_uint("early-media-packets", "EarlyMediaPackets",
+                                                      "Hold up to this many RTP packets per direction during the ZRTP handshake, 0 disables holding.",
+                                                      0, ZRTP_EARLY_MAX_PACKETS, 0, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_EARLY_TIME,
+                                    g_param_spec_uint("early-media-time", "EarlyMediaTime",
+                                                      "Maximum age of held RTP packets in milliseconds, 0 for no limit.",
+                                                      0, G_MAXUINT, ZRTP_EARLY_DEFAULT_TIME, G_PARAM_READWRITE));
+
+    /* The filter posts an element message "zrtp-srtp-errors" with the SRTP
+     * and SRTCP authentication and replay errors of the last interval, only
+     * if there were errors. The timer wheel thread posts it, not the
+     * streaming threads.
+     */
+    g_object_class_install_property(gobject_class, PROP_ERROR_INTERVAL,
+                                    g_param_spec_uint("srtp-error-interval", "SrtpErrorInterval",
+                                                      "Interval in milliseconds of the SRTP error messages, 0 disables them.",
+                                                      0, G_MAXUINT, ZRTP_ERROR_DEFAULT_INTERVAL, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_ERROR_SIGNALS,
+                                    g_param_spec_boolean("srtp-error-signals", "SrtpErrorSignals",
+                                                         "Emit a status signal for each SRTP authentication or replay error.",
+                                                          FALSE, G_PARAM_READWRITE));
+
+    /* The SSRC of a RTP packet selects its worker, packets leave the filter
+     * in arrival order. Set it before ZRTP starts.
+     */
+    g_object_class_install_property(gobject_class, PROP_CRYPTO_WORKERS,
+                                    g_param_spec_uint("crypto-workers", "CryptoWorkers",
+                                                      "Number of threads for SRTP processing of RTP packets, 0 processes them in the streaming threads.",
+                                                      0, ZRTP_CRYPTO_MAX_WORKERS, 0, G_PARAM_READWRITE));
+
+    /* See gstzrtpmeta.h, applies to crypto contexts created afterwards */
+    g_object_class_install_property(gobject_class, PROP_SRTP_META,
+                                    g_param_spec_boolean("srtp-meta", "SrtpMeta",
+                                                         "Attach a GstZrtpSrtpMeta with the RTP header fields and the SRTP index to SRTP processed RTP buffers.",
+                                                          FALSE, G_PARAM_READWRITE));
+
+    /* Set it with g_object_new() or gst_element_factory_make_full(), see the section doc */
+    g_object_class_install_property(gobject_class, PROP_SLIM,
+                                    g_param_spec_boolean("slim", "Slim",
+                                                         "Create the RTCP pads only on request, for applications with many filters.",
+                                                          FALSE, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
     /**
      * GstZrtpFilter::status:
      * @zrtpfilter: the zrtpfilter instance
@@ -704,19 +957,41 @@ static void
 gst_zrtp_filter_init(GstZrtpFilter * filter, GstZrtpFilterClass * gclass)
 #endif
 {
-    /* At first initialize the non-pad stuff  */
-    /* Create the empty wrapper */
-    filter->zrtpCtx = zrtp_CreateWrapper();
+    /* At first initialize the non-pad stuff, zrtp_filter_engine() creates the
+     * ZRTP wrapper and the mutexes on first use
+     */
+    filter->zrtpCtx = NULL;
     filter->clientIdString = clientId;    /* Set standard name */
     filter->cacheName = NULL;
+    filter->pubKeyAlgos = NULL;
+    filter->keyAgreement = NULL;
+    filter->rsMatched = FALSE;
     filter->zrtpSeq = 1;                  /* TODO: randomize */
-    filter->zrtpMutex = g_mutex_new();
-    filter->sysclock = gst_system_clock_obtain();
+    zrtp_timer_init(&filter->timer, zrtp_filter_timeout, filter);
+    zrtp_timer_init(&filter->reportTimer, zrtp_filter_report_errors, filter);
+    filter->errorInterval = ZRTP_ERROR_DEFAULT_INTERVAL;
+    filter->errorSignals = FALSE;
+    filter->srtpMeta = FALSE;
     filter->mitmMode = FALSE;
+    filter->srtpAead = FALSE;
+    filter->srtpAuthOnly = FALSE;
+    filter->maxSsrc = ZRTP_SSRC_TABLE_DEFAULT_SIZE;
+    filter->replayWindow = ZSRTP_DEFAULT_REPLAY_WINDOW;
+    filter->asyncZrtp = FALSE;
+    filter->asyncScheduled = FALSE;
+    g_queue_init(&filter->asyncQueue);
+    filter->earlyPackets = 0;
+    filter->earlyTime = ZRTP_EARLY_DEFAULT_TIME;
+    filter->cryptoPool = NULL;
+    filter->cryptoWorkers = 0;
+    filter->recvGeneration = 0;
     filter->localSSRC = 0;
     filter->peerSSRC = 0;
     filter->gotMultiParam = FALSE;
     filter->masterCtx = NULL;
+    filter->slim = FALSE;
+    filter->startMutex = g_mutex_new();
+    filter->srtcpRecvMutex = g_mutex_new();
 
     // TODO: caps setter, getter checks?
     // Initialize the receive (upstream) RTP data path
@@ -724,6 +999,10 @@ gst_zrtp_filter_init(GstZrtpFilter * filter, GstZrtpFilterClass * gclass)
     //     gst_pad_set_setcaps_function (filter->recv_rtp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_set_caps));
     //     gst_pad_set_getcaps_function (filter->recv_rtp_sink, GST_DEBUG_FUNCPTR(gst_pad_proxy_getcaps));
     gst_pad_set_chain_function   (filter->recv_rtp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_chain_rtp_up));
+    gst_pad_set_event_function   (filter->recv_rtp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_rtp_event));
+#if GST_CHECK_VERSION(1,0,0)
+    gst_pad_set_chain_list_function (filter->recv_rtp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_chain_list_rtp_up));
+#endif
 
     filter->recv_rtp_src = gst_pad_new_from_static_template (&zrtp_recv_rtp_src_template, "recv_rtp_src");
     //     gst_pad_set_getcaps_function (filter->recv_rtp_src, GST_DEBUG_FUNCPTR(gst_pad_proxy_getcaps));
@@ -737,38 +1016,183 @@ gst_zrtp_filter_init(GstZrtpFilter * filter, GstZrtpFilterClass * gclass)
     //     gst_pad_set_setcaps_function (filter->send_rtp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_set_caps));
     //     gst_pad_set_getcaps_function (filter->send_rtp_sink, GST_DEBUG_FUNCPTR(gst_pad_proxy_getcaps));
     gst_pad_set_chain_function   (filter->send_rtp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_chain_rtp_down));
+    gst_pad_set_event_function   (filter->send_rtp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_rtp_event));
+#if GST_CHECK_VERSION(1,0,0)
+    gst_pad_set_chain_list_function (filter->send_rtp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_chain_list_rtp_down));
+    gst_pad_set_query_function (filter->send_rtp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_send_query));
+#endif
 
     filter->send_rtp_src = gst_pad_new_from_static_template (&zrtp_send_rtp_src_template, "send_rtp_src");
     //     gst_pad_set_getcaps_function (filter->send_rtp_src, GST_DEBUG_FUNCPTR(gst_pad_proxy_getcaps));
 
     gst_element_add_pad (GST_ELEMENT (filter), filter->send_rtp_sink);
     gst_element_add_pad (GST_ELEMENT (filter), filter->send_rtp_src);
+}
+
+/* Create the RTCP sink and src pads of one direction, returns the sink pad */
+static GstPad*
+zrtp_filter_add_rtcp_pads(GstZrtpFilter* filter, gboolean recv)
+{
+    GstPad* sink;
+    GstPad* src;
+
+    if (recv) {
+        // Initialize the receive (upstream) RTCP data path
+        sink = gst_pad_new_from_static_template (filter->slim ? &zrtp_recv_rtcp_sink_slim_template :
+                                                 &zrtp_recv_rtcp_sink_template, "recv_rtcp_sink");
+        gst_pad_set_chain_function (sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_chain_rtcp_up));
+#if GST_CHECK_VERSION(1,0,0)
+        gst_pad_set_chain_list_function (sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_chain_list_rtcp_up));
+#endif
+        src = gst_pad_new_from_static_template (filter->slim ? &zrtp_recv_rtcp_src_slim_template :
+                                                &zrtp_recv_rtcp_src_template, "recv_rtcp_src");
+        GST_OBJECT_LOCK(filter);
+        filter->recv_rtcp_sink = sink;
+        filter->recv_rtcp_src = src;
+        GST_OBJECT_UNLOCK(filter);
+    }
+    else {
+        // Initialize the send (downstream) RTCP data path
+        sink = gst_pad_new_from_static_template (filter->slim ? &zrtp_send_rtcp_sink_slim_template :
+                                                 &zrtp_send_rtcp_sink_template, "send_rtcp_sink");
+        gst_pad_set_chain_function (sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_chain_rtcp_down));
+#if GST_CHECK_VERSION(1,0,0)
+        gst_pad_set_chain_list_function (sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_chain_list_rtcp_down));
+        gst_pad_set_query_function (sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_send_query));
+#endif
+        src = gst_pad_new_from_static_template (filter->slim ? &zrtp_send_rtcp_src_slim_template :
+                                                &zrtp_send_rtcp_src_template, "send_rtcp_src");
+        GST_OBJECT_LOCK(filter);
+        filter->send_rtcp_sink = sink;
+        filter->send_rtcp_src = src;
+        GST_OBJECT_UNLOCK(filter);
+    }
+    gst_element_add_pad (GST_ELEMENT (filter), sink);
+    gst_element_add_pad (GST_ELEMENT (filter), src);
+
+    /* Pads requested while the filter runs */
+    if (GST_STATE(filter) > GST_STATE_READY) {
+        gst_pad_set_active(src, TRUE);
+        gst_pad_set_active(sink, TRUE);
+    }
+    return sink;
+}
+
+/* Create the src pad for received packets that are neither RTP nor ZRTP */
+static GstPad*
+zrtp_filter_add_other_pad(GstZrtpFilter* filter)
+{
+    GstPad* src;
 
+    if (filter->recv_other_src != NULL) {
+        GST_WARNING_OBJECT(filter, "pad recv_other_src already exists");
+        return NULL;
+    }
+    src = gst_pad_new_from_static_template (&zrtp_recv_other_src_template, "recv_other_src");
+    gst_element_add_pad (GST_ELEMENT (filter), src);
+    if (GST_STATE(filter) > GST_STATE_READY)
+        gst_pad_set_active(src, TRUE);
+
+    GST_OBJECT_LOCK(filter);
+    filter->recv_other_src = src;
+    GST_OBJECT_UNLOCK(filter);
+    return src;
+}
 
-    // Initialize the receive (upstream) RTCP data path
-    filter->recv_rtcp_sink = gst_pad_new_from_static_template (&zrtp_recv_rtcp_sink_template, "recv_rtcp_sink");
-    //     gst_pad_set_setcaps_function (filter->recv_rtcp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_set_caps));
-    //     gst_pad_set_getcaps_function (filter->recv_rtcp_sink, GST_DEBUG_FUNCPTR(gst_pad_proxy_getcaps));
-    gst_pad_set_chain_function (filter->recv_rtcp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_chain_rtcp_up));
+/* The slim property is set now, a slim filter creates the RTCP pads on request */
+static void
+gst_zrtp_filter_constructed (GObject* object)
+{
+    GstZrtpFilter *filter = GST_ZRTPFILTER(object);
 
-    filter->recv_rtcp_src = gst_pad_new_from_static_template (&zrtp_recv_rtcp_src_template, "recv_rtcp_src");
-    //     gst_pad_set_getcaps_function (filter->recv_rtcp_src, GST_DEBUG_FUNCPTR(gst_pad_proxy_getcaps));
+    if (G_OBJECT_CLASS (parent_class)->constructed != NULL)
+        G_OBJECT_CLASS (parent_class)->constructed (object);
 
-    gst_element_add_pad (GST_ELEMENT (filter), filter->recv_rtcp_sink);
-    gst_element_add_pad (GST_ELEMENT (filter), filter->recv_rtcp_src);
+    if (!filter->slim) {
+        zrtp_filter_add_rtcp_pads(filter, TRUE);
+        zrtp_filter_add_rtcp_pads(filter, FALSE);
+    }
+}
 
+#if GST_CHECK_VERSION(1,0,0)
+static GstPad*
+gst_zrtp_filter_request_new_pad (GstElement * element, GstPadTemplate * templ,
+                                 const gchar * name, const GstCaps * caps)
+#else
+static GstPad*
+gst_zrtp_filter_request_new_pad (GstElement * element, GstPadTemplate * templ,
+                                 const gchar * name)
+#endif
+{
+    GstZrtpFilter *filter = GST_ZRTPFILTER(element);
+    const gchar* tmplName = GST_PAD_TEMPLATE_NAME_TEMPLATE(templ);
+    gboolean recv;
+
+    if (strcmp(tmplName, "recv_other_src") == 0)
+        return zrtp_filter_add_other_pad(filter);
+
+    /* Only a slim filter has RTCP request pads, the others have them always */
+    if (strcmp(tmplName, "recv_rtcp_sink_%u") == 0)
+        recv = TRUE;
+    else if (strcmp(tmplName, "send_rtcp_sink_%u") == 0)
+        recv = FALSE;
+    else
+        return NULL;
+
+    if (!filter->slim) {
+        GST_WARNING_OBJECT(filter, "%s is for slim filters only", tmplName);
+        return NULL;
+    }
 
-    // Initialize the send (downstream) RTCP data path
-    filter->send_rtcp_sink = gst_pad_new_from_static_template (&zrtp_send_rtcp_sink_template, "send_rtcp_sink");
-    //    gst_pad_set_setcaps_function (filter->send_rtcp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_set_caps));
-    //    gst_pad_set_getcaps_function (filter->send_rtcp_sink, GST_DEBUG_FUNCPTR(gst_pad_proxy_getcaps));
-    gst_pad_set_chain_function (filter->send_rtcp_sink, GST_DEBUG_FUNCPTR(gst_zrtp_filter_chain_rtcp_down));
+    if ((recv ? filter->recv_rtcp_sink : filter->send_rtcp_sink) != NULL) {
+        GST_WARNING_OBJECT(filter, "pad %s already exists", tmplName);
+        return NULL;
+    }
+    return zrtp_filter_add_rtcp_pads(filter, recv);
+}
 
-    filter->send_rtcp_src = gst_pad_new_from_static_template (&zrtp_send_rtcp_src_template, "send_rtcp_src");
-    //    gst_pad_set_getcaps_function (filter->send_rtcp_src, GST_DEBUG_FUNCPTR(gst_pad_proxy_getcaps));
+/* Releasing a RTCP sink pad also removes its src pad */
+static void
+gst_zrtp_filter_release_pad (GstElement * element, GstPad * pad)
+{
+    GstZrtpFilter *filter = GST_ZRTPFILTER(element);
+    GstPad* src;
+
+    /* The RTP receive chain takes a reference under the object lock */
+    if (pad == filter->recv_other_src) {
+        GST_OBJECT_LOCK(filter);
+        filter->recv_other_src = NULL;
+        GST_OBJECT_UNLOCK(filter);
+        gst_pad_set_active(pad, FALSE);
+        gst_element_remove_pad(element, pad);
+        return;
+    }
 
-    gst_element_add_pad (GST_ELEMENT (filter), filter->send_rtcp_sink);
-    gst_element_add_pad (GST_ELEMENT (filter), filter->send_rtcp_src);
+    if (pad == filter->recv_rtcp_sink)
+        src = filter->recv_rtcp_src;
+    else if (pad == filter->send_rtcp_sink)
+        src = filter->send_rtcp_src;
+    else
+        return;
+
+    /* Deactivating the sink pad waits for its chain function */
+    gst_pad_set_active(pad, FALSE);
+    gst_pad_set_active(src, FALSE);
+    if (pad == filter->recv_rtcp_sink) {
+        GST_OBJECT_LOCK(filter);
+        filter->recv_rtcp_sink = NULL;
+        filter->recv_rtcp_src = NULL;
+        GST_OBJECT_UNLOCK(filter);
+    }
+    else {
+        GST_OBJECT_LOCK(filter);
+        filter->send_rtcp_sink = NULL;
+        filter->send_rtcp_src = NULL;
+        GST_OBJECT_UNLOCK(filter);
+    }
+    gst_element_remove_pad(element, pad);
+    if (GST_PAD_PARENT(src) == element)
+        gst_element_remove_pad(element, src);
 }
 
 static void
@@ -792,6 +1216,68 @@ gst_zrtp_filter_set_property (GObject* object, guint prop_id,
         filter->mitmMode = g_value_get_boolean(value);
         GST_DEBUG("%s", filter->mitmMode ? "TRUE" : "FALSE");
         break;
+    case PROP_SRTP_AEAD:
+        filter->srtpAead = g_value_get_boolean(value);
+        if (filter->srtpAead && !zsrtp_hasAeadSupport()) {
+            GST_WARNING_OBJECT(filter, "AES-GCM not supported by crypto backend, using AES-CM.");
+            filter->srtpAead = FALSE;
+        }
+        break;
+    case PROP_SRTP_AUTH_ONLY:
+        filter->srtpAuthOnly = g_value_get_boolean(value);
+        break;
+    case PROP_SLIM:
+        filter->slim = g_value_get_boolean(value);
+        break;
+    case PROP_MAX_SSRC:
+        filter->maxSsrc = g_value_get_uint(value);
+        break;
+    case PROP_REPLAY_WINDOW:
+        filter->replayWindow = g_value_get_uint(value);
+        break;
+    case PROP_RTCP_MUX:
+        filter->rtcpMux = g_value_get_boolean(value);
+        break;
+    case PROP_ASYNC_ZRTP:
+        filter->asyncZrtp = g_value_get_boolean(value);
+        break;
+    case PROP_EARLY_PACKETS:
+        filter->earlyPackets = g_value_get_uint(value);
+        break;
+    case PROP_EARLY_TIME:
+        filter->earlyTime = g_value_get_uint(value);
+        break;
+    case PROP_ERROR_INTERVAL:
+        GST_OBJECT_LOCK(filter);
+        filter->errorInterval = g_value_get_uint(value);
+        GST_OBJECT_UNLOCK(filter);
+        /* Without an engine the timer is armed by zrtp_filter_startZrtp() */
+        if (filter->started && filter->zrtpCtx != NULL) {
+            if (filter->errorInterval > 0)
+                zrtp_timer_arm(&filter->reportTimer, filter->errorInterval);
+            else
+                zrtp_timer_cancel(&filter->reportTimer);
+        }
+        break;
+    case PROP_ERROR_SIGNALS:
+        filter->errorSignals = g_value_get_boolean(value);
+        break;
+    case PROP_CRYPTO_WORKERS:
+        filter->cryptoWorkers = g_value_get_uint(value);
+        break;
+    case PROP_SRTP_META:
+#if GST_CHECK_VERSION(1,0,0)
+        filter->srtpMeta = g_value_get_boolean(value);
+#else
+        if (g_value_get_boolean(value))
+            GST_WARNING_OBJECT(filter, "SRTP meta requires GStreamer 1.x.");
+#endif
+        break;
+    case PROP_PUBKEY_ALGOS:
+        g_free(filter->pubKeyAlgos);
+        filter->pubKeyAlgos = g_value_dup_string(value);
+        GST_DEBUG("'%s'", filter->pubKeyAlgos);
+        break;
     case PROP_CACHE_NAME:
         g_free(filter->cacheName);
         filter->cacheName = g_value_dup_string(value);
@@ -802,6 +1288,10 @@ gst_zrtp_filter_set_property (GObject* object, guint prop_id,
         zrtp_initialize(filter, filter->cacheName, g_value_get_boolean(value));
         break;
     case PROP_START:
+        if (filter->zrtpCtx == NULL) {
+            GST_WARNING_OBJECT(filter, "Cannot start ZRTP, the filter is not initialized.");
+            break;
+        }
         zrtp_filter_startZrtp(filter);
         break;
         /*        case PROP_STOP:
@@ -818,7 +1308,7 @@ gst_zrtp_filter_set_property (GObject* object, guint prop_id,
 
         GST_DEBUG("%p, length: %d", mspArr->data, mspArr->len);
         filter->masterCtx = (ZrtpContext*)mspArr->data;
-        zrtp_setMultiStrParams(filter->zrtpCtx, (char*)(mspArr->data + sizeof(filter->masterCtx)),
+        zrtp_setMultiStrParams(zrtp_filter_engine(filter), (char*)(mspArr->data + sizeof(filter->masterCtx)),
                                mspArr->len - (int32_t)sizeof(filter->masterCtx), filter->masterCtx );
         break;
     default:
@@ -845,6 +1335,67 @@ gst_zrtp_filter_get_property (GObject * object, guint prop_id,
     case PROP_MITM_MODE:
         g_value_set_boolean(value, filter->mitmMode);
         break;
+    case PROP_SRTP_AEAD:
+        g_value_set_boolean(value, filter->srtpAead);
+        break;
+    case PROP_SRTP_AUTH_ONLY:
+        g_value_set_boolean(value, filter->srtpAuthOnly);
+        break;
+    case PROP_SLIM:
+        g_value_set_boolean(value, filter->slim);
+        break;
+    case PROP_MAX_SSRC:
+        g_value_set_uint(value, filter->maxSsrc);
+        break;
+    case PROP_REPLAY_WINDOW:
+        g_value_set_uint(value, filter->replayWindow);
+        break;
+    case PROP_RTCP_MUX:
+        g_value_set_boolean(value, filter->rtcpMux);
+        break;
+    case PROP_ASYNC_ZRTP:
+        g_value_set_boolean(value, filter->asyncZrtp);
+        break;
+    case PROP_EARLY_PACKETS:
+        g_value_set_uint(value, filter->earlyPackets);
+        break;
+    case PROP_EARLY_TIME:
+        g_value_set_uint(value, filter->earlyTime);
+        break;
+    case PROP_ERROR_INTERVAL:
+        g_value_set_uint(value, filter->errorInterval);
+        break;
+    case PROP_ERROR_SIGNALS:
+        g_value_set_boolean(value, filter->errorSignals);
+        break;
+    case PROP_CRYPTO_WORKERS:
+        g_value_set_uint(value, filter->cryptoWorkers);
+        break;
+    case PROP_SRTP_META:
+        g_value_set_boolean(value, filter->srtpMeta);
+        break;
+    case PROP_PUBKEY_ALGOS:
+        g_value_set_string(value, filter->pubKeyAlgos);
+        break;
+    case PROP_KEY_AGREEMENT:
+        GST_OBJECT_LOCK(filter);
+        g_value_set_string(value, filter->keyAgreement);
+        GST_OBJECT_UNLOCK(filter);
+        break;
+    case PROP_RS_MATCHED:
+        g_value_set_boolean(value, filter->rsMatched);
+        break;
+    case PROP_STATS: {
+        GstStructure* stats = zrtp_stats_to_structure(&filter->stats);
+
+        GST_OBJECT_LOCK(filter);
+        if (filter->keyAgreement != NULL)
+            gst_structure_set(stats, "key-agreement", G_TYPE_STRING, filter->keyAgreement, NULL);
+        GST_OBJECT_UNLOCK(filter);
+        gst_structure_set(stats, "rs-matched", G_TYPE_BOOLEAN, filter->rsMatched, NULL);
+        g_value_take_boxed(value, stats);
+        break;
+    }
     case PROP_CACHE_NAME:
         g_value_set_string(value, filter->cacheName);
         break;
@@ -852,7 +1403,7 @@ gst_zrtp_filter_get_property (GObject * object, guint prop_id,
         g_value_set_boolean(value, filter->started);
         break;
     case PROP_MULTI_PARAM:
-        param = zrtp_getMultiStrParams(filter->zrtpCtx, &len);
+        param = filter->zrtpCtx != NULL ? zrtp_getMultiStrParams(filter->zrtpCtx, &len) : NULL;
         if (param == NULL) {
             g_value_set_boxed(value, g_byte_array_new()); /* Return empty byte array */
             break;
@@ -870,10 +1421,10 @@ gst_zrtp_filter_get_property (GObject * object, guint prop_id,
         g_free(param);
         break;
     case PROP_IS_MULTI:
-        g_value_set_boolean(value, zrtp_isMultiStream(filter->zrtpCtx));
+        g_value_set_boolean(value, filter->zrtpCtx != NULL && zrtp_isMultiStream(filter->zrtpCtx));
         break;
     case PROP_MULTI_AVAILABLE:
-        g_value_set_boolean(value, zrtp_isMultiStreamAvailable(filter->zrtpCtx));
+        g_value_set_boolean(value, filter->zrtpCtx != NULL && zrtp_isMultiStreamAvailable(filter->zrtpCtx));
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -887,6 +1438,8 @@ gst_zrtp_filter_finalize (GObject* object)
     GstZrtpFilter *zrtp = GST_ZRTPFILTER(object);
 
     zrtp_filter_stopZrtp(zrtp);
+    g_mutex_free (zrtp->startMutex);
+    g_mutex_free (zrtp->srtcpRecvMutex);
 
     G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -908,15 +1461,158 @@ gst_zrtp_filter_finalize (GObject* object)
 //     return 1;
 // }
 
-/* chain function - rtp upstream, from UDP to RTP session
- * this function does the actual processing
+/*
+ * Helper functions for the chain functions. The single buffer and the buffer
+ * list chain functions use them to process each packet the same way.
  */
+
+/*
+ * Packet classes of the RTP receive pad. The first byte tells the protocol
+ * (RFC 7983): 0..3 STUN, 16..19 ZRTP, 20..63 DTLS, 64..79 TURN channels,
+ * 128..191 RTP and RTCP. The second byte of RTCP is a packet type in
+ * 192..223 (RFC 5761), the filter checks it with rtcp-mux only.
+ */
+typedef enum {
+    ZRTP_CLASS_RTP,
+    ZRTP_CLASS_RTCP,
+    ZRTP_CLASS_ZRTP,
+    ZRTP_CLASS_OTHER,
+} ZrtpPacketClass;
+
+/* Classify a received packet, reads the first two bytes only */
+static ZrtpPacketClass
+zrtp_filter_classify(GstZrtpFilter* zrtp, GstBuffer* gstBuf)
+{
+    guint8 hdr[2];
+
 #if GST_CHECK_VERSION(1,0,0)
+    if (gst_buffer_extract(gstBuf, 0, hdr, sizeof(hdr)) != sizeof(hdr))
+        return ZRTP_CLASS_OTHER;
+#else
+    if (GST_BUFFER_SIZE(gstBuf) < sizeof(hdr))
+        return ZRTP_CLASS_OTHER;
+    memcpy(hdr, GST_BUFFER_DATA(gstBuf), sizeof(hdr));
+#endif
+    if (hdr[0] >= 128 && hdr[0] <= 191) {
+        if (zrtp->rtcpMux && hdr[1] >= 192 && hdr[1] <= 223)
+            return ZRTP_CLASS_RTCP;
+        return ZRTP_CLASS_RTP;
+    }
+    if (hdr[0] >= 16 && hdr[0] <= 19)
+        return ZRTP_CLASS_ZRTP;
+    return ZRTP_CLASS_OTHER;
+}
+
+/* Returns a reference to a request pad or NULL, release_pad may remove the pad at any time */
+static GstPad*
+zrtp_filter_ref_pad(GstZrtpFilter* zrtp, GstPad** pad)
+{
+    GstPad* result = NULL;
+
+    GST_OBJECT_LOCK(zrtp);
+    if (*pad != NULL)
+        result = gst_object_ref(*pad);
+    GST_OBJECT_UNLOCK(zrtp);
+    return result;
+}
+
+/*
+ * Lock-free access to the crypto contexts.
+ *
+ * The chain functions run in the streaming threads and use the SRTP/SRTCP
+ * contexts for each packet. The ZRTP engine creates and destroys the contexts
+ * in its own thread (timer or receive path) when it switches security on or
+ * off. A mutex per packet is too expensive, thus use a simple epoch scheme
+ * similar to RCU:
+ *
+ * - a reader registers in the reader slot of the current epoch, re-checks the
+ *   epoch and only then loads the context pointers. It keeps the pointers
+ *   until it leaves the read section.
+ * - a writer publishes the new pointers, flips the epoch and waits until the
+ *   slot of the old epoch has no readers. No reader can hold an old pointer
+ *   at that time, the writer frees the old contexts.
+ *
+ * Readers never block. Read sections must not call into the ZRTP engine
+ * and must not push buffers, otherwise a writer waits for a long time or, if
+ * it runs in the same thread, forever.
+ */
+static inline gint
+zrtp_filter_read_lock(GstZrtpFilter* zrtp)
+{
+    gint slot;
+
+    for (;;) {
+        slot = g_atomic_int_get(&zrtp->rcuEpoch) & 1;
+        g_atomic_int_inc(&zrtp->rcuReaders[slot]);
+        if ((g_atomic_int_get(&zrtp->rcuEpoch) & 1) == slot)
+            return slot;
+        /* a writer flipped the epoch meanwhile, register again */
+        g_atomic_int_add(&zrtp->rcuReaders[slot], -1);
+    }
+}
+
+static inline void
+zrtp_filter_read_unlock(GstZrtpFilter* zrtp, gint slot)
+{
+    g_atomic_int_add(&zrtp->rcuReaders[slot], -1);
+}
+
+/* Wait until all readers that may use the old pointers left their read section */
+static void
+zrtp_filter_synchronize(GstZrtpFilter* zrtp)
+{
+    gint slot;
+
+    g_mutex_lock(zrtp->rcuMutex);
+    slot = g_atomic_int_get(&zrtp->rcuEpoch) & 1;
+    g_atomic_int_inc(&zrtp->rcuEpoch);
+    while (g_atomic_int_get(&zrtp->rcuReaders[slot]) != 0)
+        g_thread_yield();
+    g_mutex_unlock(zrtp->rcuMutex);
+}
+
+/* Publish new send contexts, free the old ones after the grace period */
+static void
+zrtp_filter_swap_send(GstZrtpFilter* zrtp, ZsrtpContext* srtp, ZsrtpContextCtrl* srtcp)
+{
+    ZsrtpContext* oldSrtp = zrtp->srtpSend;
+    ZsrtpContextCtrl* oldSrtcp = zrtp->srtcpSend;
+
+    g_atomic_pointer_set(&zrtp->srtpSend, srtp);
+    g_atomic_pointer_set(&zrtp->srtcpSend, srtcp);
+    if (oldSrtp == NULL && oldSrtcp == NULL)
+        return;
+
+    zrtp_filter_synchronize(zrtp);
+    zsrtp_DestroyWrapper(oldSrtp);
+    zsrtp_DestroyWrapperCtrl(oldSrtcp);
+}
+
+/* Publish new receive contexts, free the old ones after the grace period */
+static void
+zrtp_filter_swap_receive(GstZrtpFilter* zrtp, ZrtpSsrcTable* srtp, ZrtpSsrcTable* srtcp)
+{
+    ZrtpSsrcTable* oldSrtp = zrtp->srtpReceive;
+    ZrtpSsrcTable* oldSrtcp = zrtp->srtcpReceive;
+
+    g_atomic_pointer_set(&zrtp->srtpReceive, srtp);
+    g_atomic_pointer_set(&zrtp->srtcpReceive, srtcp);
+    g_atomic_int_inc(&zrtp->recvGeneration);    /* crypto workers fork the new table */
+    if (oldSrtp == NULL && oldSrtcp == NULL)
+        return;
+
+    zrtp_filter_synchronize(zrtp);
+    zrtp_ssrc_table_free(oldSrtp);
+    zrtp_ssrc_table_free(oldSrtcp);
+}
+
+/* Process a possible ZRTP packet, takes ownership of the buffer */
 static GstFlowReturn
-gst_zrtp_filter_chain_rtp_up (GstPad* pad, GstObject* parent, GstBuffer* gstBuf)
+zrtp_filter_process_zrtp(GstZrtpFilter* zrtp, GstBuffer* gstBuf)
 {
-    GstZrtpFilter* zrtp = GST_ZRTPFILTER (parent);
-    GstFlowReturn rc = GST_FLOW_ERROR;
+    GstFlowReturn rc = GST_FLOW_OK;
+    guint64 start = ZRTP_TRACE_ENABLED(zrtp_recv) ? zrtp_stats_now() : 0;
+#if GST_CHECK_VERSION(1,0,0)
     GstMapInfo mapInfo;
     guint8* buffer;
     gsize bufsize;
@@ -925,49 +1621,10 @@ gst_zrtp_filter_chain_rtp_up (GstPad* pad, GstObject* parent, GstBuffer* gstBuf)
     buffer = mapInfo.data;
     bufsize = mapInfo.size;
 #else
-static GstFlowReturn
-gst_zrtp_filter_chain_rtp_up (GstPad* pad, GstBuffer* gstBuf)
-{
-    GstZrtpFilter* zrtp = GST_ZRTPFILTER (GST_OBJECT_PARENT (pad));
-    GstFlowReturn rc = GST_FLOW_ERROR;
     guint8* buffer = GST_BUFFER_DATA(gstBuf);
     gsize bufsize = GST_BUFFER_SIZE(gstBuf);
 #endif
 
-    // check if this could be a real RTP/SRTP packet.
-    if ((*buffer & 0xf0) != 0x10) {
-        //  Could be real RTP, check if we are in secure mode
-        if (zrtp->srtpReceive == NULL) {
-            GST_TRACE_OBJECT(zrtp, "Received upstream RTP buffer - SRTP inactive");
-            rc = gst_pad_push (zrtp->recv_rtp_src, gstBuf);
-        } else {
-            rc = zsrtp_unprotect(zrtp->srtpReceive, gstBuf);
-            GST_TRACE_OBJECT(zrtp, "Decrypted upstream SRTP buffer, result: %d", rc);
-            if (rc == 1) {
-                zrtp->unprotect++;
-                rc = gst_pad_push (zrtp->recv_rtp_src, gstBuf);
-                zrtp->unprotect_err = 0;
-            } else {
-                if (rc == -1) {
-                    GST_WARNING_OBJECT(zrtp, "SRTP Authentication check failed.");
-                    g_signal_emit(zrtp, gst_zrtp_filter_signals[SIGNAL_STATUS], 0, zrtp_Warning, zrtp_WarningSRTPauthError);
-                } else {
-                    GST_WARNING_OBJECT(zrtp, "SRTP Replay check failed.");
-                    g_signal_emit(zrtp, gst_zrtp_filter_signals[SIGNAL_STATUS], 0, zrtp_Warning, zrtp_WarningSRTPreplayError);
-                }
-                zrtp->unprotect_err = rc;
-                gst_buffer_unref(gstBuf);
-                rc = GST_FLOW_OK;
-            }
-        }
-#if GST_CHECK_VERSION(1,0,0)
-        gst_buffer_unmap(gstBuf, &mapInfo);
-#endif
-        if (!zrtp->started && zrtp->enableZrtp)
-            zrtp_filter_startZrtp(zrtp);
-        return rc;
-    }
-
     /* We assume all other packets are ZRTP packets here. Process
      * if ZRTP processing is enabled. Because valid RTP packets are
      * already handled we delete (unref buffer) any packets here after
@@ -976,28 +1633,37 @@ gst_zrtp_filter_chain_rtp_up (GstPad* pad, GstBuffer* gstBuf)
     if (zrtp->enableZrtp && zrtp->zrtpCtx != NULL) {
         // Get CRC value into crc (see above how to compute the offset)
         gint temp = bufsize - CRC_SIZE;
-        guint32 crc = *(guint32*)(buffer + temp);
-        crc = g_ntohl(crc);
+        guint32 crc;
+        guint32 magic;
+
+        // Too short to hold a ZRTP header and the CRC, no further processing
+        if (bufsize < 12 + CRC_SIZE) {
+            ZRTP_STATS_ADD(zrtp->stats.droppedNonZrtp, 1);
+            rc = GST_FLOW_ERROR;
+            goto done;
+        }
+        crc = GST_READ_UINT32_LE(buffer + temp);
 
         GST_TRACE_OBJECT(zrtp, "Check received upstream packet - possibly ZRTP");
-        guint32 magic = *(guint32*)(buffer + 4);
+        magic = *(guint32*)(buffer + 4);
         magic = g_ntohl(magic);
 
         // Check if it is really a ZRTP packet, return, no further processing
-        if (magic != ZRTP_MAGIC || zrtp->zrtpCtx == NULL) {
-#if GST_CHECK_VERSION(1,0,0)
-            gst_buffer_unmap(gstBuf, &mapInfo);
-#endif
-            gst_buffer_unref(gstBuf);
-            return GST_FLOW_ERROR;
+        if (magic != ZRTP_MAGIC) {
+            ZRTP_STATS_ADD(zrtp->stats.droppedNonZrtp, 1);
+            rc = GST_FLOW_ERROR;
+            goto done;
         }
 
-        if (!zrtp_CheckCksum(buffer, temp, crc)) {
+        if (zrtp_crc32c(buffer, temp) != crc) {
+            ZRTP_STATS_ADD(zrtp->stats.zrtpCrcErrors, 1);
             GST_WARNING_OBJECT(zrtp, "Upstream ZRTP packet found, CRC check failed.");
             g_signal_emit (zrtp, gst_zrtp_filter_signals[SIGNAL_STATUS], 0, zrtp_Warning, zrtp_WarningCRCmismatch);
-            return rc;
+            rc = GST_FLOW_ERROR;
+            goto done;
         }
         GST_TRACE_OBJECT(zrtp, "Upstream ZRTP packet found, CRC ok.");
+        ZRTP_STATS_ADD(zrtp->stats.zrtpReceived, 1);
         // cover the case if the other party sends _only_ ZRTP packets at the
         // beginning of a session. Start ZRTP in this case as well.
         if (!zrtp->started) {
@@ -1014,63 +1680,808 @@ gst_zrtp_filter_chain_rtp_up (GstPad* pad, GstBuffer* gstBuf)
         // by the state engine.
         zrtp_processZrtpMessage(zrtp->zrtpCtx, zrtpMsg, zrtp->peerSSRC, bufsize);
     }
+done:
+    ZRTP_FILTER_TRACE(zrtp_recv, gstBuf, FALSE, bufsize, rc == GST_FLOW_OK && zrtp->enableZrtp,
+                      zrtp_stats_now() - start);
 #if GST_CHECK_VERSION(1,0,0)
     gst_buffer_unmap(gstBuf, &mapInfo);
 #endif
     gst_buffer_unref(gstBuf);
-    return GST_FLOW_OK;
+    return rc;
 }
 
-/* chain function - rtp downstream, from RTP session to UDP
- * this function does the actual processing
+/*
+ * Asynchronous ZRTP processing.
+ *
+ * Processing a Commit or a DHPart message computes the DH or ECDH shared
+ * secret, that takes some milliseconds. With async-zrtp the receive thread
+ * only queues the message and continues with the media packets, a worker of
+ * a pool shared by all filters processes it. The ZRTP engine sends its
+ * answer and swaps in the SRTP contexts from the worker thread, timeouts
+ * already run on the clock thread, thus the engine does not depend on the
+ * calling thread.
+ *
+ * The messages of one filter are processed in order: a filter has at most
+ * one task in the pool and the task works on the filter's queue until it is
+ * empty. The task holds a reference to the filter. The queue is bounded,
+ * if it is full the filter drops the message and relies on the ZRTP
+ * retransmission.
  */
-#if GST_CHECK_VERSION(1,0,0)
-static GstFlowReturn
-gst_zrtp_filter_chain_rtp_down (GstPad * pad, GstObject* parent, GstBuffer* gstBuf)
-{
-    GstZrtpFilter *zrtp = GST_ZRTPFILTER(parent);
-#else
-static GstFlowReturn
-gst_zrtp_filter_chain_rtp_down (GstPad * pad, GstBuffer* gstBuf)
+#define ZRTP_ASYNC_MAX_THREADS  4
+#define ZRTP_ASYNC_MAX_PENDING  16
+
+static void
+zrtp_filter_async_worker(gpointer data, gpointer userData)
 {
-    GstZrtpFilter *zrtp = GST_ZRTPFILTER(GST_OBJECT_PARENT(pad));
-#endif
-    GstFlowReturn rc = GST_FLOW_ERROR;
+    GstZrtpFilter* zrtp = GST_ZRTPFILTER(data);
+    GstBuffer* gstBuf;
 
-    if (zrtp->localSSRC == 0) {
-#if GST_CHECK_VERSION(1,0,0)
-        GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
-        gst_rtp_buffer_map(gstBuf, GST_MAP_READ, &rtp);
-        zrtp->localSSRC = gst_rtp_buffer_get_ssrc(&rtp);   /* Learn own SSRC before starting ZRTP */
-        gst_rtp_buffer_unmap(&rtp);
-#else
-        zrtp->localSSRC = gst_rtp_buffer_get_ssrc(gstBuf);   /* Learn own SSRC before starting ZRTP */
-#endif
-    }
+    for (;;) {
+        g_mutex_lock(zrtp->asyncMutex);
+        gstBuf = g_queue_pop_head(&zrtp->asyncQueue);
+        if (gstBuf == NULL)
+            zrtp->asyncScheduled = FALSE;
+        g_mutex_unlock(zrtp->asyncMutex);
 
-    if (!zrtp->started && zrtp->enableZrtp) {
-        zrtp_filter_startZrtp(zrtp);
+        if (gstBuf == NULL)
+            break;
+        zrtp_filter_process_zrtp(zrtp, gstBuf);
     }
+    gst_object_unref(zrtp);
+}
 
-    if (zrtp->srtpSend == NULL) {
-        GST_TRACE_OBJECT(zrtp, "Received downstream RTP buffer - SRTP inactive");
-        rc = gst_pad_push (zrtp->send_rtp_src, gstBuf);
+static gpointer
+zrtp_filter_create_pool(gpointer data)
+{
+    GError* error = NULL;
+    GThreadPool* pool;
+
+    pool = g_thread_pool_new(zrtp_filter_async_worker, NULL, ZRTP_ASYNC_MAX_THREADS, FALSE, &error);
+    if (pool == NULL) {
+        GST_ERROR("Cannot create ZRTP worker pool: %s", error->message);
+        g_error_free(error);
     }
-    else {
-        rc = zsrtp_protect(zrtp->srtpSend, gstBuf);
-        GST_TRACE_OBJECT(zrtp, "Encrypted downstream RTP buffer, result: %d", rc);
-        zrtp->protect++;
+    return pool;
+}
 
-        if (rc == 1)
-            rc = gst_pad_push (zrtp->send_rtp_src, gstBuf);
-        else {
-            rc = GST_FLOW_ERROR;
+static GThreadPool*
+zrtp_filter_get_pool(void)
+{
+    static GOnce poolOnce = G_ONCE_INIT;
+
+    return g_once(&poolOnce, zrtp_filter_create_pool, NULL);
+}
+
+/* Process a received ZRTP message or queue it for the worker pool */
+static GstFlowReturn
+zrtp_filter_handle_zrtp(GstZrtpFilter* zrtp, GstBuffer* gstBuf)
+{
+    GThreadPool* pool;
+
+    /* Without an engine the packet is dropped, no need for the worker pool */
+    if (!zrtp->asyncZrtp || zrtp->zrtpCtx == NULL || (pool = zrtp_filter_get_pool()) == NULL)
+        return zrtp_filter_process_zrtp(zrtp, gstBuf);
+
+    /* Start the engine here, as the synchronous path does, not in the worker */
+    if (!zrtp->started && zrtp->enableZrtp)
+        zrtp_filter_startZrtp(zrtp);
+
+    g_mutex_lock(zrtp->asyncMutex);
+    if (g_queue_get_length(&zrtp->asyncQueue) >= ZRTP_ASYNC_MAX_PENDING) {
+        g_mutex_unlock(zrtp->asyncMutex);
+        ZRTP_STATS_ADD(zrtp->stats.zrtpAsyncDrops, 1);
+        GST_WARNING_OBJECT(zrtp, "ZRTP worker queue full, packet dropped.");
+        gst_buffer_unref(gstBuf);
+        return GST_FLOW_OK;
+    }
+    g_queue_push_tail(&zrtp->asyncQueue, gstBuf);
+    if (!zrtp->asyncScheduled) {
+        zrtp->asyncScheduled = TRUE;
+        g_thread_pool_push(pool, gst_object_ref(zrtp), NULL);
+    }
+    g_mutex_unlock(zrtp->asyncMutex);
+    return GST_FLOW_OK;
+}
+
+/* SRTP receive errors to signal, collected inside the read section and emitted after it */
+typedef struct _ZrtpFilterErrors {
+    guint auth;
+    guint replay;
+} ZrtpFilterErrors;
+
+/* Count a SRTP receive error, the counters feed the periodic error messages, signals are opt-in */
+static void
+zrtp_filter_srtp_error(GstZrtpFilter* zrtp, gint32 rc, ZrtpFilterErrors* errors)
+{
+    if (rc == -1) {
+        ZRTP_STATS_ADD(zrtp->stats.rtpRecv.authFailures, 1);
+        GST_LOG_OBJECT(zrtp, "SRTP Authentication check failed.");
+        if (G_UNLIKELY(zrtp->errorSignals))
+            errors->auth++;
+    } else {
+        ZRTP_STATS_ADD(zrtp->stats.rtpRecv.replayDrops, 1);
+        GST_LOG_OBJECT(zrtp, "SRTP Replay check failed.");
+        if (G_UNLIKELY(zrtp->errorSignals))
+            errors->replay++;
+    }
+}
+
+/*
+ * Emit the collected error signals. Call it only after the read section was
+ * left, a handler may set properties or stop ZRTP and thus wait for readers.
+ */
+static void
+zrtp_filter_emit_errors(GstZrtpFilter* zrtp, ZrtpFilterErrors* errors)
+{
+    for (; errors->auth > 0; errors->auth--)
+        g_signal_emit(zrtp, gst_zrtp_filter_signals[SIGNAL_STATUS], 0, zrtp_Warning, zrtp_WarningSRTPauthError);
+    for (; errors->replay > 0; errors->replay--)
+        g_signal_emit(zrtp, gst_zrtp_filter_signals[SIGNAL_STATUS], 0, zrtp_Warning, zrtp_WarningSRTPreplayError);
+}
+
+/* SSRC and sequence number of a RTP or ZRTP packet, the sender SSRC of a RTCP packet */
+static void
+zrtp_filter_trace_header(GstBuffer* gstBuf, gboolean rtcp, guint32* ssrc, guint16* seq)
+{
+    guint8 hdr[12] = { 0, };
+
+#if GST_CHECK_VERSION(1,0,0)
+    gst_buffer_extract(gstBuf, 0, hdr, sizeof(hdr));
+#else
+    memcpy(hdr, GST_BUFFER_DATA(gstBuf), MIN(GST_BUFFER_SIZE(gstBuf), sizeof(hdr)));
+#endif
+    if (rtcp) {
+        *ssrc = GST_READ_UINT32_BE(hdr + 4);
+        *seq = 0;
+    } else {
+        *ssrc = GST_READ_UINT32_BE(hdr + 8);
+        *seq = GST_READ_UINT16_BE(hdr + 2);
+    }
+}
+
+/* Fire a packet probe, see gstzrtptrace.h. Computes the arguments only while a tracer is attached */
+#define ZRTP_FILTER_TRACE(name, gstBuf, rtcp, size, result, ns)                          \
+    G_STMT_START {                                                                      \
+        if (ZRTP_TRACE_ENABLED(name)) {                                                 \
+            guint32 _ssrc;                                                              \
+            guint16 _seq;                                                               \
+            zrtp_filter_trace_header((gstBuf), (rtcp), &_ssrc, &_seq);                  \
+            ZRTP_TRACE5(name, _ssrc, _seq, (gsize)(size), (gint32)(result), (guint64)(ns)); \
+        }                                                                               \
+    } G_STMT_END
+
+/* State of the chain probe, start is 0 if no tracer was attached when the chain call started */
+typedef struct _ZrtpFilterTrace {
+    guint64 start;
+    guint32 ssrc;
+    guint16 seq;
+    gsize size;
+} ZrtpFilterTrace;
+
+static inline void
+zrtp_filter_trace_begin(ZrtpFilterTrace* trace, GstBuffer* gstBuf, gboolean rtcp)
+{
+    trace->start = 0;
+    if (ZRTP_TRACE_ENABLED(chain)) {
+        zrtp_filter_trace_header(gstBuf, rtcp, &trace->ssrc, &trace->seq);
+        trace->size = gst_buffer_get_size(gstBuf);
+        trace->start = zrtp_stats_now();
+    }
+}
+
+#define ZRTP_FILTER_TRACE_CHAIN(trace, path, flow)                                      \
+    G_STMT_START {                                                                      \
+        if ((trace)->start != 0)                                                        \
+            ZRTP_TRACE6(chain, (path), (trace)->ssrc, (trace)->seq, (trace)->size,      \
+                        (gint32)(flow), zrtp_stats_now() - (trace)->start);             \
+    } G_STMT_END
+
+/* Returns the decrypted buffer or NULL if SRTP dropped the buffer, adds the error to signal to errors */
+static GstBuffer*
+zrtp_filter_unprotect_rtp(GstZrtpFilter* zrtp, ZrtpSsrcTable* srtp, GstBuffer* gstBuf, ZrtpFilterErrors* errors)
+{
+    guint64 start = zrtp_stats_now();
+    gsize size = gst_buffer_get_size(gstBuf);
+    gint32 rc = zrtp_ssrc_table_unprotect(srtp, gstBuf);
+
+    ZRTP_FILTER_TRACE(rtp_unprotect, gstBuf, FALSE, size, rc, zrtp_stats_now() - start);
+    GST_TRACE_OBJECT(zrtp, "Decrypted upstream SRTP buffer, result: %d", rc);
+    if (rc == 1) {
+        zrtp_stats_packet(&zrtp->stats.rtpRecv, size, start);
+        return gstBuf;
+    }
+    zrtp_filter_srtp_error(zrtp, rc, errors);
+    gst_buffer_unref(gstBuf);
+    return NULL;
+}
+
+/* Returns the encrypted buffer or NULL if SRTP dropped the buffer */
+static GstBuffer*
+zrtp_filter_protect_rtp(GstZrtpFilter* zrtp, ZsrtpContext* srtp, GstBuffer* gstBuf)
+{
+    guint64 start = zrtp_stats_now();
+    gint32 rc = zsrtp_protect(srtp, gstBuf);
+
+    ZRTP_FILTER_TRACE(rtp_protect, gstBuf, FALSE, gst_buffer_get_size(gstBuf), rc, zrtp_stats_now() - start);
+    GST_TRACE_OBJECT(zrtp, "Encrypted downstream RTP buffer, result: %d", rc);
+    if (rc == 1) {
+        zrtp_stats_packet(&zrtp->stats.rtpSend, gst_buffer_get_size(gstBuf), start);
+        return gstBuf;
+    }
+
+    gst_buffer_unref(gstBuf);
+    return NULL;
+}
+
+/*
+ * Returns the decrypted buffer or NULL if SRTCP dropped the buffer. With
+ * rtcp-mux the RTP receive thread unprotects RTCP as well, the lock keeps
+ * it and the RTCP receive thread out of the table at the same time.
+ */
+static GstBuffer*
+zrtp_filter_unprotect_rtcp(GstZrtpFilter* zrtp, ZrtpSsrcTable* srtcp, GstBuffer* gstBuf)
+{
+    guint64 start = zrtp_stats_now();
+    gsize size = gst_buffer_get_size(gstBuf);
+    gint32 rc;
+
+    g_mutex_lock(zrtp->srtcpRecvMutex);
+    rc = zrtp_ssrc_table_unprotect_ctrl(srtcp, gstBuf);
+    g_mutex_unlock(zrtp->srtcpRecvMutex);
+
+    ZRTP_FILTER_TRACE(rtcp_unprotect, gstBuf, TRUE, size, rc, zrtp_stats_now() - start);
+    GST_TRACE_OBJECT(zrtp, "Decrypted upstream SRTCP buffer, result: %d", rc);
+    if (rc == 1) {
+        zrtp_stats_packet(&zrtp->stats.rtcpRecv, size, start);
+        return gstBuf;
+    }
+    if (rc == -1)
+        ZRTP_STATS_ADD(zrtp->stats.rtcpRecv.authFailures, 1);
+    else
+        ZRTP_STATS_ADD(zrtp->stats.rtcpRecv.replayDrops, 1);
+
+    gst_buffer_unref(gstBuf);
+    return NULL;
+}
+
+/* Returns the encrypted buffer or NULL if SRTCP dropped the buffer */
+static GstBuffer*
+zrtp_filter_protect_rtcp(GstZrtpFilter* zrtp, ZsrtpContextCtrl* srtcp, GstBuffer* gstBuf)
+{
+    guint64 start = zrtp_stats_now();
+    gint32 rc = zsrtp_protectCtrl(srtcp, gstBuf);
+
+    ZRTP_FILTER_TRACE(rtcp_protect, gstBuf, TRUE, gst_buffer_get_size(gstBuf), rc, zrtp_stats_now() - start);
+    GST_TRACE_OBJECT(zrtp, "Encrypted downstream RTCP buffer, result: %d", rc);
+    if (rc == 1) {
+        zrtp_stats_packet(&zrtp->stats.rtcpSend, gst_buffer_get_size(gstBuf), start);
+        return gstBuf;
+    }
+
+    gst_buffer_unref(gstBuf);
+    return NULL;
+}
+
+/* Learn own SSRC from the first downstream RTP packet before starting ZRTP */
+static void
+zrtp_filter_learn_ssrc(GstZrtpFilter* zrtp, GstBuffer* gstBuf)
+{
+#if GST_CHECK_VERSION(1,0,0)
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+    gst_rtp_buffer_map(gstBuf, GST_MAP_READ, &rtp);
+    zrtp->localSSRC = gst_rtp_buffer_get_ssrc(&rtp);
+    gst_rtp_buffer_unmap(&rtp);
+#else
+    zrtp->localSSRC = gst_rtp_buffer_get_ssrc(gstBuf);
+#endif
+}
+
+#if GST_CHECK_VERSION(1,0,0)
+/* Reserve tailroom in the allocation parameters, keep the downstream parameters */
+static void
+zrtp_filter_reserve_tailroom(GstQuery* query, gsize tailroom)
+{
+    GstAllocationParams params;
+    GstAllocator* allocator;
+    guint i, n;
+
+    n = gst_query_get_n_allocation_params(query);
+    if (n == 0) {
+        gst_allocation_params_init(&params);
+        params.padding = tailroom;
+        gst_query_add_allocation_param(query, NULL, &params);
+        return;
+    }
+    for (i = 0; i < n; i++) {
+        gst_query_parse_nth_allocation_param(query, i, &allocator, &params);
+        params.padding += tailroom;
+        gst_query_set_nth_allocation_param(query, i, allocator, &params);
+        if (allocator != NULL)
+            gst_object_unref(allocator);
+    }
+}
+
+/* query function - send sinks
+ *
+ * Answer the ALLOCATION query so that upstream elements, e.g. payloaders,
+ * allocate buffers with enough tailroom for the SRTP authentication tag, the
+ * MKI and the SRTCP index. SRTP then encrypts and appends its data in place.
+ * Buffers of pools proposed by downstream elements don't have this tailroom,
+ * thus remove such pools and let upstream allocate with our parameters.
+ */
+static gboolean
+gst_zrtp_filter_send_query (GstPad* pad, GstObject* parent, GstQuery* query)
+{
+    GstZrtpFilter* zrtp = GST_ZRTPFILTER (parent);
+    GstPad* srcpad;
+    gsize tailroom;
+
+    if (GST_QUERY_TYPE(query) != GST_QUERY_ALLOCATION)
+        return gst_pad_query_default(pad, parent, query);
+
+    if (pad == zrtp->send_rtp_sink) {
+        srcpad = zrtp->send_rtp_src;
+        tailroom = ZSRTP_MAX_SRTP_TAIL;
+    } else {
+        srcpad = zrtp->send_rtcp_src;
+        tailroom = ZSRTP_MAX_SRTCP_TAIL;
+    }
+    /* Ask downstream first, use its answer if it has one */
+    if (!gst_pad_peer_query(srcpad, query))
+        GST_DEBUG_OBJECT(zrtp, "Downstream did not answer allocation query");
+
+#if GST_CHECK_VERSION(1,2,0)
+    while (gst_query_get_n_allocation_pools(query) > 0)
+        gst_query_remove_nth_allocation_pool(query, 0);
+#endif
+    zrtp_filter_reserve_tailroom(query, tailroom);
+
+    GST_DEBUG_OBJECT(zrtp, "Reserve %" G_GSIZE_FORMAT " bytes tailroom on pad %s:%s",
+                     tailroom, GST_DEBUG_PAD_NAME(pad));
+    return TRUE;
+}
+#endif
+
+/*
+ * Crypto workers: with the crypto-workers property set the streaming thread
+ * submits RTP packets to the worker pool. The SSRC selects the worker, the
+ * worker unprotects or protects the packet and the pool pushes it in submit
+ * order.
+ *
+ * Receive: each worker forks its own receive table from the table of the
+ * filter, thus SSRC contexts are never shared between threads. A swap of
+ * the receive contexts increments recvGeneration and each worker forks the
+ * new table with its next packet. The filter table only serves as template.
+ * Send: the filter has one send context, all send packets use the worker of
+ * the local SSRC.
+ */
+static GstBuffer*
+zrtp_filter_crypto_up(gpointer userData, guint worker, GstBuffer* gstBuf)
+{
+    GstZrtpFilter* zrtp = GST_ZRTPFILTER (userData);
+    ZrtpCryptoRecv* recv = &zrtp->cryptoRecv[worker];
+    ZrtpFilterErrors errors = { 0, 0 };
+    gint generation;
+    gint slot;
+
+    slot = zrtp_filter_read_lock(zrtp);
+    generation = g_atomic_int_get(&zrtp->recvGeneration);
+    if (G_UNLIKELY(recv->generation != generation)) {
+        ZrtpSsrcTable* srtp = g_atomic_pointer_get(&zrtp->srtpReceive);
+
+        zrtp_ssrc_table_free(recv->table);
+        recv->table = (srtp != NULL) ? zrtp_ssrc_table_fork(srtp) : NULL;
+        recv->generation = generation;
+    }
+    if (recv->table == NULL) {
+        zrtp_stats_packet(&zrtp->stats.rtpRecv, gst_buffer_get_size(gstBuf), 0);
+        if (g_atomic_pointer_get(&zrtp->srtpReceive) != NULL) {
+            /* fork failed, do not pass the packet in the clear */
+            gst_buffer_unref(gstBuf);
+            gstBuf = NULL;
+        }
+    } else {
+        gstBuf = zrtp_filter_unprotect_rtp(zrtp, recv->table, gstBuf, &errors);
+    }
+    zrtp_filter_read_unlock(zrtp, slot);
+    zrtp_filter_emit_errors(zrtp, &errors);
+    return gstBuf;
+}
+
+static GstBuffer*
+zrtp_filter_crypto_down(gpointer userData, guint worker, GstBuffer* gstBuf)
+{
+    GstZrtpFilter* zrtp = GST_ZRTPFILTER (userData);
+    ZsrtpContext* srtp;
+    gint slot;
+
+    slot = zrtp_filter_read_lock(zrtp);
+    srtp = g_atomic_pointer_get(&zrtp->srtpSend);
+    if (srtp == NULL)
+        zrtp_stats_packet(&zrtp->stats.rtpSend, gst_buffer_get_size(gstBuf), 0);
+    else
+        gstBuf = zrtp_filter_protect_rtp(zrtp, srtp, gstBuf);
+    zrtp_filter_read_unlock(zrtp, slot);
+    return gstBuf;
+}
+
+static GstFlowReturn
+zrtp_filter_crypto_push_up(gpointer userData, GstBuffer* gstBuf)
+{
+    return gst_pad_push (GST_ZRTPFILTER (userData)->recv_rtp_src, gstBuf);
+}
+
+static GstFlowReturn
+zrtp_filter_crypto_push_down(gpointer userData, GstBuffer* gstBuf)
+{
+    return gst_pad_push (GST_ZRTPFILTER (userData)->send_rtp_src, gstBuf);
+}
+
+static void
+zrtp_filter_start_crypto(GstZrtpFilter* zrtp)
+{
+    ZrtpCryptoPool* pool;
+    guint i;
+
+    for (i = 0; i < ZRTP_CRYPTO_MAX_WORKERS; i++) {
+        zrtp->cryptoRecv[i].table = NULL;
+        zrtp->cryptoRecv[i].generation = -1;
+    }
+    pool = zrtp_crypto_pool_new(zrtp->cryptoWorkers, zrtp);
+    if (pool == NULL) {
+        GST_WARNING_OBJECT(zrtp, "No crypto workers, process SRTP in the streaming threads");
+        return;
+    }
+    zrtp_crypto_set_stream(pool, ZRTP_CRYPTO_RECV, zrtp_filter_crypto_up, zrtp_filter_crypto_push_up);
+    zrtp_crypto_set_stream(pool, ZRTP_CRYPTO_SEND, zrtp_filter_crypto_down, zrtp_filter_crypto_push_down);
+    g_atomic_pointer_set(&zrtp->cryptoPool, pool);
+}
+
+static void
+zrtp_filter_stop_crypto(GstZrtpFilter* zrtp)
+{
+    ZrtpCryptoPool* pool = g_atomic_pointer_get(&zrtp->cryptoPool);
+    guint i;
+
+    if (pool == NULL)
+        return;
+
+    g_atomic_pointer_set(&zrtp->cryptoPool, NULL);
+    zrtp_crypto_pool_free(pool);
+    for (i = 0; i < ZRTP_CRYPTO_MAX_WORKERS; i++) {
+        zrtp_ssrc_table_free(zrtp->cryptoRecv[i].table);
+        zrtp->cryptoRecv[i].table = NULL;
+    }
+}
+
+/* Push an upstream RTP packet, unprotect it if SRTP is active */
+static GstFlowReturn
+zrtp_filter_push_rtp_up(GstZrtpFilter* zrtp, GstBuffer* gstBuf)
+{
+    GstFlowReturn rc = GST_FLOW_OK;
+    ZrtpSsrcTable* srtp;
+    ZrtpCryptoPool* pool;
+    ZrtpFilterErrors errors = { 0, 0 };
+    gint slot;
+
+    pool = g_atomic_pointer_get(&zrtp->cryptoPool);
+    if (pool != NULL) {
+        guint32 ssrc;
+
+        /* Too short for a RTP header, the SSRC table drops it as well */
+        if (gst_buffer_extract(gstBuf, 8, &ssrc, sizeof(ssrc)) != sizeof(ssrc)) {
+            ZRTP_STATS_ADD(zrtp->stats.droppedNonZrtp, 1);
             gst_buffer_unref(gstBuf);
+            return GST_FLOW_OK;
         }
+        return zrtp_crypto_submit(pool, ZRTP_CRYPTO_RECV, g_ntohl(ssrc), gstBuf);
+    }
+
+    slot = zrtp_filter_read_lock(zrtp);
+    srtp = g_atomic_pointer_get(&zrtp->srtpReceive);
+    if (srtp == NULL) {
+        zrtp_filter_read_unlock(zrtp, slot);
+        GST_TRACE_OBJECT(zrtp, "Received upstream RTP buffer - SRTP inactive");
+        zrtp_stats_packet(&zrtp->stats.rtpRecv, gst_buffer_get_size(gstBuf), 0);
+        rc = gst_pad_push (zrtp->recv_rtp_src, gstBuf);
+    } else {
+        gstBuf = zrtp_filter_unprotect_rtp(zrtp, srtp, gstBuf, &errors);
+        zrtp_filter_read_unlock(zrtp, slot);
+        zrtp_filter_emit_errors(zrtp, &errors);
+        if (gstBuf != NULL)
+            rc = gst_pad_push (zrtp->recv_rtp_src, gstBuf);
+    }
+    return rc;
+}
+
+/* Push a downstream RTP packet, protect it if SRTP is active */
+static GstFlowReturn
+zrtp_filter_push_rtp_down(GstZrtpFilter* zrtp, GstBuffer* gstBuf)
+{
+    GstFlowReturn rc = GST_FLOW_ERROR;
+    ZsrtpContext* srtp;
+    ZrtpCryptoPool* pool;
+    gint slot;
+
+    pool = g_atomic_pointer_get(&zrtp->cryptoPool);
+    if (pool != NULL)
+        return zrtp_crypto_submit(pool, ZRTP_CRYPTO_SEND, zrtp->localSSRC, gstBuf);
+
+    slot = zrtp_filter_read_lock(zrtp);
+    srtp = g_atomic_pointer_get(&zrtp->srtpSend);
+    if (srtp == NULL) {
+        zrtp_filter_read_unlock(zrtp, slot);
+        GST_TRACE_OBJECT(zrtp, "Received downstream RTP buffer - SRTP inactive");
+        zrtp_stats_packet(&zrtp->stats.rtpSend, gst_buffer_get_size(gstBuf), 0);
+        rc = gst_pad_push (zrtp->send_rtp_src, gstBuf);
+    }
+    else {
+        gstBuf = zrtp_filter_protect_rtp(zrtp, srtp, gstBuf);
+        zrtp_filter_read_unlock(zrtp, slot);
+        if (gstBuf != NULL)
+            rc = gst_pad_push (zrtp->send_rtp_src, gstBuf);
+    }
+    return rc;
+}
+
+typedef GstFlowReturn (*ZrtpPushFunc)(GstZrtpFilter* zrtp, GstBuffer* gstBuf);
+
+/*
+ * Push a held upstream RTP packet. The peer may have sent it in the clear
+ * before it switched to SRTP, thus drop it if it fails to authenticate but
+ * do not report an SRTP error. Uses the receive table itself, not the
+ * crypto workers, the ZRTP engine may replay the packets.
+ */
+static GstFlowReturn
+zrtp_filter_push_held_rtp_up(GstZrtpFilter* zrtp, GstBuffer* gstBuf)
+{
+    ZrtpSsrcTable* srtp;
+    gsize size = gst_buffer_get_size(gstBuf);
+    gint32 result;
+    gint slot;
+
+    slot = zrtp_filter_read_lock(zrtp);
+    srtp = g_atomic_pointer_get(&zrtp->srtpReceive);
+    if (srtp == NULL) {
+        zrtp_filter_read_unlock(zrtp, slot);
+        GST_TRACE_OBJECT(zrtp, "Replay held upstream RTP buffer - SRTP inactive");
+        zrtp_stats_packet(&zrtp->stats.rtpRecv, size, 0);
+        return gst_pad_push (zrtp->recv_rtp_src, gstBuf);
+    }
+    result = zrtp_ssrc_table_unprotect_held(srtp, gstBuf);
+    zrtp_filter_read_unlock(zrtp, slot);
+
+    if (result != 1) {
+        GST_TRACE_OBJECT(zrtp, "Drop held upstream RTP buffer, result: %d", result);
+        ZRTP_STATS_ADD(zrtp->stats.earlyDrops, 1);
+        gst_buffer_unref(gstBuf);
+        return GST_FLOW_OK;
+    }
+    zrtp_stats_packet(&zrtp->stats.rtpRecv, size, 0);
+    return gst_pad_push (zrtp->recv_rtp_src, gstBuf);
+}
+
+/*
+ * Early media: while the handshake of a direction runs and its SRTP context
+ * is not yet installed hold the packet in the ring of the direction.
+ * Otherwise first replay the held packets and then push the new packet. The
+ * ring's replay mutex orders this after a replay of the ZRTP engine, see
+ * zrtp_filter_release_early(), thus the packet order stays intact.
+ */
+static GstFlowReturn
+zrtp_filter_early_media(GstZrtpFilter* zrtp, ZrtpEarlyRing* ring, gpointer* srtp,
+                        ZrtpPushFunc replay, ZrtpPushFunc push, GstBuffer* gstBuf)
+{
+    GstFlowReturn rc;
+    guint dropped = 0;
+
+    rc = zrtp_early_process(ring, g_atomic_pointer_get(srtp) != NULL, (ZrtpEarlyPushFunc)replay,
+                            (ZrtpEarlyPushFunc)push, zrtp, gstBuf, &dropped);
+    if (dropped > 0) {
+        ZRTP_STATS_ADD(zrtp->stats.earlyDrops, dropped);
+        GST_DEBUG_OBJECT(zrtp, "Dropped %u held RTP buffers", dropped);
     }
     return rc;
 }
 
+/*
+ * Stop holding the packets of a direction, called by the ZRTP engine after
+ * it installed or failed to negotiate the SRTP context. Replays the held
+ * packets first, the direction holds until then and its streaming thread
+ * waits for the replay. Only the streaming thread may submit to the crypto
+ * workers, with workers the next packet replays the sent packets.
+ */
+static void
+zrtp_filter_release_early(GstZrtpFilter* zrtp, ZrtpEarlyRing* ring, ZrtpPushFunc replay)
+{
+    guint dropped = 0;
+
+    if (replay != NULL)
+        zrtp_early_flush(ring, (ZrtpEarlyPushFunc)replay, zrtp, &dropped);
+    zrtp_early_set_hold(ring, FALSE);
+    if (dropped > 0) {
+        ZRTP_STATS_ADD(zrtp->stats.earlyDrops, dropped);
+        GST_DEBUG_OBJECT(zrtp, "Dropped %u held RTP buffers", dropped);
+    }
+}
+
+static void
+zrtp_filter_release_early_all(GstZrtpFilter* zrtp)
+{
+    zrtp_filter_release_early(zrtp, &zrtp->earlyRecv, zrtp_filter_push_held_rtp_up);
+    zrtp_filter_release_early(zrtp, &zrtp->earlySend, g_atomic_pointer_get(&zrtp->cryptoPool) == NULL ?
+                              zrtp_filter_push_rtp_down : NULL);
+}
+
+/* Push an upstream RTCP packet to src, unprotect it if SRTCP is active */
+static GstFlowReturn
+zrtp_filter_rtcp_up(GstZrtpFilter* zrtp, GstPad* src, GstBuffer* gstBuf)
+{
+    GstFlowReturn rc = GST_FLOW_ERROR;
+    ZrtpSsrcTable* srtcp;
+    gint slot;
+
+    slot = zrtp_filter_read_lock(zrtp);
+    srtcp = g_atomic_pointer_get(&zrtp->srtcpReceive);
+    if (srtcp == NULL) {
+        zrtp_filter_read_unlock(zrtp, slot);
+        GST_TRACE_OBJECT(zrtp, "Received upstream RTCP buffer - SRTP inactive");
+        zrtp_stats_packet(&zrtp->stats.rtcpRecv, gst_buffer_get_size(gstBuf), 0);
+        rc = gst_pad_push (src, gstBuf);
+    }
+    else {
+        gstBuf = zrtp_filter_unprotect_rtcp(zrtp, srtcp, gstBuf);
+        zrtp_filter_read_unlock(zrtp, slot);
+        if (gstBuf != NULL)
+            rc = gst_pad_push(src, gstBuf);
+    }
+    return rc;
+}
+
+/*
+ * Route a packet of the RTP receive pad that is not RTP. ZRTP packets go to
+ * the engine or are dropped without a look if ZRTP is disabled, muxed RTCP
+ * takes the RTCP path, all other packets leave via recv_other_src if the
+ * application requested it.
+ */
+static GstFlowReturn
+zrtp_filter_demux_up(GstZrtpFilter* zrtp, ZrtpPacketClass cls, GstBuffer* gstBuf)
+{
+    GstFlowReturn rc;
+    GstPad* pad;
+
+    switch (cls) {
+    case ZRTP_CLASS_ZRTP:
+        if (zrtp->enableZrtp)
+            return zrtp_filter_handle_zrtp(zrtp, gstBuf);
+        gst_buffer_unref(gstBuf);
+        return GST_FLOW_OK;
+
+    case ZRTP_CLASS_RTCP:
+        pad = zrtp_filter_ref_pad(zrtp, &zrtp->recv_rtcp_src);
+        if (pad == NULL)
+            pad = gst_object_ref(zrtp->recv_rtp_src);
+        rc = zrtp_filter_rtcp_up(zrtp, pad, gstBuf);
+        gst_object_unref(pad);
+        return rc;
+
+    default:
+        pad = zrtp_filter_ref_pad(zrtp, &zrtp->recv_other_src);
+        if (pad != NULL) {
+            rc = gst_pad_push(pad, gstBuf);
+            gst_object_unref(pad);
+            return rc;
+        }
+        ZRTP_STATS_ADD(zrtp->stats.droppedNonZrtp, 1);
+        gst_buffer_unref(gstBuf);
+        return GST_FLOW_OK;
+    }
+}
+
+static GstFlowReturn
+zrtp_filter_rtp_up(GstZrtpFilter* zrtp, GstBuffer* gstBuf)
+{
+    ZrtpPacketClass cls = zrtp_filter_classify(zrtp, gstBuf);
+
+    if (cls != ZRTP_CLASS_RTP)
+        return zrtp_filter_demux_up(zrtp, cls, gstBuf);
+
+    //  Could be real RTP, check if we are in secure mode
+    if (G_UNLIKELY(zrtp_early_active(&zrtp->earlyRecv)))
+        return zrtp_filter_early_media(zrtp, &zrtp->earlyRecv, (gpointer*)&zrtp->srtpReceive,
+                                       zrtp_filter_push_held_rtp_up, zrtp_filter_push_rtp_up, gstBuf);
+    return zrtp_filter_push_rtp_up(zrtp, gstBuf);
+}
+
+static GstFlowReturn
+zrtp_filter_rtp_down(GstZrtpFilter* zrtp, GstBuffer* gstBuf)
+{
+    if (G_UNLIKELY(zrtp_early_active(&zrtp->earlySend)))
+        return zrtp_filter_early_media(zrtp, &zrtp->earlySend, (gpointer*)&zrtp->srtpSend,
+                                       zrtp_filter_push_rtp_down, zrtp_filter_push_rtp_down, gstBuf);
+    return zrtp_filter_push_rtp_down(zrtp, gstBuf);
+}
+
+/* chain function - rtp upstream, from UDP to RTP session
+ * this function does the actual processing
+ */
+#if GST_CHECK_VERSION(1,0,0)
+static GstFlowReturn
+gst_zrtp_filter_chain_rtp_up (GstPad* pad, GstObject* parent, GstBuffer* gstBuf)
+{
+    GstZrtpFilter* zrtp = GST_ZRTPFILTER (parent);
+#else
+static GstFlowReturn
+gst_zrtp_filter_chain_rtp_up (GstPad* pad, GstBuffer* gstBuf)
+{
+    GstZrtpFilter* zrtp = GST_ZRTPFILTER (GST_OBJECT_PARENT (pad));
+#endif
+    GstFlowReturn rc;
+    ZrtpFilterTrace trace;
+
+    zrtp_filter_trace_begin(&trace, gstBuf, FALSE);
+    rc = zrtp_filter_rtp_up(zrtp, gstBuf);
+
+    if (!zrtp->started && zrtp->enableZrtp)
+        zrtp_filter_startZrtp(zrtp);
+    ZRTP_FILTER_TRACE_CHAIN(&trace, ZRTP_TRACE_PATH_RECV_RTP, rc);
+    return rc;
+}
+
+/* chain function - rtp downstream, from RTP session to UDP
+ * this function does the actual processing
+ */
+#if GST_CHECK_VERSION(1,0,0)
+static GstFlowReturn
+gst_zrtp_filter_chain_rtp_down (GstPad * pad, GstObject* parent, GstBuffer* gstBuf)
+{
+    GstZrtpFilter *zrtp = GST_ZRTPFILTER(parent);
+#else
+static GstFlowReturn
+gst_zrtp_filter_chain_rtp_down (GstPad * pad, GstBuffer* gstBuf)
+{
+    GstZrtpFilter *zrtp = GST_ZRTPFILTER(GST_OBJECT_PARENT(pad));
+#endif
+    GstFlowReturn rc;
+    ZrtpFilterTrace trace;
+
+    zrtp_filter_trace_begin(&trace, gstBuf, FALSE);
+    if (zrtp->localSSRC == 0) {
+        zrtp_filter_learn_ssrc(zrtp, gstBuf);
+    }
+
+    if (!zrtp->started && zrtp->enableZrtp) {
+        zrtp_filter_startZrtp(zrtp);
+    }
+    rc = zrtp_filter_rtp_down(zrtp, gstBuf);
+    ZRTP_FILTER_TRACE_CHAIN(&trace, ZRTP_TRACE_PATH_SEND_RTP, rc);
+    return rc;
+}
+
+/* Serialized events must not overtake RTP packets in the crypto workers */
+#if GST_CHECK_VERSION(1,0,0)
+static gboolean
+gst_zrtp_filter_rtp_event (GstPad* pad, GstObject* parent, GstEvent* event)
+{
+    GstZrtpFilter *zrtp = GST_ZRTPFILTER (parent);
+#else
+static gboolean
+gst_zrtp_filter_rtp_event (GstPad* pad, GstEvent* event)
+{
+    GstZrtpFilter *zrtp = GST_ZRTPFILTER (GST_OBJECT_PARENT(pad));
+#endif
+    ZrtpCryptoPool* pool = g_atomic_pointer_get(&zrtp->cryptoPool);
+
+    if (pool != NULL && GST_EVENT_IS_SERIALIZED(event))
+        zrtp_crypto_drain(pool, pad == zrtp->recv_rtp_sink ? ZRTP_CRYPTO_RECV : ZRTP_CRYPTO_SEND);
+
+#if GST_CHECK_VERSION(1,0,0)
+    return gst_pad_event_default(pad, parent, event);
+#else
+    return gst_pad_event_default(pad, event);
+#endif
+}
+
 /* chain function - rtcp upstream, from UDP to RTP session
  * this function does the actual processing
  */
@@ -1085,22 +2496,12 @@ gst_zrtp_filter_chain_rtcp_up (GstPad * pad, GstBuffer* gstBuf)
 {
     GstZrtpFilter *zrtp = GST_ZRTPFILTER (GST_OBJECT_PARENT(pad));
 #endif
-    GstFlowReturn rc = GST_FLOW_ERROR;
+    GstFlowReturn rc;
+    ZrtpFilterTrace trace;
 
-    if (zrtp->srtcpReceive == NULL) {
-        GST_TRACE_OBJECT(zrtp, "Received upstream RTCP buffer - SRTP inactive");
-        rc = gst_pad_push (zrtp->recv_rtcp_src, gstBuf);
-    }
-    else {
-        rc = zsrtp_unprotectCtrl(zrtp->srtcpReceive, gstBuf);
-        GST_TRACE_OBJECT(zrtp, "Decrypted upstream SRTCP buffer, result: %d", rc);
-        if (rc == 1)
-            rc = gst_pad_push(zrtp->recv_rtcp_src, gstBuf);
-        else {
-            rc = GST_FLOW_ERROR;
-            gst_buffer_unref(gstBuf);
-        }
-    }
+    zrtp_filter_trace_begin(&trace, gstBuf, TRUE);
+    rc = zrtp_filter_rtcp_up(zrtp, zrtp->recv_rtcp_src, gstBuf);
+    ZRTP_FILTER_TRACE_CHAIN(&trace, ZRTP_TRACE_PATH_RECV_RTCP, rc);
     return rc;
 }
 
@@ -1119,25 +2520,365 @@ gst_zrtp_filter_chain_rtcp_down (GstPad * pad, GstBuffer* gstBuf)
     GstZrtpFilter *zrtp = GST_ZRTPFILTER (GST_OBJECT_PARENT (pad));
 #endif
     GstFlowReturn rc = GST_FLOW_ERROR;
-
-    if (zrtp->srtcpSend == NULL) {
+    ZsrtpContextCtrl* srtcp;
+    ZrtpFilterTrace trace;
+    gint slot;
+
+    zrtp_filter_trace_begin(&trace, gstBuf, TRUE);
+    slot = zrtp_filter_read_lock(zrtp);
+    srtcp = g_atomic_pointer_get(&zrtp->srtcpSend);
+    if (srtcp == NULL) {
+        zrtp_filter_read_unlock(zrtp, slot);
         GST_TRACE_OBJECT(zrtp, "Received downstream RTCP buffer - SRTP inactive");
+        zrtp_stats_packet(&zrtp->stats.rtcpSend, gst_buffer_get_size(gstBuf), 0);
         rc = gst_pad_push (zrtp->send_rtcp_src, gstBuf);
     }
     else {
-        rc = zsrtp_protectCtrl(zrtp->srtcpSend, gstBuf);
-        GST_TRACE_OBJECT(zrtp, "Encrypted downstream RTCP buffer, result: %d", rc);
-
-        if (rc == 1)
+        gstBuf = zrtp_filter_protect_rtcp(zrtp, srtcp, gstBuf);
+        zrtp_filter_read_unlock(zrtp, slot);
+        if (gstBuf != NULL)
             rc = gst_pad_push(zrtp->send_rtcp_src, gstBuf);
-        else {
-            rc = GST_FLOW_ERROR;
-            gst_buffer_unref(gstBuf);
+    }
+    ZRTP_FILTER_TRACE_CHAIN(&trace, ZRTP_TRACE_PATH_SEND_RTCP, rc);
+    return rc;
+}
+
+#if GST_CHECK_VERSION(1,0,0)
+/*
+ * Chain list functions. These functions process a whole buffer list in one
+ * pass using the same SRTP/SRTCP context for all buffers of the list and push
+ * the processed list with one call. The foreach callbacks remove buffers that
+ * SRTP dropped from the list.
+ *
+ * RTP lists go through the SRTP batch functions instead: the buffers of the
+ * list move into an array, SRTP authenticates them in chunks with the
+ * multi-buffer HMAC kernel, and a new list takes the remaining buffers.
+ */
+typedef struct _ZrtpListData {
+    GstZrtpFilter*    zrtp;
+    ZsrtpContextCtrl* srtcp;
+    ZrtpSsrcTable*    recv;         /* SRTCP receive contexts */
+} ZrtpListData;
+
+static gboolean
+zrtp_filter_list_rtcp_up(GstBuffer** buffer, guint idx, gpointer userData)
+{
+    ZrtpListData* data = (ZrtpListData*)userData;
+
+    *buffer = zrtp_filter_unprotect_rtcp(data->zrtp, data->recv, gst_buffer_make_writable(*buffer));
+    return TRUE;
+}
+
+static gboolean
+zrtp_filter_list_rtcp_down(GstBuffer** buffer, guint idx, gpointer userData)
+{
+    ZrtpListData* data = (ZrtpListData*)userData;
+
+    *buffer = zrtp_filter_protect_rtcp(data->zrtp, data->srtcp, gst_buffer_make_writable(*buffer));
+    return TRUE;
+}
+
+/* Count the packets of a list that passes without SRTP processing */
+static void
+zrtp_filter_count_list(ZrtpStreamStats* stats, GstBufferList* list)
+{
+    guint i, len = gst_buffer_list_length(list);
+
+    for (i = 0; i < len; i++)
+        zrtp_stats_packet(stats, gst_buffer_get_size(gst_buffer_list_get(list, i)), 0);
+}
+
+static gboolean
+zrtp_filter_list_steal(GstBuffer** buffer, guint idx, gpointer userData)
+{
+    g_queue_push_tail((GQueue*)userData, *buffer);
+    *buffer = NULL;
+    return TRUE;
+}
+
+/* Process the buffers of a list one by one, used while early media or crypto workers are active */
+static GstFlowReturn
+zrtp_filter_split_list(GstZrtpFilter* zrtp, GstBufferList* list, ZrtpPushFunc func)
+{
+    GstFlowReturn rc = GST_FLOW_OK;
+    GstFlowReturn prc;
+    GstBuffer* gstBuf;
+    GQueue buffers = G_QUEUE_INIT;
+
+    list = gst_buffer_list_make_writable(list);
+    gst_buffer_list_foreach(list, zrtp_filter_list_steal, &buffers);
+    gst_buffer_list_unref(list);
+
+    while ((gstBuf = g_queue_pop_head(&buffers)) != NULL) {
+        prc = func(zrtp, gstBuf);
+        if (rc == GST_FLOW_OK)
+            rc = prc;
+    }
+    return rc;
+}
+
+/*
+ * Move the buffers of a list into a new array and make them writable, free
+ * the array with g_free.
+ */
+static GstBuffer**
+zrtp_filter_list_take(GstBufferList* list, guint* count)
+{
+    guint i, len = gst_buffer_list_length(list);
+    GstBuffer** buffers = g_new(GstBuffer*, len);
+
+    for (i = 0; i < len; i++)
+        buffers[i] = gst_buffer_ref(gst_buffer_list_get(list, i));
+    gst_buffer_list_unref(list);
+
+    for (i = 0; i < len; i++)
+        buffers[i] = gst_buffer_make_writable(buffers[i]);
+    *count = len;
+    return buffers;
+}
+
+/* Build a list of the buffers that SRTP did not drop */
+static GstBufferList*
+zrtp_filter_list_make(GstBuffer** buffers, guint count)
+{
+    GstBufferList* list = gst_buffer_list_new_sized(count);
+    guint i;
+
+    for (i = 0; i < count; i++) {
+        if (buffers[i] != NULL)
+            gst_buffer_list_add(list, buffers[i]);
+    }
+    return list;
+}
+
+#define ZRTP_FILTER_BATCH 64
+
+/* Unprotect RTP buffers, replace the dropped ones with NULL, add the errors to signal to errors */
+static void
+zrtp_filter_unprotect_rtp_batch(GstZrtpFilter* zrtp, ZrtpSsrcTable* srtp, GstBuffer** buffers, guint count,
+                                ZrtpFilterErrors* errors)
+{
+    gint32 results[ZRTP_FILTER_BATCH];
+    gsize sizes[ZRTP_FILTER_BATCH];
+    guint64 start, ns;
+    guint i, n;
+
+    for (; count > 0; buffers += n, count -= n) {
+        n = MIN(count, ZRTP_FILTER_BATCH);
+        start = zrtp_stats_now();
+        for (i = 0; i < n; i++)
+            sizes[i] = gst_buffer_get_size(buffers[i]);
+
+        zrtp_ssrc_table_unprotect_batch(srtp, buffers, n, results);
+        GST_TRACE_OBJECT(zrtp, "Decrypted upstream SRTP batch of %u buffers", n);
+
+        ns = ZRTP_TRACE_ENABLED(rtp_unprotect) ? (zrtp_stats_now() - start) / n : 0;
+        for (i = 0; i < n; i++) {
+            ZRTP_FILTER_TRACE(rtp_unprotect, buffers[i], FALSE, sizes[i], results[i], ns);
+            if (results[i] == 1) {
+                zrtp_stats_packet(&zrtp->stats.rtpRecv, sizes[i], 0);
+                continue;
+            }
+            zrtp_filter_srtp_error(zrtp, results[i], errors);
+            gst_buffer_unref(buffers[i]);
+            buffers[i] = NULL;
+        }
+        zrtp_stats_time(&zrtp->stats.rtpRecv, start);
+    }
+}
+
+/* Protect RTP buffers, replace the dropped ones with NULL */
+static void
+zrtp_filter_protect_rtp_batch(GstZrtpFilter* zrtp, ZsrtpContext* srtp, GstBuffer** buffers, guint count)
+{
+    gint32 results[ZRTP_FILTER_BATCH];
+    guint64 start, ns;
+    guint i, n;
+
+    for (; count > 0; buffers += n, count -= n) {
+        n = MIN(count, ZRTP_FILTER_BATCH);
+        start = zrtp_stats_now();
+
+        zsrtp_protectBatch(srtp, buffers, n, results);
+        GST_TRACE_OBJECT(zrtp, "Encrypted downstream RTP batch of %u buffers", n);
+
+        ns = ZRTP_TRACE_ENABLED(rtp_protect) ? (zrtp_stats_now() - start) / n : 0;
+        for (i = 0; i < n; i++) {
+            ZRTP_FILTER_TRACE(rtp_protect, buffers[i], FALSE, gst_buffer_get_size(buffers[i]), results[i], ns);
+            if (results[i] == 1) {
+                zrtp_stats_packet(&zrtp->stats.rtpSend, gst_buffer_get_size(buffers[i]), 0);
+                continue;
+            }
+            gst_buffer_unref(buffers[i]);
+            buffers[i] = NULL;
         }
+        zrtp_stats_time(&zrtp->stats.rtpSend, start);
+    }
+}
+
+/* Push the list if SRTP left some buffers in it, drop an empty list */
+static GstFlowReturn
+zrtp_filter_push_list(GstPad* pad, GstBufferList* list)
+{
+    if (gst_buffer_list_length(list) == 0) {
+        gst_buffer_list_unref(list);
+        return GST_FLOW_OK;
+    }
+    return gst_pad_push_list(pad, list);
+}
+
+/* chain list function - rtp upstream, from UDP to RTP session */
+static GstFlowReturn
+gst_zrtp_filter_chain_list_rtp_up (GstPad* pad, GstObject* parent, GstBufferList* list)
+{
+    GstZrtpFilter* zrtp = GST_ZRTPFILTER (parent);
+    GstFlowReturn rc;
+    GstFlowReturn zrc;
+    GstBuffer* gstBuf;
+    GstBuffer** buffers;
+    ZrtpSsrcTable* recv;
+    GQueue otherPackets = G_QUEUE_INIT;
+    ZrtpFilterErrors errors = { 0, 0 };
+    guint i, count, rtp;
+    gint slot;
+
+    if (G_UNLIKELY(zrtp_early_active(&zrtp->earlyRecv)) || g_atomic_pointer_get(&zrtp->cryptoPool) != NULL)
+        return zrtp_filter_split_list(zrtp, list, zrtp_filter_rtp_up);
+
+    buffers = zrtp_filter_list_take(list, &count);
+
+    /* Collect the other packets, route them after the media data was pushed */
+    for (i = 0, rtp = 0; i < count; i++) {
+        if (zrtp_filter_classify(zrtp, buffers[i]) == ZRTP_CLASS_RTP)
+            buffers[rtp++] = buffers[i];
+        else
+            g_queue_push_tail(&otherPackets, buffers[i]);
+    }
+
+    slot = zrtp_filter_read_lock(zrtp);
+    recv = g_atomic_pointer_get(&zrtp->srtpReceive);
+
+    GST_TRACE_OBJECT(zrtp, "Received upstream RTP buffer list, length: %u, SRTP %s",
+                     count, recv != NULL ? "active" : "inactive");
+
+    if (recv != NULL) {
+        zrtp_filter_unprotect_rtp_batch(zrtp, recv, buffers, rtp, &errors);
+    } else {
+        for (i = 0; i < rtp; i++)
+            zrtp_stats_packet(&zrtp->stats.rtpRecv, gst_buffer_get_size(buffers[i]), 0);
+    }
+    zrtp_filter_read_unlock(zrtp, slot);
+    zrtp_filter_emit_errors(zrtp, &errors);
+
+    list = zrtp_filter_list_make(buffers, rtp);
+    g_free(buffers);
+    rc = zrtp_filter_push_list(zrtp->recv_rtp_src, list);
+
+    if (!zrtp->started && zrtp->enableZrtp)
+        zrtp_filter_startZrtp(zrtp);
+
+    while ((gstBuf = g_queue_pop_head(&otherPackets)) != NULL) {
+        zrc = zrtp_filter_demux_up(zrtp, zrtp_filter_classify(zrtp, gstBuf), gstBuf);
+        if (rc == GST_FLOW_OK)
+            rc = zrc;
     }
     return rc;
 }
 
+/* chain list function - rtp downstream, from RTP session to UDP */
+static GstFlowReturn
+gst_zrtp_filter_chain_list_rtp_down (GstPad* pad, GstObject* parent, GstBufferList* list)
+{
+    GstZrtpFilter* zrtp = GST_ZRTPFILTER (parent);
+    GstBuffer** buffers;
+    ZsrtpContext* srtp;
+    guint count;
+    gint slot;
+
+    if (gst_buffer_list_length(list) == 0) {
+        gst_buffer_list_unref(list);
+        return GST_FLOW_OK;
+    }
+    if (zrtp->localSSRC == 0) {
+        zrtp_filter_learn_ssrc(zrtp, gst_buffer_list_get(list, 0));
+    }
+
+    if (!zrtp->started && zrtp->enableZrtp) {
+        zrtp_filter_startZrtp(zrtp);
+    }
+
+    if (G_UNLIKELY(zrtp_early_active(&zrtp->earlySend)) || g_atomic_pointer_get(&zrtp->cryptoPool) != NULL)
+        return zrtp_filter_split_list(zrtp, list, zrtp_filter_rtp_down);
+
+    slot = zrtp_filter_read_lock(zrtp);
+    srtp = g_atomic_pointer_get(&zrtp->srtpSend);
+
+    if (srtp == NULL) {
+        zrtp_filter_read_unlock(zrtp, slot);
+        GST_TRACE_OBJECT(zrtp, "Received downstream RTP buffer list - SRTP inactive");
+        zrtp_filter_count_list(&zrtp->stats.rtpSend, list);
+        return gst_pad_push_list(zrtp->send_rtp_src, list);
+    }
+    buffers = zrtp_filter_list_take(list, &count);
+    zrtp_filter_protect_rtp_batch(zrtp, srtp, buffers, count);
+    zrtp_filter_read_unlock(zrtp, slot);
+
+    list = zrtp_filter_list_make(buffers, count);
+    g_free(buffers);
+    return zrtp_filter_push_list(zrtp->send_rtp_src, list);
+}
+
+/* chain list function - rtcp upstream, from UDP to RTP session */
+static GstFlowReturn
+gst_zrtp_filter_chain_list_rtcp_up (GstPad* pad, GstObject* parent, GstBufferList* list)
+{
+    GstZrtpFilter* zrtp = GST_ZRTPFILTER (parent);
+    ZrtpListData data;
+    gint slot;
+
+    slot = zrtp_filter_read_lock(zrtp);
+    data.zrtp = zrtp;
+    data.srtcp = NULL;
+    data.recv = g_atomic_pointer_get(&zrtp->srtcpReceive);
+
+    if (data.recv == NULL) {
+        zrtp_filter_read_unlock(zrtp, slot);
+        GST_TRACE_OBJECT(zrtp, "Received upstream RTCP buffer list - SRTP inactive");
+        zrtp_filter_count_list(&zrtp->stats.rtcpRecv, list);
+        return gst_pad_push_list(zrtp->recv_rtcp_src, list);
+    }
+    list = gst_buffer_list_make_writable(list);
+    gst_buffer_list_foreach(list, zrtp_filter_list_rtcp_up, &data);
+    zrtp_filter_read_unlock(zrtp, slot);
+    return zrtp_filter_push_list(zrtp->recv_rtcp_src, list);
+}
+
+/* chain list function - rtcp downstream, from RTP session to UDP */
+static GstFlowReturn
+gst_zrtp_filter_chain_list_rtcp_down (GstPad* pad, GstObject* parent, GstBufferList* list)
+{
+    GstZrtpFilter* zrtp = GST_ZRTPFILTER (parent);
+    ZrtpListData data;
+    gint slot;
+
+    slot = zrtp_filter_read_lock(zrtp);
+    data.zrtp = zrtp;
+    data.srtcp = g_atomic_pointer_get(&zrtp->srtcpSend);
+    data.recv = NULL;
+
+    if (data.srtcp == NULL) {
+        zrtp_filter_read_unlock(zrtp, slot);
+        GST_TRACE_OBJECT(zrtp, "Received downstream RTCP buffer list - SRTP inactive");
+        zrtp_filter_count_list(&zrtp->stats.rtcpSend, list);
+        return gst_pad_push_list(zrtp->send_rtcp_src, list);
+    }
+    list = gst_buffer_list_make_writable(list);
+    gst_buffer_list_foreach(list, zrtp_filter_list_rtcp_down, &data);
+    zrtp_filter_read_unlock(zrtp, slot);
+    return zrtp_filter_push_list(zrtp->send_rtcp_src, list);
+}
+#endif
+
 /* entry point to initialize the plug-in
  * initialize the plug-in itself
  * register the element factories and other features
@@ -1152,8 +2893,12 @@ zrtpfilter_init (GstPlugin * zrtpfilter)
     GST_DEBUG_CATEGORY_INIT (gst_zrtp_filter_debug, "zrtpfilter",
                              0, "Template zrtpfilter");
 
-    return gst_element_register (zrtpfilter, "zrtpfilter", GST_RANK_NONE,
-                                 GST_TYPE_ZRTPFILTER);
+    if (!gst_element_register (zrtpfilter, "zrtpfilter", GST_RANK_NONE,
+                               GST_TYPE_ZRTPFILTER))
+        return FALSE;
+
+    return gst_element_register (zrtpfilter, "zrtpbin", GST_RANK_NONE,
+                                 GST_TYPE_ZRTPBIN);
 }
 
 /* PACKAGE: this is usually set by autotools depending on some _INIT macro
@@ -1188,46 +2933,292 @@ GST_PLUGIN_DEFINE (
 /*
  * Support functions to set various flags and control the ZRTP engine
  */
+/*
+ * Move the preferred key agreement algorithms to the front of the standard
+ * configuration. The Hello packet offers the algorithms in this order and the
+ * peers use the first common one. E255 and EC25 compute the shared secret
+ * much faster than DH3k, this shortens the Commit and DHPart processing.
+ */
+static void
+zrtp_filter_configure_pubkeys(GstZrtpFilter* filter)
+{
+    gchar** names;
+    gint i, pos = 0;
+
+    zrtp_InitializeConfig(filter->zrtpCtx);
+    zrtp_setStandardConfig(filter->zrtpCtx);
+
+    names = g_strsplit(filter->pubKeyAlgos, ",", -1);
+    for (i = 0; names[i] != NULL; i++) {
+        gchar* name = g_strstrip(names[i]);
+
+        if (*name == '\0')
+            continue;
+        zrtp_removeAlgo(filter->zrtpCtx, zrtp_PubKeyAlgorithm, name);
+        if (zrtp_addAlgoAt(filter->zrtpCtx, zrtp_PubKeyAlgorithm, name, pos) < 0) {
+            GST_WARNING_OBJECT(filter, "Unknown ZRTP key agreement algorithm '%s'.", name);
+            continue;
+        }
+        pos++;
+    }
+    g_strfreev(names);
+}
+
+/*
+ * Create the ZRTP wrapper and the mutexes of the engine callbacks and the
+ * context swaps on first use. A filter that never runs ZRTP, e.g. most
+ * filters of a large media server until the calls start, needs none of them.
+ * The streaming threads check zrtpCtx != NULL before they use the engine.
+ */
+static ZrtpContext*
+zrtp_filter_engine(GstZrtpFilter* filter)
+{
+    if (filter->zrtpCtx == NULL) {
+        /* The timers of a previous engine are stopped, see zrtp_filter_stopZrtp() */
+        zrtp_timer_init(&filter->timer, zrtp_filter_timeout, filter);
+        zrtp_timer_init(&filter->reportTimer, zrtp_filter_report_errors, filter);
+        filter->zrtpMutex = g_mutex_new();
+        filter->rcuMutex = g_mutex_new();
+        filter->asyncMutex = g_mutex_new();
+        g_atomic_pointer_set(&filter->zrtpCtx, zrtp_CreateWrapper());
+    }
+    return filter->zrtpCtx;
+}
+
 static
 gboolean zrtp_initialize(GstZrtpFilter* filter, const gchar* zidFilename, gboolean autoEnable)
 {
+    zrtp_filter_engine(filter);
+    if (filter->pubKeyAlgos != NULL)
+        zrtp_filter_configure_pubkeys(filter);
+
     zrtp_initializeZrtpEngine(filter->zrtpCtx, &c_callbacks, filter->clientIdString,
                               zidFilename, filter, filter->mitmMode);
     filter->enableZrtp = autoEnable;
     return TRUE;
 }
 
+/*
+ * Several streaming threads may call this after an unlocked check of
+ * started, only the first one starts the engine. It sets started before it
+ * starts the engine, a ZRTP packet that the engine sends and that comes
+ * back on the same thread does not enter here again. The enable property
+ * does not create the engine, without initialize there is nothing to start.
+ */
 static
 void zrtp_filter_startZrtp(GstZrtpFilter *zrtp)
 {
+    guint interval;
+
+    g_mutex_lock(zrtp->startMutex);
+    if (zrtp->started || zrtp->zrtpCtx == NULL) {
+        g_mutex_unlock(zrtp->startMutex);
+        return;
+    }
+    g_atomic_int_set(&zrtp->started, TRUE);
+
+    ZRTP_STATS_SET(zrtp->stats.handshakeStart, zrtp_stats_now());
+    zrtp->rsMatched = FALSE;
+
+    /* Allocate the early media rings once, hold RTP until SRTP is ready */
+    if (zrtp->earlySend.mutex == NULL) {
+        zrtp_early_init(&zrtp->earlyRecv, zrtp->earlyPackets, zrtp->earlyTime);
+        zrtp_early_init(&zrtp->earlySend, zrtp->earlyPackets, zrtp->earlyTime);
+    }
+    zrtp_early_set_hold(&zrtp->earlyRecv, TRUE);
+    zrtp_early_set_hold(&zrtp->earlySend, TRUE);
+
+    if (zrtp->cryptoWorkers > 0 && zrtp->cryptoPool == NULL)
+        zrtp_filter_start_crypto(zrtp);
+
     zrtp_startZrtpEngine(zrtp->zrtpCtx);
-    zrtp->started = 1;
+    g_mutex_unlock(zrtp->startMutex);
+
+    GST_OBJECT_LOCK(zrtp);
+    interval = zrtp->errorInterval;
+    GST_OBJECT_UNLOCK(zrtp);
+    if (interval > 0)
+        zrtp_timer_arm(&zrtp->reportTimer, interval);
 }
 
 static
 void zrtp_filter_stopZrtp(GstZrtpFilter *zrtp)
 {
     /* TODO: check if we need to unref/free other data */
-    zrtp_stopZrtpEngine(zrtp->zrtpCtx); /* switches off secure mode: zrtp_srtpSecretsOff() */
-    zrtp_DestroyWrapper(zrtp->zrtpCtx);
+    zrtp_filter_stop_crypto(zrtp);      /* drains, before the contexts go away */
+    if (zrtp->zrtpCtx != NULL)
+        zrtp_stopZrtpEngine(zrtp->zrtpCtx); /* switches off secure mode: zrtp_srtpSecretsOff() */
+    /* Waits for running callbacks, a callback cannot arm its timer again */
+    zrtp_timer_cancel_sync(&zrtp->timer);
+    zrtp_timer_cancel_sync(&zrtp->reportTimer);
+    if (zrtp->zrtpCtx != NULL) {
+        zrtp_DestroyWrapper(zrtp->zrtpCtx);
+        g_mutex_free (zrtp->zrtpMutex);
+        g_mutex_free (zrtp->rcuMutex);
+        g_mutex_free (zrtp->asyncMutex);
+    }
+    zrtp_early_free(&zrtp->earlyRecv);
+    zrtp_early_free(&zrtp->earlySend);
     zrtp->zrtpCtx = NULL;
     zrtp->started = 0;
     zrtp->enableZrtp = FALSE;
     g_free(zrtp->cacheName);
-    g_object_unref(zrtp->sysclock);
-    g_mutex_free (zrtp->zrtpMutex);
+    g_free(zrtp->pubKeyAlgos);
+    g_free(zrtp->keyAgreement);
+    zrtp->keyAgreement = NULL;
+    if (zrtp->lastZrtpPacket != NULL) {
+        gst_buffer_unref(zrtp->lastZrtpPacket);
+        zrtp->lastZrtpPacket = NULL;
+    }
+#if GST_CHECK_VERSION(1,0,0)
+    if (zrtp->zrtpPool != NULL) {
+        gst_buffer_pool_set_active(zrtp->zrtpPool, FALSE);
+        gst_object_unref(zrtp->zrtpPool);
+        zrtp->zrtpPool = NULL;
+    }
+#endif
 }
 
 static
-gboolean timer_callback(GstClock *clock, GstClockTime time,
-                        GstClockID id, gpointer userData)
+void zrtp_filter_timeout(gpointer userData)
 {
     GstZrtpFilter *zrtp = GST_ZRTPFILTER (userData);
-    gst_clock_id_unref(zrtp->clockId);
-    zrtp->clockId = NULL;
 
     zrtp_processTimeout(zrtp->zrtpCtx);
-    return TRUE;
+}
+
+/*
+ * Post the SRTP errors of the last interval as one element message. Runs on
+ * the timer wheel thread, the streaming threads only count the errors, thus
+ * a flood of bad packets costs no more than dropping them.
+ */
+static
+void zrtp_filter_report_errors(gpointer userData)
+{
+    GstZrtpFilter *zrtp = GST_ZRTPFILTER (userData);
+    guint64 errors[4];
+    guint64 delta[4];
+    guint interval;
+    guint i;
+
+    GST_OBJECT_LOCK(zrtp);
+    interval = zrtp->errorInterval;
+    GST_OBJECT_UNLOCK(zrtp);
+
+    errors[0] = ZRTP_STATS_GET(zrtp->stats.rtpRecv.authFailures);
+    errors[1] = ZRTP_STATS_GET(zrtp->stats.rtpRecv.replayDrops);
+    errors[2] = ZRTP_STATS_GET(zrtp->stats.rtcpRecv.authFailures);
+    errors[3] = ZRTP_STATS_GET(zrtp->stats.rtcpRecv.replayDrops);
+
+    for (i = 0; i < 4; i++) {
+        delta[i] = errors[i] - zrtp->reportedErrors[i];
+        zrtp->reportedErrors[i] = errors[i];
+    }
+    if (delta[0] != 0 || delta[1] != 0 || delta[2] != 0 || delta[3] != 0) {
+        GstStructure* s;
+
+        GST_WARNING_OBJECT(zrtp, "SRTP errors: %" G_GUINT64_FORMAT " authentication, %" G_GUINT64_FORMAT " replay",
+                           delta[0] + delta[2], delta[1] + delta[3]);
+        s = gst_structure_new("zrtp-srtp-errors",
+                              "rtp-auth-failures", G_TYPE_UINT64, delta[0],
+                              "rtp-replay-drops", G_TYPE_UINT64, delta[1],
+                              "rtcp-auth-failures", G_TYPE_UINT64, delta[2],
+                              "rtcp-replay-drops", G_TYPE_UINT64, delta[3],
+                              "interval", G_TYPE_UINT, interval,
+                              NULL);
+        gst_element_post_message(GST_ELEMENT(zrtp), gst_message_new_element(GST_OBJECT(zrtp), s));
+    }
+
+    /* The interval may have changed meanwhile, 0 stops the reports. A stopping
+     * filter cancelled the timer, arm then fails as well.
+     */
+    GST_OBJECT_LOCK(zrtp);
+    interval = zrtp->started ? zrtp->errorInterval : 0;
+    GST_OBJECT_UNLOCK(zrtp);
+    if (interval > 0)
+        zrtp_timer_arm(&zrtp->reportTimer, interval);
+}
+
+/*
+ * ZRTP packets come from a pool of MAX_ZRTP_SIZE buffers. The filter keeps
+ * the last sent packet: if ZRTP resends the same message, e.g. a DHPart
+ * after a T1 timeout, it reuses that packet and only updates the sequence
+ * number and the CRC. If downstream still holds the packet the filter
+ * copies it, because a pushed buffer must not change.
+ */
+
+/* Returns a buffer of size bytes for a new ZRTP packet */
+static GstBuffer*
+zrtp_filter_zrtp_buffer(GstZrtpFilter* zrtp, guint size)
+{
+#if GST_CHECK_VERSION(1,0,0)
+    GstBuffer* gstBuf = NULL;
+
+    if (zrtp->zrtpPool == NULL) {
+        GstStructure* config;
+
+        zrtp->zrtpPool = gst_buffer_pool_new();
+        config = gst_buffer_pool_get_config(zrtp->zrtpPool);
+        gst_buffer_pool_config_set_params(config, NULL, MAX_ZRTP_SIZE, 0, 0);
+        gst_buffer_pool_set_config(zrtp->zrtpPool, config);
+        gst_buffer_pool_set_active(zrtp->zrtpPool, TRUE);
+    }
+    if (gst_buffer_pool_acquire_buffer(zrtp->zrtpPool, &gstBuf, NULL) != GST_FLOW_OK)
+        return gst_buffer_new_and_alloc(size);
+
+    /* the pool restores the full size when the buffer returns */
+    gst_buffer_set_size(gstBuf, size);
+    return gstBuf;
+#else
+    return gst_buffer_new_and_alloc(size);
+#endif
+}
+
+/* Checks if the ZRTP message is the message of the last sent packet, the CRC space excluded */
+static gboolean
+zrtp_filter_is_resend(GstZrtpFilter* zrtp, const uint8_t* data, int32_t length)
+{
+    gboolean same;
+#if GST_CHECK_VERSION(1,0,0)
+    GstMapInfo mapInfo;
+#endif
+
+    if (zrtp->lastZrtpPacket == NULL || zrtp->lastZrtpLen != length)
+        return FALSE;
+
+#if GST_CHECK_VERSION(1,0,0)
+    if (!gst_buffer_map(zrtp->lastZrtpPacket, &mapInfo, GST_MAP_READ))
+        return FALSE;
+    same = memcmp(mapInfo.data + 12, data, length - CRC_SIZE) == 0;
+    gst_buffer_unmap(zrtp->lastZrtpPacket, &mapInfo);
+#else
+    same = memcmp(GST_BUFFER_DATA(zrtp->lastZrtpPacket) + 12, data, length - CRC_SIZE) == 0;
+#endif
+    return same;
+}
+
+/* Returns the last sent packet if downstream released it, a copy otherwise */
+static GstBuffer*
+zrtp_filter_resend_buffer(GstZrtpFilter* zrtp, guint size)
+{
+    GstBuffer* gstBuf;
+
+    if (gst_buffer_is_writable(zrtp->lastZrtpPacket))
+        return zrtp->lastZrtpPacket;
+
+    gstBuf = zrtp_filter_zrtp_buffer(zrtp, size);
+#if GST_CHECK_VERSION(1,0,0)
+    {
+        GstMapInfo mapInfo;
+
+        g_warn_if_fail(gst_buffer_map(gstBuf, &mapInfo, GST_MAP_WRITE));
+        gst_buffer_extract(zrtp->lastZrtpPacket, 0, mapInfo.data, size);
+        gst_buffer_unmap(gstBuf, &mapInfo);
+    }
+#else
+    memcpy(GST_BUFFER_DATA(gstBuf), GST_BUFFER_DATA(zrtp->lastZrtpPacket), size);
+#endif
+    return gstBuf;
 }
 
 /*
@@ -1241,9 +3232,15 @@ gint32 zrtp_sendDataZRTP(ZrtpContext* ctx, const uint8_t* data, int32_t length)
     GstZrtpFilter *zrtp = GST_ZRTPFILTER (ctx->userData);
 
     guint totalLen = length + 12;     /* Fixed number of bytes of ZRTP header */
+    guint64 start = ZRTP_TRACE_ENABLED(zrtp_send) ? zrtp_stats_now() : 0;
+    guint16 seq;
+    gint32 rc;
     guint32 crc;
     guint16* pus;
     guint32* pui;
+    guint8* buffer;
+    GstBuffer* gstBuf;
+    gboolean resend;
 #if GST_CHECK_VERSION(1,0,0)
     GstMapInfo mapInfo;
 #endif
@@ -1251,46 +3248,61 @@ gint32 zrtp_sendDataZRTP(ZrtpContext* ctx, const uint8_t* data, int32_t length)
     if ((totalLen) > MAX_ZRTP_SIZE)
         return 0;
 
-    /* TODO: check to use gst_pad_alloc_buffer ()
-     */
-    GstBuffer* gstBuf = gst_buffer_new_and_alloc(totalLen);
+    /* ZRTP resends the same message if the peer does not answer in time */
+    ZRTP_STATS_ADD(zrtp->stats.zrtpSent, 1);
+    if (zrtp_filter_is_resend(zrtp, data, length)) {
+        ZRTP_STATS_ADD(zrtp->stats.zrtpRetransmits, 1);
+        gstBuf = zrtp_filter_resend_buffer(zrtp, totalLen);
+        resend = TRUE;
+    } else {
+        gstBuf = zrtp_filter_zrtp_buffer(zrtp, totalLen);
+        resend = FALSE;
+    }
 #if GST_CHECK_VERSION(1,0,0)
-    guint8* buffer;
-
-    g_warn_if_fail(gst_buffer_map(gstBuf,&mapInfo, GST_MAP_READWRITE));
+    g_warn_if_fail(gst_buffer_map(gstBuf, &mapInfo, GST_MAP_READWRITE));
     buffer = mapInfo.data;
 #else
-    guint8* buffer = GST_BUFFER_DATA(gstBuf);
+    buffer = GST_BUFFER_DATA(gstBuf);
 #endif
 
     /* Get some handy pointers */
     pus = (guint16*)buffer;
     pui = (guint32*)buffer;
 
-    /* set up fixed ZRTP header */
+    /* set up fixed ZRTP header, a resent packet only needs a new seq number and CRC */
     *buffer = 0x10;     /* invalid RTP version - refer to ZRTP spec chap 5 */
     *(buffer + 1) = 0;
-    pus[1] = g_htons(zrtp->zrtpSeq);
-    zrtp->zrtpSeq++;
+    seq = zrtp->zrtpSeq++;
+    pus[1] = g_htons(seq);
     pui[1] = g_htonl(ZRTP_MAGIC);
     pui[2] = g_htonl(zrtp->localSSRC);   /* stored in host order */
 
     /* store ZRTP message data after the header data */
-    g_memmove(buffer+12, data, length);
+    if (!resend)
+        memcpy(buffer+12, data, length);
 
-    /* Setup and compute ZRTP CRC */
-    crc = zrtp_GenerateCksum(buffer, totalLen-CRC_SIZE);
-
-    /* convert and store CRC in ZRTP packet.*/
-    crc = zrtp_EndCksum(crc);
-    *(guint32*)(buffer+totalLen-CRC_SIZE) = g_htonl(crc);
+    /* Compute the ZRTP CRC and store it in little endian order, see gstzrtpcrc.h */
+    crc = zrtp_crc32c(buffer, totalLen-CRC_SIZE);
+    GST_WRITE_UINT32_LE(buffer+totalLen-CRC_SIZE, crc);
 #if GST_CHECK_VERSION(1,0,0)
     gst_buffer_unmap(gstBuf, &mapInfo);
 #endif
 
+    /* Keep the packet for retransmits, downstream gets its own reference */
+    if (zrtp->lastZrtpPacket != gstBuf) {
+        if (zrtp->lastZrtpPacket != NULL)
+            gst_buffer_unref(zrtp->lastZrtpPacket);
+        zrtp->lastZrtpPacket = gstBuf;
+        zrtp->lastZrtpLen = length;
+    }
+    gst_buffer_ref(gstBuf);
+
     GST_TRACE_OBJECT(zrtp, "Send ZRTP packet downstream.");
     /* Send the ZRTP packet using the downstream plugin */
-    return (gst_pad_push (zrtp->send_rtp_src, gstBuf) == GST_FLOW_OK) ? 1 : 0;
+    rc = (gst_pad_push (zrtp->send_rtp_src, gstBuf) == GST_FLOW_OK) ? 1 : 0;
+    if (ZRTP_TRACE_ENABLED(zrtp_send))
+        ZRTP_TRACE5(zrtp_send, zrtp->localSSRC, seq, totalLen, rc, zrtp_stats_now() - start);
+    return rc;
 }
 
 static
@@ -1298,18 +3310,7 @@ gint32 zrtp_activateTimer(ZrtpContext* ctx, int32_t time)
 {
     GstZrtpFilter *zrtp = GST_ZRTPFILTER (ctx->userData);
 
-    GstClockTime timeout = gst_clock_get_time(zrtp->sysclock);
-    timeout = GST_TIME_AS_MSECONDS(timeout) + time;
-
-    zrtp->clockId = gst_clock_new_single_shot_id(zrtp->sysclock, timeout*GST_MSECOND);
-
-#if GST_CHECK_VERSION(1,0,0)
-    /*GstClockReturn ret =*/ gst_clock_id_wait_async(zrtp->clockId, &timer_callback, zrtp, NULL);
-#else
-    /*GstClockReturn ret =*/ gst_clock_id_wait_async(zrtp->clockId, &timer_callback, zrtp);
-#endif
-
-    return 1;
+    return zrtp_timer_arm(&zrtp->timer, time) ? 1 : 0;
 }
 
 static
@@ -1317,11 +3318,7 @@ gint32 zrtp_cancelTimer(ZrtpContext* ctx)
 {
     GstZrtpFilter *zrtp = GST_ZRTPFILTER (ctx->userData);
 
-    if (zrtp->clockId) {
-        gst_clock_id_unschedule (zrtp->clockId);
-        gst_clock_id_unref(zrtp->clockId);
-        zrtp->clockId = NULL;
-    }
+    zrtp_timer_cancel(&zrtp->timer);
     return 1;
 }
 
@@ -1330,9 +3327,34 @@ void zrtp_sendInfo(ZrtpContext* ctx, int32_t severity, int32_t subCode)
 {
     GstZrtpFilter *zrtp = GST_ZRTPFILTER (ctx->userData);
 
+    if (severity == zrtp_Info && subCode == zrtp_InfoRSMatchFound)
+        zrtp->rsMatched = TRUE;
+
     g_signal_emit (zrtp, gst_zrtp_filter_signals[SIGNAL_STATUS], 0, severity, subCode);
 }
 
+/*
+ * Get the key agreement from the secure state cipher string. ZRTP reports
+ * "cipher/pubkey[/EndAtMitM]" for a DH session and "cipher[/EndAtMitM]" for
+ * a multi-stream session.
+ */
+static gchar*
+zrtp_filter_key_agreement(ZrtpContext* ctx, const gchar* cipher)
+{
+    const gchar* start;
+    const gchar* end;
+
+    if (zrtp_isMultiStream(ctx))
+        return g_strdup("Mult");
+
+    start = strchr(cipher, '/');
+    if (start == NULL)
+        return g_strdup("unknown");
+    start++;
+    end = strchr(start, '/');
+    return end != NULL ? g_strndup(start, end - start) : g_strdup(start);
+}
+
 static int32_t zrtp_srtpSecretsReady(ZrtpContext* ctx, C_SrtpSecret_t* secrets, int32_t part)
 {
     GstZrtpFilter *zrtp = GST_ZRTPFILTER (ctx->userData);
@@ -1341,6 +3363,8 @@ static int32_t zrtp_srtpSecretsReady(ZrtpContext* ctx, C_SrtpSecret_t* secrets,
     ZsrtpContext* recvCrypto;
     ZsrtpContext* senderCrypto;
     ZsrtpContextCtrl* recvCryptoCtrl;
+    ZrtpSsrcTable* recvTable;
+    ZrtpSsrcTable* recvTableCtrl;
     ZsrtpContextCtrl* senderCryptoCtrl;
     gint cipher;
     gint authn;
@@ -1365,6 +3389,29 @@ static int32_t zrtp_srtpSecretsReady(ZrtpContext* ctx, C_SrtpSecret_t* secrets,
     if (secrets->symEncAlgorithm == zrtp_TwoFish)
         cipher = SrtpEncryptionTWOCM;
 
+    /* ZRTP has no cipher type for AEAD SRTP transforms. Both peers must
+     * enable AES-GCM out of band, the ZRTP negotiated keys are the master
+     * keys, the first 96 bit of the negotiated salts the master salts of the
+     * AES-GCM transform, RFC 7714 chapter 12.
+     */
+    if (cipher == SrtpEncryptionAESCM && zrtp->srtpAead) {
+        cipher = SrtpEncryptionAESGCM;
+        GST_DEBUG_OBJECT(zrtp, "Use AES-GCM SRTP transform.");
+    }
+
+    /* The same holds for the NULL cipher. It replaces any cipher including
+     * AES-GCM and requires HMAC-SHA1, both peers fall back to the
+     * negotiated cipher otherwise.
+     */
+    if (zrtp->srtpAuthOnly) {
+        if (authn == SrtpAuthenticationSha1Hmac) {
+            cipher = SrtpEncryptionNull;
+            GST_DEBUG_OBJECT(zrtp, "Use SRTP NULL cipher, authentication only.");
+        } else {
+            GST_WARNING_OBJECT(zrtp, "SRTP authentication only requires HMAC-SHA1, using the negotiated cipher.");
+        }
+    }
+
     if (part == ForSender) {
         GST_DEBUG_OBJECT(zrtp, "Activate SRTP/SRTCP for sender (downstream).");
         // To encrypt packets: intiator uses initiator keys,
@@ -1435,10 +3482,13 @@ static int32_t zrtp_srtpSecretsReady(ZrtpContext* ctx, C_SrtpSecret_t* secrets,
         // case: the key derivation is defined as 2^48
         // which is effectively 0.
         zsrtp_deriveSrtpKeys(senderCrypto, 0L);
-        zrtp->srtpSend = senderCrypto;
-
         zsrtp_deriveSrtpKeysCtrl(senderCryptoCtrl);
-        zrtp->srtcpSend = senderCryptoCtrl;
+        senderCrypto->meta = zrtp->srtpMeta;
+        zrtp_filter_swap_send(zrtp, senderCrypto, senderCryptoCtrl);
+        if (cipher == SrtpEncryptionNull)
+            ZRTP_STATS_ADD(zrtp->stats.authOnlySend, 1);
+        zrtp_filter_release_early(zrtp, &zrtp->earlySend, g_atomic_pointer_get(&zrtp->cryptoPool) == NULL ?
+                                  zrtp_filter_push_rtp_down : NULL);
     }
     if (part == ForReceiver) {
         GST_DEBUG_OBJECT(zrtp, "Activate SRTP/SRTCP for receiver (upstream).");
@@ -1503,20 +3553,28 @@ static int32_t zrtp_srtpSecretsReady(ZrtpContext* ctx, C_SrtpSecret_t* secrets,
         if (recvCrypto == NULL) {
             return 0;
         }
-        // Create a SRTP crypto context for real SSRC input stream.
-        // If the sender didn't provide a SSRC just insert the template
-        // into the queue. After we received the first packet the real
-        // crypto context will be created.
+        // The crypto contexts are templates for the receive SSRC tables.
+        // The tables create the real crypto context of a SSRC when the
+        // first packet of this SSRC arrives, thus one ZRTP session covers
+        // all streams of the peer.
         //
         // Note: key derivation can be done at this time only if the
         // key derivation rate is 0 (disabled). For ZRTP this is the
         // case: the key derivation is defined as 2^48
         // which is effectively 0.
         zsrtp_deriveSrtpKeys(recvCrypto, 0L);
-        zrtp->srtpReceive = recvCrypto;
-
         zsrtp_deriveSrtpKeysCtrl(recvCryptoCtrl);
-        zrtp->srtcpReceive = recvCryptoCtrl;
+        recvCrypto->meta = zrtp->srtpMeta;     /* the SSRC table forks inherit it */
+        zsrtp_setReplayWindow(recvCrypto, zrtp->replayWindow);
+        recvTable = zrtp_ssrc_table_new(recvCrypto, NULL, zrtp->maxSsrc);
+        recvTableCtrl = zrtp_ssrc_table_new(NULL, recvCryptoCtrl, zrtp->maxSsrc);
+        zrtp_ssrc_table_set_peer(recvTable, zrtp->peerSSRC);
+        if (recvTableCtrl != NULL)
+            zrtp_ssrc_table_set_peer(recvTableCtrl, zrtp->peerSSRC);
+        zrtp_filter_swap_receive(zrtp, recvTable, recvTableCtrl);
+        if (cipher == SrtpEncryptionNull)
+            ZRTP_STATS_ADD(zrtp->stats.authOnlyRecv, 1);
+        zrtp_filter_release_early(zrtp, &zrtp->earlyRecv, zrtp_filter_push_held_rtp_up);
     }
 
     return 1;
@@ -1528,16 +3586,10 @@ void zrtp_srtpSecretsOff(ZrtpContext* ctx, int32_t part)
     GstZrtpFilter *zrtp = GST_ZRTPFILTER (ctx->userData);
 
     if (part == ForSender) {
-        zsrtp_DestroyWrapper(zrtp->srtpSend);
-        zsrtp_DestroyWrapperCtrl(zrtp->srtcpSend);
-        zrtp->srtpSend = NULL;
-        zrtp->srtcpSend = NULL;
+        zrtp_filter_swap_send(zrtp, NULL, NULL);
     }
     if (part == ForReceiver) {
-        zsrtp_DestroyWrapper(zrtp->srtpReceive);
-        zsrtp_DestroyWrapperCtrl(zrtp->srtcpReceive);
-        zrtp->srtpReceive = NULL;
-        zrtp->srtcpReceive = NULL;
+        zrtp_filter_swap_receive(zrtp, NULL, NULL);
     }
     g_signal_emit(zrtp, gst_zrtp_filter_signals[SIGNAL_SECURITY_OFF], 0);
 }
@@ -1547,6 +3599,21 @@ void zrtp_srtpSecretsOn(ZrtpContext* ctx, char* c, char* s, int32_t verified)
 {
     GstZrtpFilter *zrtp = GST_ZRTPFILTER (ctx->userData);
 
+    guint64 start = ZRTP_STATS_GET(zrtp->stats.handshakeStart);
+
+    if (start != 0) {
+        ZRTP_STATS_SET(zrtp->stats.handshakeDuration, zrtp_stats_now() - start);
+        ZRTP_STATS_SET(zrtp->stats.handshakeStart, 0);
+    }
+
+    gchar* agreement = zrtp_filter_key_agreement(ctx, c);
+
+    GST_OBJECT_LOCK(zrtp);
+    g_free(zrtp->keyAgreement);
+    zrtp->keyAgreement = agreement;
+    GST_OBJECT_UNLOCK(zrtp);
+    g_object_notify(G_OBJECT(zrtp), "key-agreement");
+
     gchar* galgo = g_strdup(c); /* duplicate to make if available for g_free() */
     g_signal_emit (zrtp, gst_zrtp_filter_signals[SIGNAL_ALGORITHM], 0, galgo, verified);
 
@@ -1565,6 +3632,9 @@ static
 void zrtp_zrtpNegotiationFailed(ZrtpContext* ctx, int32_t severity, int32_t subCode)
 {
     GstZrtpFilter *zrtp = GST_ZRTPFILTER (ctx->userData);
+
+    /* No SRTP, release the held packets in the clear */
+    zrtp_filter_release_early_all(zrtp);
     g_signal_emit(zrtp, gst_zrtp_filter_signals[SIGNAL_NEGOTIATION], 0, severity, subCode);
 }
 
@@ -1573,6 +3643,7 @@ void zrtp_zrtpNotSuppOther(ZrtpContext* ctx)
 {
     GstZrtpFilter *zrtp = GST_ZRTPFILTER (ctx->userData);
 
+    zrtp_filter_release_early_all(zrtp);
     g_signal_emit(zrtp, gst_zrtp_filter_signals[SIGNAL_NOT_SUPP], 0);
 }
 
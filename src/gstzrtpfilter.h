@@ -51,6 +51,11 @@
 #include <libzrtpcpp/ZrtpCWrapper.h>
 
 #include "gstSrtpCWrapper.h"
+#include "gstzrtpssrctable.h"
+#include "gstzrtpstats.h"
+#include "gstzrtptimer.h"
+#include "gstzrtpearly.h"
+#include "gstzrtpcrypto.h"
 
 G_BEGIN_DECLS
 
@@ -256,6 +261,12 @@ typedef enum {
 
 #define GST_IS_ZRTPFILTER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_ZRTPFILTER))
 
+/* Receive contexts of a crypto worker, forked from the current receive table */
+typedef struct _ZrtpCryptoRecv {
+    ZrtpSsrcTable* table;
+    gint generation;            /* recvGeneration the table belongs to */
+} ZrtpCryptoRecv;
+
 typedef struct _GstZrtpFilter      GstZrtpFilter;
 typedef struct _GstZrtpFilterClass GstZrtpFilterClass;
 
@@ -274,6 +285,7 @@ struct _GstZrtpFilter
 
     GstPad  *recv_rtp_sink;
     GstPad  *recv_rtp_src;
+    GstPad  *recv_other_src;    /* request pad, STUN, DTLS and other non RTP packets */
 
     GstPad  *send_rtcp_sink;
     GstPad  *send_rtcp_src;
@@ -281,36 +293,78 @@ struct _GstZrtpFilter
     GstPad  *send_rtp_sink;
     GstPad  *send_rtp_src;
 
-    guint64  protect;
-    guint64  unprotect;
-    gint32   unprotect_err;
+    ZrtpStats stats;
     gint32   refcount;
 
-    /* Clock for current ZRTP protocol timeout */
-    GstClock   *sysclock;
-    GstClockID clockId;
-
-    GMutex* zrtpMutex;
-    ZsrtpContext* srtpReceive;
+    /* Current ZRTP protocol timeout, runs on the shared timer wheel */
+    ZrtpTimer timer;
+
+    /* Aggregated SRTP error reports, see zrtp_filter_report_errors() */
+    ZrtpTimer reportTimer;
+    guint errorInterval;            /* ms between error messages, 0 disables them */
+    gboolean errorSignals;          /* emit a status signal per SRTP error */
+    gboolean srtpMeta;              /* attach a GstZrtpSrtpMeta to SRTP processed RTP buffers */
+    guint64 reportedErrors[4];      /* error counters at the last report */
+
+    GMutex* zrtpMutex;      /* this and the other mutexes exist with zrtpCtx only */
+
+    /* The streaming threads read the crypto context pointers without a lock,
+     * the ZRTP engine swaps them and waits for a grace period before it frees
+     * the old contexts. See zrtp_filter_read_lock() and friends.
+     */
+    volatile gint rcuEpoch;
+    volatile gint rcuReaders[2];
+    GMutex* rcuMutex;
+    ZrtpSsrcTable* srtpReceive;         /* receive contexts per remote SSRC */
     ZsrtpContext* srtpSend;
-    ZsrtpContextCtrl* srtcpReceive;
+    ZrtpSsrcTable* srtcpReceive;
+    GMutex* srtcpRecvMutex;             /* RTCP and, with rtcp-mux, RTP receive thread */
     ZsrtpContextCtrl* srtcpSend;
-    GstBuffer* sendBuffer;
-    GstBuffer* sendBufferCtrl;
-    GstBuffer* zrtpBuffer;
-    gint32  sendBufferLen;
+    GstBuffer* lastZrtpPacket;  /* last sent ZRTP packet, detects and resends retransmits */
+    gint32  lastZrtpLen;        /* length of its ZRTP message */
+#if GST_CHECK_VERSION(1,0,0)
+    GstBufferPool* zrtpPool;    /* MAX_ZRTP_SIZE buffers for ZRTP packets */
+#endif
     guint32 peerSSRC;       /* stored in host order */
     guint32 localSSRC;      /* stored in host order */
     gchar* clientIdString;
     gchar* cacheName;
+    gchar* pubKeyAlgos;     /* preferred key agreement algorithms, comma separated */
+    gchar* keyAgreement;    /* negotiated key agreement, protected by the object lock */
+    gboolean rsMatched;     /* a retained secret matched in the last negotiation */
     gboolean gotMultiParam;
     ZrtpContext* zrtpCtx;
     ZrtpContext* masterCtx;
     guint16 zrtpSeq;
     gboolean enableZrtp;
     gboolean started;
+    GMutex* startMutex;     /* serializes zrtp_filter_startZrtp(), lives with the element */
     gboolean close_slave;
     gboolean mitmMode;
+    gboolean srtpAead;      /* use AES-GCM instead of AES-CM/HMAC if possible */
+    gboolean srtpAuthOnly;  /* use the NULL cipher, SRTP authentication only */
+    gboolean slim;          /* RTCP pads on request only, construct-only */
+    guint maxSsrc;          /* size of the receive SSRC tables */
+    guint replayWindow;     /* SRTP replay window in packets */
+    gboolean rtcpMux;       /* demultiplex RTCP received on the RTP sink pad */
+
+    /* ZRTP messages waiting for the worker pool, see zrtp_filter_handle_zrtp() */
+    gboolean asyncZrtp;
+    gboolean asyncScheduled;
+    GQueue asyncQueue;
+    GMutex* asyncMutex;
+
+    /* RTP packets held during the handshake, see zrtp_filter_early_media() */
+    ZrtpEarlyRing earlyRecv;
+    ZrtpEarlyRing earlySend;
+    guint earlyPackets;     /* ring size, 0 disables holding */
+    guint earlyTime;        /* maximum age of held packets in ms */
+
+    /* SRTP worker threads, see zrtp_filter_crypto_up() */
+    ZrtpCryptoPool* cryptoPool;
+    guint cryptoWorkers;    /* 0 processes SRTP in the streaming threads */
+    ZrtpCryptoRecv cryptoRecv[ZRTP_CRYPTO_MAX_WORKERS];
+    volatile gint recvGeneration;   /* counts swaps of the receive contexts */
 
 };
 
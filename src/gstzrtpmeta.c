@@ -0,0 +1,103 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "gstzrtpmeta.h"
+
+#if GST_CHECK_VERSION(1,0,0)
+GType
+gst_zrtp_srtp_meta_api_get_type(void)
+{
+    static volatile GType type = 0;
+    static const gchar* tags[] = { NULL };
+
+    if (g_once_init_enter(&type)) {
+        GType api = gst_meta_api_type_register("GstZrtpSrtpMetaAPI", tags);
+        g_once_init_leave(&type, api);
+    }
+    return type;
+}
+
+static gboolean
+gst_zrtp_srtp_meta_init(GstMeta* meta, gpointer params, GstBuffer* buffer)
+{
+    GstZrtpSrtpMeta* m = (GstZrtpSrtpMeta*)meta;
+
+    m->ssrc = 0;
+    m->seq = 0;
+    m->headerLength = 0;
+    m->index = 0;
+    m->flags = (GstZrtpSrtpMetaFlags)0;
+    return TRUE;
+}
+
+/* The meta describes the whole packet, keep it on copies of all of it only */
+static gboolean
+gst_zrtp_srtp_meta_transform(GstBuffer* dest, GstMeta* meta, GstBuffer* buffer,
+                             GQuark type, gpointer data)
+{
+    GstZrtpSrtpMeta* m = (GstZrtpSrtpMeta*)meta;
+
+    if (GST_META_TRANSFORM_IS_COPY(type)) {
+        GstMetaTransformCopy* copy = (GstMetaTransformCopy*)data;
+
+        if (!copy->region || (copy->offset == 0 && copy->size == gst_buffer_get_size(buffer)))
+            gst_buffer_add_zrtp_srtp_meta(dest, m->ssrc, m->seq, m->headerLength, m->index, m->flags);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+const GstMetaInfo*
+gst_zrtp_srtp_meta_get_info(void)
+{
+    static const GstMetaInfo* info = NULL;
+
+    if (g_once_init_enter(&info)) {
+        const GstMetaInfo* mi = gst_meta_register(GST_ZRTP_SRTP_META_API_TYPE, "GstZrtpSrtpMeta",
+                                                  sizeof(GstZrtpSrtpMeta), gst_zrtp_srtp_meta_init,
+                                                  NULL, gst_zrtp_srtp_meta_transform);
+        g_once_init_leave(&info, mi);
+    }
+    return info;
+}
+
+GstZrtpSrtpMeta*
+gst_buffer_add_zrtp_srtp_meta(GstBuffer* buffer, guint32 ssrc, guint16 seq,
+                              guint headerLength, guint64 index, GstZrtpSrtpMetaFlags flags)
+{
+    GstZrtpSrtpMeta* m = gst_buffer_get_zrtp_srtp_meta(buffer);
+
+    if (m == NULL)
+        m = (GstZrtpSrtpMeta*)gst_buffer_add_meta(buffer, GST_ZRTP_SRTP_META_INFO, NULL);
+    if (m == NULL)
+        return NULL;
+
+    m->ssrc = ssrc;
+    m->seq = seq;
+    m->headerLength = headerLength;
+    m->index = index;
+    m->flags = flags;
+    return m;
+}
+#endif
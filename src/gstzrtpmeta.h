@@ -0,0 +1,76 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_ZRTP_META_H__
+#define __GST_ZRTP_META_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Parsed RTP header and SRTP state of a packet.
+ *
+ * If the srtp-meta property is set the filter attaches this meta to each RTP
+ * buffer that SRTP protected or that passed the SRTP authentication and
+ * replay checks, in both directions. Downstream elements and pad probes then
+ * read the SSRC, the sequence number and the header length without mapping
+ * the buffer again, and the SRTP index (ROC << 16 | seq) without tracking
+ * the ROC of the stream. Buffers that pass while SRTP is inactive carry no
+ * meta. The meta requires GStreamer 1.x.
+ *
+ * Elements that do not link with the filter find the API type by its name
+ * with g_type_from_name("GstZrtpSrtpMetaAPI") and use the structure layout
+ * below.
+ */
+typedef enum {
+    GST_ZRTP_SRTP_META_ENCRYPTED     = (1 << 0),    /* payload was encrypted or decrypted */
+    GST_ZRTP_SRTP_META_AUTHENTICATED = (1 << 1)     /* tag was computed or checked */
+} GstZrtpSrtpMetaFlags;
+
+#if GST_CHECK_VERSION(1,0,0)
+typedef struct _GstZrtpSrtpMeta {
+    GstMeta meta;
+
+    guint32 ssrc;
+    guint16 seq;
+    guint   headerLength;       /* including CSRCs and extension */
+    guint64 index;              /* 48 bit SRTP index, ROC << 16 | seq */
+    GstZrtpSrtpMetaFlags flags;
+} GstZrtpSrtpMeta;
+
+GType gst_zrtp_srtp_meta_api_get_type(void);
+#define GST_ZRTP_SRTP_META_API_TYPE (gst_zrtp_srtp_meta_api_get_type())
+
+const GstMetaInfo* gst_zrtp_srtp_meta_get_info(void);
+#define GST_ZRTP_SRTP_META_INFO (gst_zrtp_srtp_meta_get_info())
+
+#define gst_buffer_get_zrtp_srtp_meta(b) \
+    ((GstZrtpSrtpMeta*)gst_buffer_get_meta((b), GST_ZRTP_SRTP_META_API_TYPE))
+
+/* Add or update the meta of a buffer, the buffer must be writable */
+GstZrtpSrtpMeta* gst_buffer_add_zrtp_srtp_meta(GstBuffer* buffer, guint32 ssrc, guint16 seq,
+                                               guint headerLength, guint64 index,
+                                               GstZrtpSrtpMetaFlags flags);
+#endif
+
+G_END_DECLS
+
+#endif /* __GST_ZRTP_META_H__ */
@@ -0,0 +1,375 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gstzrtpssrctable.h"
+#include "gstzrtpstats.h"
+
+ZrtpSsrcTable*
+zrtp_ssrc_table_new(ZsrtpContext* srtp, ZsrtpContextCtrl* srtcp, guint size)
+{
+    ZrtpSsrcTable* table;
+
+    g_return_val_if_fail((srtp == NULL) != (srtcp == NULL), NULL);
+
+    size = CLAMP(size, 1, ZRTP_SSRC_TABLE_MAX_SIZE);
+    table = g_malloc0(sizeof(ZrtpSsrcTable) + (size - 1) * sizeof(ZrtpSsrcEntry));
+    table->srtp = srtp;
+    table->srtcp = srtcp;
+    table->size = size;
+    return table;
+}
+
+ZrtpSsrcTable*
+zrtp_ssrc_table_fork(ZrtpSsrcTable* table)
+{
+    ZsrtpContext* srtp;
+
+    g_return_val_if_fail(table->srtp != NULL, NULL);
+
+    ZrtpSsrcTable* fork;
+
+    srtp = zsrtp_newCryptoContextForSSRC(table->srtp, 0, 0, 0L);
+    if (srtp == NULL)
+        return NULL;
+    zsrtp_deriveSrtpKeys(srtp, 0L);
+    fork = zrtp_ssrc_table_new(srtp, NULL, table->size);
+    if (table->hasPeer)
+        zrtp_ssrc_table_set_peer(fork, table->peer);
+    return fork;
+}
+
+static void
+zrtp_ssrc_entry_clear(ZrtpSsrcEntry* entry)
+{
+    zsrtp_DestroyWrapper(entry->srtp);
+    zsrtp_DestroyWrapperCtrl(entry->srtcp);
+    memset(entry, 0, sizeof(ZrtpSsrcEntry));
+}
+
+void
+zrtp_ssrc_table_free(ZrtpSsrcTable* table)
+{
+    guint i;
+
+    if (table == NULL)
+        return;
+
+    for (i = 0; i < table->size; i++) {
+        if (table->entries[i].lastUse != 0)
+            zrtp_ssrc_entry_clear(&table->entries[i]);
+    }
+    zsrtp_DestroyWrapper(table->srtp);
+    zsrtp_DestroyWrapperCtrl(table->srtcp);
+    g_free(table);
+}
+
+/* Find the entry of a SSRC, NULL if the table has no entry for it */
+static ZrtpSsrcEntry*
+zrtp_ssrc_table_find(ZrtpSsrcTable* table, guint32 ssrc)
+{
+    ZrtpSsrcEntry* entry = table->last;
+    guint i;
+
+    if (entry != NULL && entry->ssrc == ssrc)
+        return entry;
+
+    for (i = 0, entry = table->entries; i < table->size; i++, entry++) {
+        if (entry->lastUse != 0 && entry->ssrc == ssrc)
+            return entry;
+    }
+    return NULL;
+}
+
+/* Get a free entry, evict the least recently used one if the table is full */
+static ZrtpSsrcEntry*
+zrtp_ssrc_table_alloc(ZrtpSsrcTable* table)
+{
+    ZrtpSsrcEntry* lru = &table->entries[0];
+    guint i;
+
+    for (i = 0; i < table->size; i++) {
+        ZrtpSsrcEntry* entry = &table->entries[i];
+
+        if (entry->lastUse == 0)
+            return entry;
+        if (entry->lastUse < lru->lastUse)
+            lru = entry;
+    }
+    GST_DEBUG("Evict receive crypto context of SSRC 0x%08x", lru->ssrc);
+    if (table->last == lru)
+        table->last = NULL;
+    zrtp_ssrc_entry_clear(lru);
+    return lru;
+}
+
+static void
+zrtp_ssrc_table_touch(ZrtpSsrcTable* table, ZrtpSsrcEntry* entry)
+{
+    /* Restart the stamps on wrap, 0 marks a free entry */
+    if (++table->clock == 0) {
+        guint i;
+
+        for (i = 0; i < table->size; i++) {
+            if (table->entries[i].lastUse != 0)
+                table->entries[i].lastUse = 1;
+        }
+        table->clock = 2;
+    }
+    entry->lastUse = table->clock;
+    table->last = entry;
+}
+
+static gboolean
+zrtp_ssrc_table_get_ssrc(GstBuffer* buffer, gsize offset, guint32* ssrc)
+{
+    guint32 nssrc;
+
+    if (gst_buffer_extract(buffer, offset, &nssrc, sizeof(nssrc)) != sizeof(nssrc))
+        return FALSE;
+    *ssrc = g_ntohl(nssrc);
+    return TRUE;
+}
+
+/* Find the reject slot of a SSRC whose window is still open */
+static ZrtpSsrcReject*
+zrtp_ssrc_table_find_reject(ZrtpSsrcTable* table, guint32 ssrc, guint64 now)
+{
+    guint i;
+
+    for (i = 0; i < ZRTP_SSRC_REJECT_SIZE; i++) {
+        if (table->rejected[i].until > now && table->rejected[i].ssrc == ssrc)
+            return &table->rejected[i];
+    }
+    return NULL;
+}
+
+/* Check if a new SSRC may fork a context, see the rate limit in gstzrtpssrctable.h */
+static gboolean
+zrtp_ssrc_table_admit(ZrtpSsrcTable* table, guint32 ssrc, guint64 now)
+{
+    ZrtpSsrcReject* reject;
+
+    if (!table->hasPeer || ssrc != table->peer) {
+        reject = zrtp_ssrc_table_find_reject(table, ssrc, now);
+        if (reject != NULL && reject->failures >= ZRTP_SSRC_REJECT_FAILURES)
+            return FALSE;
+    }
+    if (now - table->newStart >= ZRTP_SSRC_NEW_INTERVAL) {
+        table->newStart = now;
+        table->newCount = 0;
+    }
+    if (table->newCount >= ZRTP_SSRC_NEW_BURST) {
+        GST_LOG("New SSRC 0x%08x over the rate limit", ssrc);
+        return FALSE;
+    }
+    table->newCount++;
+    return TRUE;
+}
+
+/*
+ * Count a failed first packet of a new SSRC. The last failure restarts the
+ * window, thus a rejected SSRC stays rejected for ZRTP_SSRC_REJECT_TIME. A
+ * new SSRC overwrites the oldest slot.
+ */
+static void
+zrtp_ssrc_table_reject(ZrtpSsrcTable* table, guint32 ssrc, guint64 now)
+{
+    ZrtpSsrcReject* reject;
+
+    if (table->hasPeer && ssrc == table->peer)
+        return;
+
+    reject = zrtp_ssrc_table_find_reject(table, ssrc, now);
+    if (reject == NULL) {
+        reject = &table->rejected[table->rejectNext];
+        table->rejectNext = (table->rejectNext + 1) % ZRTP_SSRC_REJECT_SIZE;
+        reject->ssrc = ssrc;
+        reject->failures = 1;
+        reject->until = now + ZRTP_SSRC_REJECT_TIME;
+        return;
+    }
+    if (++reject->failures >= ZRTP_SSRC_REJECT_FAILURES) {
+        if (reject->failures == ZRTP_SSRC_REJECT_FAILURES)
+            GST_DEBUG("Reject new SSRC 0x%08x, %u failed packets", ssrc, reject->failures);
+        reject->until = now + ZRTP_SSRC_REJECT_TIME;
+    }
+}
+
+void
+zrtp_ssrc_table_set_peer(ZrtpSsrcTable* table, guint32 ssrc)
+{
+    ZrtpSsrcEntry* entry;
+
+    table->peer = ssrc;
+    table->hasPeer = TRUE;
+    if (zrtp_ssrc_table_find(table, ssrc) != NULL)
+        return;
+
+    entry = zrtp_ssrc_table_alloc(table);
+    if (table->srtp != NULL) {
+        entry->srtp = zsrtp_newCryptoContextForSSRC(table->srtp, ssrc, 0, 0L);
+        if (entry->srtp == NULL)
+            return;
+        zsrtp_deriveSrtpKeys(entry->srtp, 0L);
+    } else {
+        entry->srtcp = zsrtp_newCryptoContextForSSRCCtrl(table->srtcp, ssrc);
+        if (entry->srtcp == NULL)
+            return;
+        zsrtp_deriveSrtpKeysCtrl(entry->srtcp);
+    }
+    entry->ssrc = ssrc;
+    zrtp_ssrc_table_touch(table, entry);
+}
+
+static gint32
+zrtp_ssrc_table_unprotect_rtp(ZrtpSsrcTable* table, GstBuffer* buffer, gboolean held)
+{
+    ZrtpSsrcEntry* entry;
+    ZsrtpContext* srtp;
+    guint32 ssrc;
+    guint64 now;
+    gint32 rc;
+
+    if (!zrtp_ssrc_table_get_ssrc(buffer, 8, &ssrc))
+        return -1;
+
+    entry = zrtp_ssrc_table_find(table, ssrc);
+    if (entry != NULL) {
+        rc = zsrtp_unprotect(entry->srtp, buffer);
+        if (rc == 1)
+            zrtp_ssrc_table_touch(table, entry);
+        return rc;
+    }
+
+    /* New SSRC: fork a context, keep it only if the packet authenticates */
+    now = zrtp_stats_now();
+    if (!zrtp_ssrc_table_admit(table, ssrc, now))
+        return -1;
+    srtp = zsrtp_newCryptoContextForSSRC(table->srtp, ssrc, 0, 0L);
+    if (srtp == NULL)
+        return -1;
+    zsrtp_deriveSrtpKeys(srtp, 0L);
+
+    rc = zsrtp_unprotect(srtp, buffer);
+    if (rc != 1) {
+        zsrtp_DestroyWrapper(srtp);
+        if (!held)
+            zrtp_ssrc_table_reject(table, ssrc, now);
+        return rc;
+    }
+    GST_DEBUG("New receive SRTP crypto context for SSRC 0x%08x", ssrc);
+    entry = zrtp_ssrc_table_alloc(table);
+    entry->ssrc = ssrc;
+    entry->srtp = srtp;
+    zrtp_ssrc_table_touch(table, entry);
+    return rc;
+}
+
+gint32
+zrtp_ssrc_table_unprotect(ZrtpSsrcTable* table, GstBuffer* buffer)
+{
+    return zrtp_ssrc_table_unprotect_rtp(table, buffer, FALSE);
+}
+
+gint32
+zrtp_ssrc_table_unprotect_held(ZrtpSsrcTable* table, GstBuffer* buffer)
+{
+    return zrtp_ssrc_table_unprotect_rtp(table, buffer, TRUE);
+}
+
+#if GST_CHECK_VERSION(1,0,0)
+void
+zrtp_ssrc_table_unprotect_batch(ZrtpSsrcTable* table, GstBuffer** buffers, guint count, gint32* results)
+{
+    guint i = 0;
+
+    while (i < count) {
+        ZrtpSsrcEntry* entry;
+        guint32 ssrc, next;
+        guint end;
+
+        if (!zrtp_ssrc_table_get_ssrc(buffers[i], 8, &ssrc)) {
+            results[i++] = -1;
+            continue;
+        }
+        entry = zrtp_ssrc_table_find(table, ssrc);
+        if (entry == NULL) {
+            results[i] = zrtp_ssrc_table_unprotect(table, buffers[i]);
+            i++;
+            continue;
+        }
+        for (end = i + 1; end < count; end++) {
+            if (!zrtp_ssrc_table_get_ssrc(buffers[end], 8, &next) || next != ssrc)
+                break;
+        }
+        if (zsrtp_unprotectBatch(entry->srtp, buffers + i, end - i, results + i) > 0)
+            zrtp_ssrc_table_touch(table, entry);
+        i = end;
+    }
+}
+#endif
+
+gint32
+zrtp_ssrc_table_unprotect_ctrl(ZrtpSsrcTable* table, GstBuffer* buffer)
+{
+    ZrtpSsrcEntry* entry;
+    ZsrtpContextCtrl* srtcp;
+    guint32 ssrc;
+    guint64 now;
+    gint32 rc;
+
+    if (!zrtp_ssrc_table_get_ssrc(buffer, 4, &ssrc))
+        return -1;
+
+    entry = zrtp_ssrc_table_find(table, ssrc);
+    if (entry != NULL) {
+        rc = zsrtp_unprotectCtrl(entry->srtcp, buffer);
+        if (rc == 1)
+            zrtp_ssrc_table_touch(table, entry);
+        return rc;
+    }
+
+    now = zrtp_stats_now();
+    if (!zrtp_ssrc_table_admit(table, ssrc, now))
+        return -1;
+    srtcp = zsrtp_newCryptoContextForSSRCCtrl(table->srtcp, ssrc);
+    if (srtcp == NULL)
+        return -1;
+    zsrtp_deriveSrtpKeysCtrl(srtcp);
+
+    rc = zsrtp_unprotectCtrl(srtcp, buffer);
+    if (rc != 1) {
+        zsrtp_DestroyWrapperCtrl(srtcp);
+        zrtp_ssrc_table_reject(table, ssrc, now);
+        return rc;
+    }
+    GST_DEBUG("New receive SRTCP crypto context for SSRC 0x%08x", ssrc);
+    entry = zrtp_ssrc_table_alloc(table);
+    entry->ssrc = ssrc;
+    entry->srtcp = srtcp;
+    zrtp_ssrc_table_touch(table, entry);
+    return rc;
+}
@@ -0,0 +1,146 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_ZRTP_SSRC_TABLE_H__
+#define __GST_ZRTP_SSRC_TABLE_H__
+
+#include <gst/gst.h>
+
+#include "gstSrtpCWrapper.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Per-SSRC receive crypto contexts.
+ *
+ * ZRTP negotiates one set of master keys for a RTP session. A peer may send
+ * several streams with this key set (simulcast, RTX, SSRC change). The table
+ * keeps the crypto context that ZRTP created as a template and forks a new
+ * context from the template's master key and salt for each SSRC the filter
+ * receives. The template itself never processes packets.
+ *
+ * The table is a small array with a last-hit cache: the most recent SSRC is
+ * checked first, which covers the common case of one active stream without
+ * scanning the array. If the table is full the least recently used entry is
+ * evicted. A new entry is inserted only after its first packet passed the
+ * authentication check, thus forged packets with random SSRCs cannot evict
+ * the contexts of real streams.
+ *
+ * Forking a context derives its keys, which costs far more than checking a
+ * packet. The table therefore limits the new SSRCs it tries to
+ * ZRTP_SSRC_NEW_BURST per ZRTP_SSRC_NEW_INTERVAL. A new SSRC whose first
+ * packets fail ZRTP_SSRC_REJECT_FAILURES times within ZRTP_SSRC_REJECT_TIME
+ * is rejected for ZRTP_SSRC_REJECT_TIME, the table remembers the last
+ * ZRTP_SSRC_REJECT_SIZE failing SSRCs. Packets beyond the limit or of a
+ * rejected SSRC fail as authentication errors without a key derivation.
+ *
+ * The SSRC that ZRTP negotiated with is never rejected, otherwise a few
+ * forged or clear packets with this SSRC around the key switch would lock
+ * out the real stream. zrtp_ssrc_table_set_peer() also creates its context
+ * up front.
+ *
+ * A table holds either SRTP or SRTCP contexts and has no locking, one
+ * thread at a time may use it. The filter serializes the callers of a table
+ * that several streaming threads share, e.g. the SRTCP table with rtcp-mux.
+ */
+#define ZRTP_SSRC_TABLE_DEFAULT_SIZE 8
+#define ZRTP_SSRC_TABLE_MAX_SIZE     256
+
+#define ZRTP_SSRC_NEW_BURST     8
+#define ZRTP_SSRC_NEW_INTERVAL  G_GUINT64_CONSTANT(100000000)     /* ns */
+#define ZRTP_SSRC_REJECT_SIZE   16
+#define ZRTP_SSRC_REJECT_FAILURES 4
+#define ZRTP_SSRC_REJECT_TIME   G_GUINT64_CONSTANT(1000000000)    /* ns */
+
+typedef struct _ZrtpSsrcReject {
+    guint32 ssrc;
+    guint failures;             /* rejected once it reaches ZRTP_SSRC_REJECT_FAILURES */
+    guint64 until;              /* monotonic ns, end of the window, 0 if the slot is free */
+} ZrtpSsrcReject;
+
+typedef struct _ZrtpSsrcEntry {
+    guint32 ssrc;
+    guint32 lastUse;            /* LRU stamp, 0 if entry is free */
+    ZsrtpContext* srtp;
+    ZsrtpContextCtrl* srtcp;
+} ZrtpSsrcEntry;
+
+typedef struct _ZrtpSsrcTable {
+    ZsrtpContext* srtp;         /* SRTP template, owns the master key */
+    ZsrtpContextCtrl* srtcp;    /* SRTCP template, owns the master key */
+    ZrtpSsrcEntry* last;        /* last hit */
+    guint32 clock;
+    guint32 peer;               /* negotiated SSRC, never rejected */
+    gboolean hasPeer;
+    guint64 newStart;           /* start of the current new SSRC interval */
+    guint newCount;             /* new SSRCs tried in this interval */
+    guint rejectNext;
+    ZrtpSsrcReject rejected[ZRTP_SSRC_REJECT_SIZE];
+    guint size;
+    ZrtpSsrcEntry entries[1];
+} ZrtpSsrcTable;
+
+/*
+ * Create a table, takes ownership of the template. Only one of srtp and
+ * srtcp may be set. Keys of the template must be derived already.
+ */
+ZrtpSsrcTable* zrtp_ssrc_table_new(ZsrtpContext* srtp, ZsrtpContextCtrl* srtcp, guint size);
+
+/*
+ * Create a new table with a fork of the SRTP template of table and the same
+ * size. The fork has its own contexts, use it in another thread.
+ */
+ZrtpSsrcTable* zrtp_ssrc_table_fork(ZrtpSsrcTable* table);
+
+/*
+ * Set the SSRC that ZRTP negotiated with and create its context. The fork of
+ * the table inherits it.
+ */
+void zrtp_ssrc_table_set_peer(ZrtpSsrcTable* table, guint32 ssrc);
+
+/* Free the table, all forked contexts and the template */
+void zrtp_ssrc_table_free(ZrtpSsrcTable* table);
+
+/*
+ * Unprotect a SRTP or SRTCP packet with the context of its SSRC,
+ * return codes are the same as zsrtp_unprotect and zsrtp_unprotectCtrl.
+ */
+gint32 zrtp_ssrc_table_unprotect(ZrtpSsrcTable* table, GstBuffer* buffer);
+gint32 zrtp_ssrc_table_unprotect_ctrl(ZrtpSsrcTable* table, GstBuffer* buffer);
+
+/*
+ * Unprotect a SRTP packet that early media held during the handshake. It may
+ * have been sent in the clear, a failure does not count towards rejecting
+ * its SSRC.
+ */
+gint32 zrtp_ssrc_table_unprotect_held(ZrtpSsrcTable* table, GstBuffer* buffer);
+
+#if GST_CHECK_VERSION(1,0,0)
+/*
+ * Unprotect a batch of SRTP packets in order, results receives the return
+ * code of each packet. Runs of packets with the same known SSRC go through
+ * zsrtp_unprotectBatch, the first packet of a new SSRC creates its context.
+ */
+void zrtp_ssrc_table_unprotect_batch(ZrtpSsrcTable* table, GstBuffer** buffers, guint count, gint32* results);
+#endif
+
+G_END_DECLS
+
+#endif /* __GST_ZRTP_SSRC_TABLE_H__ */
@@ -0,0 +1,102 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <time.h>
+
+#include "gstzrtpstats.h"
+
+guint64
+zrtp_stats_now(void)
+{
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (guint64)ts.tv_sec * G_GUINT64_CONSTANT(1000000000) + ts.tv_nsec;
+#else
+    return (guint64)g_get_monotonic_time() * 1000;
+#endif
+}
+
+static void
+zrtp_stats_add_stream(GstStructure* s, const gchar* prefix, ZrtpStreamStats* stats)
+{
+    GValue hist = { 0, };
+    GValue val = { 0, };
+    gchar* name;
+    guint i;
+
+    name = g_strconcat(prefix, "-packets", NULL);
+    gst_structure_set(s, name, G_TYPE_UINT64, ZRTP_STATS_GET(stats->packets), NULL);
+    g_free(name);
+
+    name = g_strconcat(prefix, "-bytes", NULL);
+    gst_structure_set(s, name, G_TYPE_UINT64, ZRTP_STATS_GET(stats->bytes), NULL);
+    g_free(name);
+
+    name = g_strconcat(prefix, "-auth-failures", NULL);
+    gst_structure_set(s, name, G_TYPE_UINT64, ZRTP_STATS_GET(stats->authFailures), NULL);
+    g_free(name);
+
+    name = g_strconcat(prefix, "-replay-drops", NULL);
+    gst_structure_set(s, name, G_TYPE_UINT64, ZRTP_STATS_GET(stats->replayDrops), NULL);
+    g_free(name);
+
+    g_value_init(&hist, GST_TYPE_ARRAY);
+    g_value_init(&val, G_TYPE_UINT64);
+    for (i = 0; i < ZRTP_STATS_HIST_BUCKETS; i++) {
+        g_value_set_uint64(&val, ZRTP_STATS_GET(stats->hist[i]));
+        gst_value_array_append_value(&hist, &val);
+    }
+    name = g_strconcat(prefix, "-time-histogram", NULL);
+    gst_structure_take_value(s, name, &hist);
+    g_free(name);
+    g_value_unset(&val);
+}
+
+GstStructure*
+zrtp_stats_to_structure(ZrtpStats* stats)
+{
+    GstStructure* s;
+
+    s = gst_structure_new("application/x-zrtp-stats",
+                          "zrtp-sent", G_TYPE_UINT64, ZRTP_STATS_GET(stats->zrtpSent),
+                          "zrtp-received", G_TYPE_UINT64, ZRTP_STATS_GET(stats->zrtpReceived),
+                          "zrtp-retransmits", G_TYPE_UINT64, ZRTP_STATS_GET(stats->zrtpRetransmits),
+                          "zrtp-crc-errors", G_TYPE_UINT64, ZRTP_STATS_GET(stats->zrtpCrcErrors),
+                          "dropped-non-zrtp", G_TYPE_UINT64, ZRTP_STATS_GET(stats->droppedNonZrtp),
+                          "zrtp-async-drops", G_TYPE_UINT64, ZRTP_STATS_GET(stats->zrtpAsyncDrops),
+                          "early-media-drops", G_TYPE_UINT64, ZRTP_STATS_GET(stats->earlyDrops),
+                          "auth-only-send", G_TYPE_UINT64, ZRTP_STATS_GET(stats->authOnlySend),
+                          "auth-only-recv", G_TYPE_UINT64, ZRTP_STATS_GET(stats->authOnlyRecv),
+                          "handshake-duration", G_TYPE_UINT64, ZRTP_STATS_GET(stats->handshakeDuration),
+                          "histogram-base", G_TYPE_UINT, ZRTP_STATS_HIST_BASE,
+                          NULL);
+
+    zrtp_stats_add_stream(s, "rtp-send", &stats->rtpSend);
+    zrtp_stats_add_stream(s, "rtp-recv", &stats->rtpRecv);
+    zrtp_stats_add_stream(s, "rtcp-send", &stats->rtcpSend);
+    zrtp_stats_add_stream(s, "rtcp-recv", &stats->rtcpRecv);
+    return s;
+}
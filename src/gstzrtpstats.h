@@ -0,0 +1,114 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_ZRTP_STATS_H__
+#define __GST_ZRTP_STATS_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Statistics of the ZRTP filter.
+ *
+ * Each stream direction has its own counters. The streaming thread of a
+ * direction writes them, and so do the crypto workers that process its
+ * packets and the ZRTP engine when it replays held early media. The ZRTP
+ * counters are written by the streaming threads, the engine and the ZRTP
+ * worker pool. The application reads all of them via the stats property at
+ * any time.
+ *
+ * The counters need no ordering with other data, thus all updates are
+ * relaxed atomic adds and stores. Loads and stores compile to plain, but
+ * untorn, moves on common CPUs. An add is still a locked read-modify-write
+ * (lock xadd on x86), relaxed only spares the barriers on weakly ordered
+ * CPUs.
+ *
+ * The time histogram has logarithmic buckets: bucket 0 counts protect or
+ * unprotect calls that took less than ZRTP_STATS_HIST_BASE nanoseconds,
+ * bucket n counts calls in [BASE * 2^(n-1), BASE * 2^n), the last bucket
+ * counts all slower calls. A batch of packets processed with one call
+ * counts as one call.
+ */
+#define ZRTP_STATS_HIST_BUCKETS  16
+#define ZRTP_STATS_HIST_BASE     256        /* nanoseconds, must be a power of 2 */
+
+#define ZRTP_STATS_ADD(field, n) __atomic_fetch_add(&(field), (n), __ATOMIC_RELAXED)
+#define ZRTP_STATS_GET(field)    __atomic_load_n(&(field), __ATOMIC_RELAXED)
+#define ZRTP_STATS_SET(field, v) __atomic_store_n(&(field), (v), __ATOMIC_RELAXED)
+
+typedef struct _ZrtpStreamStats {
+    guint64 packets;
+    guint64 bytes;              /* on the wire, i.e. SRTP size if SRTP is active */
+    guint64 authFailures;
+    guint64 replayDrops;
+    guint64 hist[ZRTP_STATS_HIST_BUCKETS];
+} ZrtpStreamStats;
+
+typedef struct _ZrtpStats {
+    ZrtpStreamStats rtpSend;
+    ZrtpStreamStats rtpRecv;
+    ZrtpStreamStats rtcpSend;
+    ZrtpStreamStats rtcpRecv;
+    guint64 zrtpSent;
+    guint64 zrtpReceived;
+    guint64 zrtpRetransmits;
+    guint64 zrtpCrcErrors;
+    guint64 droppedNonZrtp;     /* neither RTP nor a valid ZRTP packet */
+    guint64 zrtpAsyncDrops;     /* worker pool queue of the filter was full */
+    guint64 earlyDrops;         /* held RTP packets dropped, ring full or too old */
+    guint64 authOnlySend;       /* SRTP activations with the NULL cipher */
+    guint64 authOnlyRecv;
+    guint64 handshakeStart;     /* monotonic time in ns, 0 if not started */
+    guint64 handshakeDuration;  /* ns from start until secure state */
+} ZrtpStats;
+
+/* Monotonic time in nanoseconds */
+guint64 zrtp_stats_now(void);
+
+/* Record the time of a protect/unprotect call that started at startNs */
+static inline void
+zrtp_stats_time(ZrtpStreamStats* stats, guint64 startNs)
+{
+    guint64 ns = zrtp_stats_now() - startNs;
+    guint bucket = 0;
+
+    if (ns >= ZRTP_STATS_HIST_BASE)
+        bucket = MIN(g_bit_storage(ns / ZRTP_STATS_HIST_BASE), ZRTP_STATS_HIST_BUCKETS - 1);
+    ZRTP_STATS_ADD(stats->hist[bucket], 1);
+}
+
+/* Count a packet and record the time of its protect/unprotect call */
+static inline void
+zrtp_stats_packet(ZrtpStreamStats* stats, gsize bytes, guint64 startNs)
+{
+    ZRTP_STATS_ADD(stats->packets, 1);
+    ZRTP_STATS_ADD(stats->bytes, bytes);
+
+    if (startNs != 0)
+        zrtp_stats_time(stats, startNs);
+}
+
+/* Return a new structure with a snapshot of the statistics */
+GstStructure* zrtp_stats_to_structure(ZrtpStats* stats);
+
+G_END_DECLS
+
+#endif /* __GST_ZRTP_STATS_H__ */
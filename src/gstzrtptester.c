@@ -46,6 +46,15 @@
  *
  * zrtptester - a quick hacked plugin to use in ZRTP tests.
  *
+ * The tester sends RTP packets on its src pad and two RTCP packets on its
+ * rtcp_src pad. Without properties it sends 10 packets with a 12 byte payload
+ * every 200ms, this is what the demo programs expect. The properties turn it
+ * into a load generator: rate, burst, payload size, number of packets or
+ * duration and the number of SSRCs. A rate of 0 sends as fast as downstream
+ * accepts the packets. Packets come from a buffer pool that honours the
+ * tailroom of the downstream allocation parameters, use-list pushes each
+ * burst as one buffer list.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -78,9 +87,25 @@ enum
 enum
 {
     PROP_0,
-    PROP_SILENT
+    PROP_SILENT,
+    PROP_RATE,
+    PROP_PAYLOAD_SIZE,
+    PROP_NUM_PACKETS,
+    PROP_DURATION,
+    PROP_NUM_SSRC,
+    PROP_BURST,
+    PROP_USE_LIST
 };
 
+#define DEFAULT_RATE         5
+#define DEFAULT_PAYLOAD_SIZE 12
+#define DEFAULT_NUM_PACKETS  10
+#define DEFAULT_NUM_SSRC     1
+#define DEFAULT_BURST        1
+
+#define TESTER_SSRC          0x01020304
+#define RTP_HEADER_SIZE      12
+
 #define GST_ZRTP_LOCK(sess)   g_mutex_lock ((sess)->zrtpMutex)
 #define GST_ZRTP_UNLOCK(sess) g_mutex_unlock ((sess)->zrtpMutex)
 
@@ -164,6 +189,27 @@ gst_zrtptester_class_init (GstzrtptesterClass * klass)
     g_object_class_install_property (gobject_class, PROP_SILENT,
                                      g_param_spec_boolean ("silent", "Silent", "Produce verbose output ?",
                                      FALSE, G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_RATE,
+                                     g_param_spec_uint ("rate", "Rate", "RTP packets per second and SSRC, 0 sends without pacing",
+                                     0, G_MAXUINT, DEFAULT_RATE, G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_PAYLOAD_SIZE,
+                                     g_param_spec_uint ("payload-size", "PayloadSize", "RTP payload size in bytes",
+                                     1, 65000, DEFAULT_PAYLOAD_SIZE, G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_NUM_PACKETS,
+                                     g_param_spec_uint ("num-packets", "NumPackets", "RTP packets per SSRC, 0 for no limit",
+                                     0, G_MAXUINT, DEFAULT_NUM_PACKETS, G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_DURATION,
+                                     g_param_spec_uint64 ("duration", "Duration", "Stop sending after this time in ns, 0 for no limit",
+                                     0, G_MAXUINT64, 0, G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_NUM_SSRC,
+                                     g_param_spec_uint ("num-ssrc", "NumSSRC", "Number of RTP streams, SSRCs count up from 0x01020304",
+                                     1, 65536, DEFAULT_NUM_SSRC, G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_BURST,
+                                     g_param_spec_uint ("burst", "Burst", "RTP packets per SSRC sent back to back",
+                                     1, 4096, DEFAULT_BURST, G_PARAM_READWRITE));
+    g_object_class_install_property (gobject_class, PROP_USE_LIST,
+                                     g_param_spec_boolean ("use-list", "UseList", "Push each burst as a buffer list",
+                                     FALSE, G_PARAM_READWRITE));
     gstelement_class->change_state = GST_DEBUG_FUNCPTR (gst_zrtptester_change_state);
 }
 
@@ -223,6 +269,17 @@ gst_zrtptester_init (Gstzrtptester * filter,
     filter->thread_stopped = TRUE;
     filter->thread = NULL;
     filter->counter = 0;
+
+    filter->rate = DEFAULT_RATE;
+    filter->payloadSize = DEFAULT_PAYLOAD_SIZE;
+    filter->numPackets = DEFAULT_NUM_PACKETS;
+    filter->duration = 0;
+    filter->numSsrc = DEFAULT_NUM_SSRC;
+    filter->burst = DEFAULT_BURST;
+    filter->useList = FALSE;
+#if GST_CHECK_VERSION(1,0,0)
+    filter->pool = NULL;
+#endif
 }
 
 static void
@@ -235,6 +292,27 @@ gst_zrtptester_set_property (GObject * object, guint prop_id,
         case PROP_SILENT:
             filter->silent = g_value_get_boolean (value);
             break;
+        case PROP_RATE:
+            filter->rate = g_value_get_uint (value);
+            break;
+        case PROP_PAYLOAD_SIZE:
+            filter->payloadSize = g_value_get_uint (value);
+            break;
+        case PROP_NUM_PACKETS:
+            filter->numPackets = g_value_get_uint (value);
+            break;
+        case PROP_DURATION:
+            filter->duration = g_value_get_uint64 (value);
+            break;
+        case PROP_NUM_SSRC:
+            filter->numSsrc = g_value_get_uint (value);
+            break;
+        case PROP_BURST:
+            filter->burst = g_value_get_uint (value);
+            break;
+        case PROP_USE_LIST:
+            filter->useList = g_value_get_boolean (value);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
             break;
@@ -251,6 +329,27 @@ gst_zrtptester_get_property (GObject * object, guint prop_id,
         case PROP_SILENT:
             g_value_set_boolean (value, filter->silent);
             break;
+        case PROP_RATE:
+            g_value_set_uint (value, filter->rate);
+            break;
+        case PROP_PAYLOAD_SIZE:
+            g_value_set_uint (value, filter->payloadSize);
+            break;
+        case PROP_NUM_PACKETS:
+            g_value_set_uint (value, filter->numPackets);
+            break;
+        case PROP_DURATION:
+            g_value_set_uint64 (value, filter->duration);
+            break;
+        case PROP_NUM_SSRC:
+            g_value_set_uint (value, filter->numSsrc);
+            break;
+        case PROP_BURST:
+            g_value_set_uint (value, filter->burst);
+            break;
+        case PROP_USE_LIST:
+            g_value_set_boolean (value, filter->useList);
+            break;
         default:
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
             break;
@@ -386,20 +485,157 @@ static gchar rr[] = {0x80, 0xc9, 0x00, 0x01, 0x01, 0x02, 0x03, 0x04, // empty RR
 static gchar* data1 = "1234567890-";
 static gchar* data2 = "-0987654321";
 
+#if GST_CHECK_VERSION(1,0,0)
+/*
+ * Create the pool for the RTP packets. Ask downstream for the allocation
+ * parameters, the zrtpfilter requests tailroom for the SRTP authentication
+ * tag this way.
+ */
+static void
+zrtptester_setup_pool (Gstzrtptester* zrtptester)
+{
+    GstAllocationParams params;
+    GstAllocator* allocator = NULL;
+    GstStructure* config;
+    GstQuery* query;
+
+    gst_allocation_params_init(&params);
+    query = gst_query_new_allocation(NULL, TRUE);
+    if (gst_pad_peer_query(zrtptester->srcpad, query) && gst_query_get_n_allocation_params(query) > 0)
+        gst_query_parse_nth_allocation_param(query, 0, &allocator, &params);
+    gst_query_unref(query);
+
+    zrtptester->pool = gst_buffer_pool_new();
+    config = gst_buffer_pool_get_config(zrtptester->pool);
+    gst_buffer_pool_config_set_params(config, NULL, RTP_HEADER_SIZE + zrtptester->payloadSize, 0, 0);
+    gst_buffer_pool_config_set_allocator(config, allocator, &params);
+    gst_buffer_pool_set_config(zrtptester->pool, config);
+    gst_buffer_pool_set_active(zrtptester->pool, TRUE);
+
+    if (allocator)
+        gst_object_unref(allocator);
+    GST_DEBUG_OBJECT (zrtptester, "buffer pool with padding %" G_GSIZE_FORMAT, params.padding);
+}
+
+static void
+zrtptester_free_pool (Gstzrtptester* zrtptester)
+{
+    gst_buffer_pool_set_active(zrtptester->pool, FALSE);
+    gst_object_unref(zrtptester->pool);
+    zrtptester->pool = NULL;
+}
+#endif
+
+/* Get a RTP packet with a filled payload */
+static GstBuffer*
+zrtptester_new_rtp (Gstzrtptester* zrtptester, guint32 ssrc, guint16 seq)
+{
+    GstBuffer* buf;
+    guint8* payl;
+    guint i;
+    gchar* cp = ((seq & 1) == 0) ? data2 : data1;
+
+#if GST_CHECK_VERSION(1,0,0)
+    GstMapInfo mapInfo;
+
+    if (gst_buffer_pool_acquire_buffer(zrtptester->pool, &buf, NULL) != GST_FLOW_OK)
+        return NULL;
+
+    /* Write the fixed header, same as gst_rtp_buffer_new_allocate does */
+    gst_buffer_map(buf, &mapInfo, GST_MAP_WRITE);
+    mapInfo.data[0] = 0x80;
+    mapInfo.data[1] = 0;
+    GST_WRITE_UINT16_BE(mapInfo.data + 2, seq);
+    GST_WRITE_UINT32_BE(mapInfo.data + 4, 0);
+    GST_WRITE_UINT32_BE(mapInfo.data + 8, ssrc);
+    payl = mapInfo.data + RTP_HEADER_SIZE;
+#else
+    buf = gst_rtp_buffer_new_allocate (zrtptester->payloadSize, 0, 0);
+    gst_rtp_buffer_set_ssrc(buf, ssrc);
+    gst_rtp_buffer_set_seq(buf, seq);
+    payl = gst_rtp_buffer_get_payload (buf);
+#endif
+
+    for (i = 0; i < zrtptester->payloadSize; i++)
+        payl[i] = cp[i % 12];
+
+#if GST_CHECK_VERSION(1,0,0)
+    gst_buffer_unmap(buf, &mapInfo);
+#endif
+    return buf;
+}
+
+/* Send one burst of packets for each SSRC, return FALSE if downstream failed */
+static gboolean
+zrtptester_send_burst (Gstzrtptester* zrtptester, guint count)
+{
+    GstFlowReturn ret = GST_FLOW_OK;
+#if GST_CHECK_VERSION(1,0,0)
+    GstBufferList* list = NULL;
+#endif
+    guint s, b;
+
+#if GST_CHECK_VERSION(1,0,0)
+    if (zrtptester->useList)
+        list = gst_buffer_list_new_sized(count * zrtptester->numSsrc);
+#endif
+    for (b = 0; b < count; b++) {
+        guint16 seq = zrtptester->counter + b + 1;
+
+        for (s = 0; s < zrtptester->numSsrc && ret == GST_FLOW_OK; s++) {
+            GstBuffer* buf = zrtptester_new_rtp(zrtptester, TESTER_SSRC + s, seq);
+
+            if (buf == NULL) {
+#if GST_CHECK_VERSION(1,0,0)
+                if (list != NULL)
+                    gst_buffer_list_unref(list);
+#endif
+                return FALSE;
+            }
+#if GST_CHECK_VERSION(1,0,0)
+            if (list != NULL) {
+                gst_buffer_list_add(list, buf);
+                continue;
+            }
+#endif
+            GST_LOG("Sending RTP packet");
+            ret = gst_pad_push (zrtptester->srcpad, buf);
+        }
+    }
+#if GST_CHECK_VERSION(1,0,0)
+    if (list != NULL) {
+        GST_LOG("Sending RTP buffer list of %u packets", gst_buffer_list_length(list));
+        ret = gst_pad_push_list (zrtptester->srcpad, list);
+    }
+#endif
+    zrtptester->counter += count;
+    return ret == GST_FLOW_OK;
+}
+
 static void
 zrtptester_thread (Gstzrtptester* zrtptester)
 {
     GstClockID id;
-    GstClockTime current_time;
+    GstClockTime start_time;
     GstClockTime next_timeout;
+    GstClockTime interval;
     GstClock *sysclock;
 
     GST_DEBUG_OBJECT (zrtptester, "entering zrtptester thread");
 
     sysclock = zrtptester->sysclock;
-    current_time = gst_clock_get_time(sysclock);
+    start_time = gst_clock_get_time(sysclock);
+    next_timeout = start_time;
+
+    /* Send a burst of packets for each SSRC per interval */
+    interval = zrtptester->rate == 0 ? 0 :
+               gst_util_uint64_scale_int(GST_SECOND, zrtptester->burst, zrtptester->rate);
+
+    GST_DEBUG_OBJECT (zrtptester, "starting at %" GST_TIME_FORMAT, GST_TIME_ARGS (start_time));
 
-    GST_DEBUG_OBJECT (zrtptester, "starting at %" GST_TIME_FORMAT, GST_TIME_ARGS (current_time));
+#if GST_CHECK_VERSION(1,0,0)
+    zrtptester_setup_pool(zrtptester);
+#endif
 
     GstBuffer* buf = gst_buffer_new_and_alloc(28);
 #if GST_CHECK_VERSION(1,0,0)
@@ -413,52 +649,33 @@ zrtptester_thread (Gstzrtptester* zrtptester)
 #endif
     gst_pad_push(zrtptester->rtcp_src, buf);
 
-    while (zrtptester->start && zrtptester->counter < 10) {
-        /* get initial estimate */
-        next_timeout = current_time + 200 * GST_MSECOND;
+    while (zrtptester->start &&
+           (zrtptester->numPackets == 0 || zrtptester->counter < zrtptester->numPackets)) {
+        guint count = zrtptester->burst;
 
-        GST_DEBUG_OBJECT (zrtptester, "next send time %" GST_TIME_FORMAT, GST_TIME_ARGS (next_timeout));
+        /* Use absolute send times, a late wakeup does not reduce the rate */
+        next_timeout += interval;
 
-       /* leave if no more timeouts, the session ended */
-        if (next_timeout == GST_CLOCK_TIME_NONE)
-            break;
+        if (interval > 0) {
+            GST_LOG_OBJECT (zrtptester, "next send time %" GST_TIME_FORMAT, GST_TIME_ARGS (next_timeout));
 
-        id = zrtptester->clockId = gst_clock_new_single_shot_id (sysclock, next_timeout);
-        gst_clock_id_wait (id, NULL);
-
-        gst_clock_id_unref (id);
-        zrtptester->clockId = NULL;
+            id = zrtptester->clockId = gst_clock_new_single_shot_id (sysclock, next_timeout);
+            gst_clock_id_wait (id, NULL);
 
+            gst_clock_id_unref (id);
+            zrtptester->clockId = NULL;
+        }
         if (!zrtptester->start)
             break;
 
-        GstBuffer* buf = gst_rtp_buffer_new_allocate (12, 0, 0);
-#if GST_CHECK_VERSION(1,0,0)
-        GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
-        GstRTPBuffer *rtpBuf = &rtp;
-
-        gst_rtp_buffer_map(buf, GST_MAP_READWRITE, &rtp);
-#else
-        GstBuffer* rtpBuf = buf;
-#endif
-        gst_rtp_buffer_set_ssrc(rtpBuf, 0x01020304);
-        gst_rtp_buffer_set_seq(rtpBuf, zrtptester->counter + 1);
-
-        gpointer payl = gst_rtp_buffer_get_payload (rtpBuf);
-#if GST_CHECK_VERSION(1,0,0)
-        gst_rtp_buffer_unmap(&rtp);
-#endif
-
-        gchar* cp = ((zrtptester->counter & 1) == 1) ? data2 : data1;
-        memcpy(payl, cp, 12);
-
-        GST_INFO("Sending RTP packet");
-        gst_pad_push (zrtptester->srcpad, buf);
+        if (zrtptester->duration > 0 && gst_clock_get_time(sysclock) - start_time >= zrtptester->duration)
+            break;
 
-        /* update current time */
-        current_time = gst_clock_get_time (sysclock);
+        if (zrtptester->numPackets > 0)
+            count = MIN(count, zrtptester->numPackets - zrtptester->counter);
 
-        zrtptester->counter++;
+        if (!zrtptester_send_burst(zrtptester, count))
+            break;
     }
     GST_DEBUG("sending RTCP BYE");
 
@@ -481,7 +698,7 @@ zrtptester_thread (Gstzrtptester* zrtptester)
 #else
     GstBuffer* rtpBuf = buf;
 #endif
-    gst_rtp_buffer_set_ssrc(rtpBuf, 0x01020304);
+    gst_rtp_buffer_set_ssrc(rtpBuf, TESTER_SSRC);
     gst_rtp_buffer_set_seq(rtpBuf, zrtptester->counter + 1);
     memcpy(gst_rtp_buffer_get_payload (rtpBuf), "exit", 5);
 #if GST_CHECK_VERSION(1,0,0)
@@ -497,6 +714,10 @@ zrtptester_thread (Gstzrtptester* zrtptester)
 
     gst_pad_push_event(zrtptester->srcpad, gst_event_new_eos ());
     gst_pad_push_event(zrtptester->rtcp_src, gst_event_new_eos ());
+
+#if GST_CHECK_VERSION(1,0,0)
+    zrtptester_free_pool(zrtptester);
+#endif
     GST_DEBUG_OBJECT (zrtptester, "leaving zrtptester thread");
 
     /* mark the thread as stopped now */
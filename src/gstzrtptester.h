@@ -83,6 +83,18 @@ struct _Gstzrtptester
     gboolean start;
     gboolean thread_stopped;
 
+    /* load generator parameters */
+    guint    rate;              /* packets per second per SSRC, 0: no pacing */
+    guint    payloadSize;
+    guint    numPackets;        /* packets per SSRC, 0: no limit */
+    guint64  duration;          /* ns, 0: no limit */
+    guint    numSsrc;
+    guint    burst;             /* packets per SSRC and send interval */
+    gboolean useList;
+#if GST_CHECK_VERSION(1,0,0)
+    GstBufferPool* pool;
+#endif
+
 };
 
 struct _GstzrtptesterClass
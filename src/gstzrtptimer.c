@@ -0,0 +1,260 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gst/gst.h>
+
+#include "gstzrtptimer.h"
+
+#define ZRTP_TIMER_MASK (ZRTP_TIMER_SLOTS - 1)
+
+typedef struct _ZrtpTimerWheel {
+    GMutex* mutex;
+    GCond* wakeup;              /* first timer armed */
+    GCond* done;                /* callback returned */
+    GThread* thread;
+    gint64 start;               /* monotonic time of tick 0 in us */
+    guint64 tick;               /* last processed tick */
+    guint armed;
+    ZrtpTimer* running;
+    ZrtpTimer expired;          /* list head of the timers to fire now */
+    ZrtpTimer slots[ZRTP_TIMER_SLOTS];  /* list heads */
+} ZrtpTimerWheel;
+
+static ZrtpTimerWheel* wheel;
+
+static inline void
+zrtp_timer_unlink(ZrtpTimer* timer)
+{
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = timer->prev = timer;
+}
+
+static inline void
+zrtp_timer_link(ZrtpTimer* head, ZrtpTimer* timer)
+{
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+static guint64
+zrtp_timer_current_tick(void)
+{
+    return (g_get_monotonic_time() - wheel->start) / (ZRTP_TIMER_TICK * 1000);
+}
+
+static void
+zrtp_timer_wait_tick(guint64 tick)
+{
+    gint64 until = wheel->start + (gint64)tick * ZRTP_TIMER_TICK * 1000;
+#if GLIB_CHECK_VERSION(2, 32, 0)
+    g_cond_wait_until(wheel->wakeup, wheel->mutex, until);
+#else
+    GTimeVal tv;
+
+    g_get_current_time(&tv);
+    g_time_val_add(&tv, until - g_get_monotonic_time());
+    g_cond_timed_wait(wheel->wakeup, wheel->mutex, &tv);
+#endif
+}
+
+/* Move the expired timers of a slot to the expired list, count down the others */
+static void
+zrtp_timer_expire_slot(ZrtpTimer* slot)
+{
+    ZrtpTimer* timer;
+    ZrtpTimer* next;
+
+    for (timer = slot->next; timer != slot; timer = next) {
+        next = timer->next;
+        if (timer->rounds > 0) {
+            timer->rounds--;
+            continue;
+        }
+        zrtp_timer_unlink(timer);
+        zrtp_timer_link(&wheel->expired, timer);
+    }
+}
+
+static void
+zrtp_timer_fire_expired(void)
+{
+    ZrtpTimer* timer;
+
+    /* Cancel may remove timers from the expired list while the lock is free */
+    while ((timer = wheel->expired.next) != &wheel->expired) {
+        zrtp_timer_unlink(timer);
+        timer->armed = FALSE;
+        wheel->armed--;
+        wheel->running = timer;
+
+        g_mutex_unlock(wheel->mutex);
+        timer->func(timer->userData);
+        g_mutex_lock(wheel->mutex);
+
+        wheel->running = NULL;
+        g_cond_broadcast(wheel->done);
+    }
+}
+
+static gpointer
+zrtp_timer_thread(gpointer data)
+{
+    g_mutex_lock(wheel->mutex);
+    for (;;) {
+        if (wheel->armed == 0) {
+            g_cond_wait(wheel->wakeup, wheel->mutex);
+            continue;
+        }
+        if (wheel->tick < zrtp_timer_current_tick()) {
+            wheel->tick++;
+            zrtp_timer_expire_slot(&wheel->slots[wheel->tick & ZRTP_TIMER_MASK]);
+            zrtp_timer_fire_expired();
+            continue;
+        }
+        zrtp_timer_wait_tick(wheel->tick + 1);
+    }
+    g_mutex_unlock(wheel->mutex);
+    return NULL;
+}
+
+static gpointer
+zrtp_timer_create_wheel(gpointer data)
+{
+    GError* error = NULL;
+    guint i;
+
+    wheel = g_new0(ZrtpTimerWheel, 1);
+    wheel->mutex = g_mutex_new();
+    wheel->wakeup = g_cond_new();
+    wheel->done = g_cond_new();
+    wheel->start = g_get_monotonic_time();
+    wheel->expired.next = wheel->expired.prev = &wheel->expired;
+    for (i = 0; i < ZRTP_TIMER_SLOTS; i++)
+        wheel->slots[i].next = wheel->slots[i].prev = &wheel->slots[i];
+
+#if !GLIB_CHECK_VERSION (2, 31, 0)
+    wheel->thread = g_thread_create(zrtp_timer_thread, NULL, FALSE, &error);
+#else
+    wheel->thread = g_thread_try_new("zrtp-timer", zrtp_timer_thread, NULL, &error);
+#endif
+    if (wheel->thread == NULL) {
+        GST_ERROR("Cannot start ZRTP timer thread: %s", error->message);
+        g_error_free(error);
+        return NULL;
+    }
+    return wheel;
+}
+
+static gboolean
+zrtp_timer_get_wheel(void)
+{
+    static GOnce wheelOnce = G_ONCE_INIT;
+
+    return g_once(&wheelOnce, zrtp_timer_create_wheel, NULL) != NULL;
+}
+
+void
+zrtp_timer_init(ZrtpTimer* timer, ZrtpTimerFunc func, gpointer userData)
+{
+    timer->next = timer->prev = timer;
+    timer->rounds = 0;
+    timer->armed = FALSE;
+    timer->stopped = FALSE;
+    timer->func = func;
+    timer->userData = userData;
+}
+
+gboolean
+zrtp_timer_arm(ZrtpTimer* timer, guint ms)
+{
+    guint ticks = MAX((ms + ZRTP_TIMER_TICK - 1) / ZRTP_TIMER_TICK, 1);
+
+    if (!zrtp_timer_get_wheel())
+        return FALSE;
+
+    g_mutex_lock(wheel->mutex);
+    if (timer->stopped) {
+        g_mutex_unlock(wheel->mutex);
+        return FALSE;
+    }
+    if (timer->armed) {
+        zrtp_timer_unlink(timer);
+        wheel->armed--;
+    }
+    /* An idle wheel does not tick, catch up before computing the slot */
+    if (wheel->armed == 0)
+        wheel->tick = zrtp_timer_current_tick();
+
+    timer->rounds = (ticks - 1) / ZRTP_TIMER_SLOTS;
+    zrtp_timer_link(&wheel->slots[(wheel->tick + ticks) & ZRTP_TIMER_MASK], timer);
+    timer->armed = TRUE;
+    if (wheel->armed++ == 0)
+        g_cond_signal(wheel->wakeup);
+    g_mutex_unlock(wheel->mutex);
+    return TRUE;
+}
+
+/* Unlink an armed timer from its slot or from the expired list, wheel lock held */
+static void
+zrtp_timer_disarm(ZrtpTimer* timer)
+{
+    if (timer->armed) {
+        zrtp_timer_unlink(timer);
+        timer->armed = FALSE;
+        wheel->armed--;
+    }
+}
+
+void
+zrtp_timer_cancel(ZrtpTimer* timer)
+{
+    if (wheel == NULL)
+        return;
+
+    g_mutex_lock(wheel->mutex);
+    zrtp_timer_disarm(timer);
+    g_mutex_unlock(wheel->mutex);
+}
+
+void
+zrtp_timer_cancel_sync(ZrtpTimer* timer)
+{
+    if (wheel == NULL) {
+        timer->stopped = TRUE;
+        return;
+    }
+
+    g_mutex_lock(wheel->mutex);
+    timer->stopped = TRUE;
+    zrtp_timer_disarm(timer);
+    while (wheel->running == timer && g_thread_self() != wheel->thread)
+        g_cond_wait(wheel->done, wheel->mutex);
+
+    /* A callback that was running when the timer stopped could not arm it */
+    g_mutex_unlock(wheel->mutex);
+}
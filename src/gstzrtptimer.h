@@ -0,0 +1,81 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef __GST_ZRTP_TIMER_H__
+#define __GST_ZRTP_TIMER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Process wide timer wheel for the ZRTP retransmission timers.
+ *
+ * All filters share one wheel and one thread. The wheel has
+ * ZRTP_TIMER_SLOTS slots of ZRTP_TIMER_TICK milliseconds each, a timer
+ * sits in the slot of its expiry tick and counts the remaining rounds for
+ * delays beyond one turn of the wheel. Arm and cancel only link or unlink
+ * the timer in a doubly linked slot list, both are O(1) and do not allocate:
+ * the timer structure is part of the caller's object.
+ *
+ * The wheel thread runs the callbacks without holding the wheel lock, a
+ * callback may arm its timer again. zrtp_timer_cancel() does not block: a
+ * callback that already runs completes, and may even arm the timer again.
+ * The ZRTP engine cancels its timer while it holds the engine lock that the
+ * timeout callback needs, thus cancel must not wait for the callback.
+ *
+ * zrtp_timer_cancel_sync() is for teardown only: it stops the timer, waits
+ * until a running callback returned and makes later arm calls fail. After
+ * it the caller may free the timer. Never call it from an engine callback
+ * or with a lock that the timer callback takes.
+ */
+#define ZRTP_TIMER_TICK   10            /* milliseconds */
+#define ZRTP_TIMER_SLOTS  256           /* must be a power of 2 */
+
+typedef void (*ZrtpTimerFunc)(gpointer userData);
+
+typedef struct _ZrtpTimer ZrtpTimer;
+
+struct _ZrtpTimer {
+    ZrtpTimer* next;
+    ZrtpTimer* prev;
+    guint rounds;
+    gboolean armed;
+    gboolean stopped;           /* set by cancel_sync, arm fails */
+    ZrtpTimerFunc func;
+    gpointer userData;
+};
+
+/* Initialize a timer, does not arm it. Also restarts a timer after cancel_sync */
+void zrtp_timer_init(ZrtpTimer* timer, ZrtpTimerFunc func, gpointer userData);
+
+/* Arm the timer to expire after ms milliseconds, re-arms an armed timer. Fails on a stopped timer */
+gboolean zrtp_timer_arm(ZrtpTimer* timer, guint ms);
+
+/* Cancel the timer, no effect if it is not armed. Does not wait for a running callback */
+void zrtp_timer_cancel(ZrtpTimer* timer);
+
+/* Stop the timer for good and wait for a running callback, see above */
+void zrtp_timer_cancel_sync(ZrtpTimer* timer);
+
+G_END_DECLS
+
+#endif /* __GST_ZRTP_TIMER_H__ */
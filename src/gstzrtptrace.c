@@ -0,0 +1,40 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+
+#include "gstzrtptrace.h"
+
+#ifdef HAVE_SYS_SDT_H
+/* The tracer finds the semaphores via the probe notes and increments them on attach */
+#define ZRTP_TRACE_DEFINE(name) \
+    unsigned short ZRTP_TRACE_SEMAPHORE(name) __attribute__((unused, section(".probes"))) = 0
+
+ZRTP_TRACE_DEFINE(rtp_protect);
+ZRTP_TRACE_DEFINE(rtp_unprotect);
+ZRTP_TRACE_DEFINE(rtcp_protect);
+ZRTP_TRACE_DEFINE(rtcp_unprotect);
+ZRTP_TRACE_DEFINE(zrtp_recv);
+ZRTP_TRACE_DEFINE(zrtp_send);
+ZRTP_TRACE_DEFINE(chain);
+#endif
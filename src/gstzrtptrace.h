@@ -0,0 +1,102 @@
+/*
+ * GStreamer
+ * Copyright (C) 2012 werner <Werner.Dittmann@t-online.de>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_ZRTP_TRACE_H__
+#define __GST_ZRTP_TRACE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Static USDT probes of the ZRTP filter.
+ *
+ * The probes are compiled in if CMake finds sys/sdt.h (systemtap SDT headers,
+ * option ENABLE_USDT). A probe is a single nop in the code plus a note in the
+ * ELF file, each probe has a semaphore that the tracer increments while it is
+ * attached. The filter tests the semaphore and computes the probe arguments,
+ * for example the SSRC and sequence number, only if a tracer is attached.
+ * Thus the probes stay in release builds and cost a nop and a predicted
+ * branch per packet otherwise.
+ *
+ * Provider is "gstzrtp", the probes and their arguments:
+ *
+ * rtp_protect, rtp_unprotect, rtcp_protect, rtcp_unprotect:
+ *     ssrc, seq, size, result, ns
+ * zrtp_recv, zrtp_send:
+ *     ssrc, seq, size, result, ns
+ * chain:
+ *     path, ssrc, seq, size, flow, ns
+ *
+ * result is the SRTP result (1 ok, -1 authentication failed, -2 replay) or
+ * 1/0 for ZRTP packets that were processed/sent or dropped. size is the size
+ * on the wire, ns the time of the call in nanoseconds. Packets of a buffer
+ * list that SRTP processes as a batch report the batch time divided by the
+ * number of packets. path of the chain probe is one of the ZRTP_TRACE_PATH_*
+ * values, flow the GstFlowReturn of the push. RTCP reports the sender SSRC
+ * and seq 0. Buffer lists fire the per-packet probes only.
+ *
+ * Example, a histogram of the SRTP decrypt times of a running process:
+ * <code>bpftrace -p PID -e 'usdt:PATH/libgstzrtp.so:gstzrtp:rtp_unprotect
+ * { @ns = hist(arg4); }'</code>
+ */
+#define ZRTP_TRACE_PATH_RECV_RTP   0
+#define ZRTP_TRACE_PATH_SEND_RTP   1
+#define ZRTP_TRACE_PATH_RECV_RTCP  2
+#define ZRTP_TRACE_PATH_SEND_RTCP  3
+
+#ifdef HAVE_SYS_SDT_H
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#define ZRTP_TRACE_SEMAPHORE(name) gstzrtp_##name##_semaphore
+
+extern unsigned short ZRTP_TRACE_SEMAPHORE(rtp_protect);
+extern unsigned short ZRTP_TRACE_SEMAPHORE(rtp_unprotect);
+extern unsigned short ZRTP_TRACE_SEMAPHORE(rtcp_protect);
+extern unsigned short ZRTP_TRACE_SEMAPHORE(rtcp_unprotect);
+extern unsigned short ZRTP_TRACE_SEMAPHORE(zrtp_recv);
+extern unsigned short ZRTP_TRACE_SEMAPHORE(zrtp_send);
+extern unsigned short ZRTP_TRACE_SEMAPHORE(chain);
+
+#define ZRTP_TRACE_ENABLED(name) \
+    G_UNLIKELY(__atomic_load_n(&ZRTP_TRACE_SEMAPHORE(name), __ATOMIC_RELAXED) != 0)
+
+#define ZRTP_TRACE5(name, a1, a2, a3, a4, a5) \
+    STAP_PROBE5(gstzrtp, name, a1, a2, a3, a4, a5)
+#define ZRTP_TRACE6(name, a1, a2, a3, a4, a5, a6) \
+    STAP_PROBE6(gstzrtp, name, a1, a2, a3, a4, a5, a6)
+
+#else
+
+/* The arguments are used in dead code only, avoids warnings about unused variables */
+#define ZRTP_TRACE_ENABLED(name) 0
+
+#define ZRTP_TRACE5(name, a1, a2, a3, a4, a5) \
+    G_STMT_START { if (0) { (void)(a1); (void)(a2); (void)(a3); (void)(a4); (void)(a5); } } G_STMT_END
+#define ZRTP_TRACE6(name, a1, a2, a3, a4, a5, a6) \
+    G_STMT_START { if (0) { (void)(a1); (void)(a2); (void)(a3); (void)(a4); (void)(a5); (void)(a6); } } G_STMT_END
+
+#endif /* HAVE_SYS_SDT_H */
+
+G_END_DECLS
+
+#endif /* __GST_ZRTP_TRACE_H__ */